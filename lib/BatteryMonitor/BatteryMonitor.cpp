@@ -0,0 +1,77 @@
+#include "BatteryMonitor.h"
+
+BatteryMonitor::BatteryMonitor(uint16_t emptyMv, uint16_t fullMv)
+    : _emptyMv(emptyMv),
+      _fullMv(fullMv),
+      _windowCount(0),
+      _windowPos(0),
+      _windowSum(0),
+      _rateRefMs(0),
+      _rateRefMv(0),
+      _rateMvPerHour(0),
+      _rateValid(false) {
+    BatterySnapshot empty = {};
+    _snapshot.store(empty);
+}
+
+void BatteryMonitor::addSample(uint32_t nowMs, uint16_t millivolts) {
+    // Moving window: replace the oldest sample and keep a running sum
+    if (_windowCount == BATTERY_WINDOW_SIZE) {
+        _windowSum -= _window[_windowPos];
+    } else {
+        _windowCount++;
+    }
+    _window[_windowPos] = millivolts;
+    _windowSum += millivolts;
+    _windowPos = (_windowPos + 1) % BATTERY_WINDOW_SIZE;
+
+    uint16_t average = (uint16_t)((_windowSum + _windowCount / 2) / _windowCount);
+
+    // Discharge rate: slope of the averaged voltage over a long interval,
+    // smoothed with an EMA (alpha = 1/4) because ADC noise dwarfs the
+    // real change between two neighbouring samples
+    if (_rateRefMs == 0 && _windowCount == BATTERY_WINDOW_SIZE) {
+        _rateRefMs = nowMs;
+        _rateRefMv = average;
+    } else if (_rateRefMs != 0 &&
+               nowMs - _rateRefMs >= BATTERY_RATE_INTERVAL_MS) {
+        int32_t elapsedMs = (int32_t)(nowMs - _rateRefMs);
+        int32_t slope =
+            (int32_t)(((int64_t)((int32_t)average - (int32_t)_rateRefMv) *
+                       3600000) /
+                      elapsedMs);
+        if (_rateValid) {
+            _rateMvPerHour += (slope - _rateMvPerHour) / 4;
+        } else {
+            _rateMvPerHour = slope;
+            _rateValid     = true;
+        }
+        _rateRefMs = nowMs;
+        _rateRefMv = average;
+    }
+
+    int32_t rate = _rateMvPerHour;
+    if (rate > INT16_MAX) rate = INT16_MAX;
+    if (rate < INT16_MIN) rate = INT16_MIN;
+
+    BatterySnapshot snap;
+    snap.millivolts    = average;
+    snap.percent       = voltageToPercentage(average);
+    snap.rateMvPerHour = (int16_t)rate;
+    snap.timestampMs   = nowMs;
+    snap.valid         = true;
+    _snapshot.store(snap);
+}
+
+BatterySnapshot BatteryMonitor::snapshot() const {
+    return _snapshot.load();
+}
+
+uint8_t BatteryMonitor::voltageToPercentage(uint16_t millivolts) const {
+    if (millivolts <= _emptyMv) return 0;
+    if (millivolts >= _fullMv) return 100;
+    // Round to nearest percent
+    uint32_t span = _fullMv - _emptyMv;
+    return (uint8_t)(((uint32_t)(millivolts - _emptyMv) * 100 + span / 2) /
+                     span);
+}
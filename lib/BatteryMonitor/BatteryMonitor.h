@@ -0,0 +1,51 @@
+#ifndef _BATTERY_MONITOR_H_
+#define _BATTERY_MONITOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SeqLock.h"
+
+#define BATTERY_WINDOW_SIZE      8      // Samples in the moving average
+#define BATTERY_RATE_INTERVAL_MS 60000  // Spacing of discharge-rate updates
+
+typedef struct {
+    uint16_t millivolts;   // Moving average of the last samples
+    uint8_t percent;       // 0..100, linear between empty and full
+    int16_t rateMvPerHour; // Smoothed voltage slope, negative while draining
+    uint32_t timestampMs;  // Time of the newest sample
+    bool valid;            // False until the first sample arrives
+} BatterySnapshot;
+
+// Incrementally filtered battery voltage.
+//
+// A low priority task feeds raw readings through addSample(); every sample
+// costs O(1) work and no delay. Any other task can call snapshot() at any
+// time, which is a lock-free copy of the last published state.
+class BatteryMonitor {
+   public:
+    BatteryMonitor(uint16_t emptyMv = 3700, uint16_t fullMv = 4200);
+
+    void addSample(uint32_t nowMs, uint16_t millivolts);
+    BatterySnapshot snapshot() const;
+
+    uint8_t voltageToPercentage(uint16_t millivolts) const;
+
+   private:
+    uint16_t _emptyMv;
+    uint16_t _fullMv;
+
+    uint16_t _window[BATTERY_WINDOW_SIZE];
+    size_t _windowCount;
+    size_t _windowPos;
+    uint32_t _windowSum;
+
+    uint32_t _rateRefMs;
+    uint16_t _rateRefMv;
+    int32_t _rateMvPerHour;
+    bool _rateValid;
+
+    SeqLock<BatterySnapshot> _snapshot;
+};
+
+#endif
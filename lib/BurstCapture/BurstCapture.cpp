@@ -0,0 +1,115 @@
+#include "BurstCapture.h"
+
+#include <stdlib.h>
+
+#if defined(ARDUINO) && defined(BOARD_HAS_PSRAM)
+#include <esp32-hal-psram.h>
+#define BURST_ALLOC(size) ps_malloc(size)
+#else
+#define BURST_ALLOC(size) malloc(size)
+#endif
+
+BurstCapture::BurstCapture()
+    : _records(NULL),
+      _capacity(0),
+      _target(0),
+      _head(0),
+      _info(),
+      _state(BURST_IDLE) {
+}
+
+BurstCapture::~BurstCapture() {
+    free(_records);
+}
+
+bool BurstCapture::begin(uint32_t capacity) {
+    if (_records) return capacity <= _capacity;
+    _records = (BurstRecord*)BURST_ALLOC((size_t)capacity * sizeof(BurstRecord));
+    if (!_records) return false;
+    _capacity = capacity;
+    return true;
+}
+
+bool BurstCapture::transition(BurstState from, BurstState to) {
+    uint8_t expected = from;
+    return _state.compare_exchange_strong(expected, (uint8_t)to,
+                                          std::memory_order_acq_rel);
+}
+
+bool BurstCapture::requestStart(uint32_t samples) {
+    if (!_records) return false;
+    // Claim the capture first so concurrent requests cannot overwrite each
+    // other's _target; the writer reads it only after it sees BURST_ARMED
+    BurstState current = state();
+    if (current != BURST_IDLE && current != BURST_DONE) return false;
+    if (!transition(current, BURST_ARMING)) return false;
+    _target = samples;
+    _state.store(BURST_ARMED, std::memory_order_release);
+    return true;
+}
+
+bool BurstCapture::requestStop() {
+    return transition(BURST_RUNNING, BURST_STOPPING) ||
+           transition(BURST_ARMED, BURST_IDLE);
+}
+
+bool BurstCapture::start(uint8_t gainCode, uint8_t timeCode,
+                         uint32_t periodUs) {
+    // requestStop() may have withdrawn the request in the meantime
+    if (!transition(BURST_ARMED, BURST_RUNNING)) return false;
+    _head          = 0;
+    _info.gainCode = gainCode;
+    _info.timeCode = timeCode;
+    _info.periodUs = periodUs;
+    _info.startUs  = 0;  // Set by the first record
+    _info.recorded = 0;
+    _info.count    = 0;
+    return true;
+}
+
+bool BurstCapture::record(const AS7331Raw& raw, uint32_t seq,
+                          uint64_t timestampUs) {
+    if (_info.recorded == 0) _info.startUs = timestampUs;
+
+    BurstRecord& slot = _records[_head];
+    slot.timeUs       = (uint32_t)(timestampUs - _info.startUs);
+    slot.seq          = (uint16_t)seq;
+    slot.uva          = raw.uva;
+    slot.uvb          = raw.uvb;
+    slot.uvc          = raw.uvc;
+
+    if (++_head == _capacity) _head = 0;
+    _info.recorded++;
+    if (_info.count < _capacity) _info.count++;
+
+    return _target == 0 || _info.recorded < _target;
+}
+
+void BurstCapture::finish() {
+    // Either state may be current: stopped on request or limit reached
+    if (!transition(BURST_STOPPING, BURST_DONE)) {
+        transition(BURST_RUNNING, BURST_DONE);
+    }
+}
+
+bool BurstCapture::beginRead() {
+    return transition(BURST_DONE, BURST_READING);
+}
+
+void BurstCapture::endRead() {
+    transition(BURST_READING, BURST_DONE);
+}
+
+const BurstRecord& BurstCapture::at(uint32_t index) const {
+    // Once the ring wrapped, the oldest record sits at the write position
+    uint32_t first = _info.count < _capacity ? 0 : _head;
+    uint32_t slot  = first + index;
+    if (slot >= _capacity) slot -= _capacity;
+    return _records[slot];
+}
+
+uint8_t BurstCapture::matchGainCode(uint8_t gainCode, uint8_t timeCode) {
+    // Counts scale with gain * 2^time; move the time steps into the gain
+    int code = (int)gainCode - ((int)timeCode - BURST_TIME_CODE);
+    return code < 0 ? 0 : (uint8_t)code;
+}
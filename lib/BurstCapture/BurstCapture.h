@@ -0,0 +1,103 @@
+#ifndef _BURST_CAPTURE_H_
+#define _BURST_CAPTURE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "UVSensorPort.h"
+
+// Fastest AS7331 setting: 1 ms conversions, 64 us break (~940 Hz)
+#define BURST_TIME_CODE  0
+#define BURST_BREAK_TIME 8
+
+typedef enum {
+    BURST_IDLE,      // Nothing captured yet
+    BURST_ARMING,    // Start being requested, target not yet stored
+    BURST_ARMED,     // Start requested, waiting for the writer
+    BURST_RUNNING,   // Writer is storing records
+    BURST_STOPPING,  // Stop requested, waiting for the writer
+    BURST_DONE,      // Capture complete and readable
+    BURST_READING    // Capture locked by a reader
+} BurstState;
+
+// One conversion, 12 bytes. Time is relative to the start of the capture;
+// seq is the low half of UVSample::seq, so gaps show missed conversions.
+typedef struct {
+    uint32_t timeUs;
+    uint16_t seq;
+    uint16_t uva;
+    uint16_t uvb;
+    uint16_t uvc;
+} BurstRecord;
+
+// Range the whole capture was taken at, needed to convert counts
+typedef struct {
+    uint8_t gainCode;
+    uint8_t timeCode;
+    uint32_t periodUs;     // Nominal time between conversions
+    uint64_t startUs;      // esp_timer time of the first record
+    uint32_t recorded;     // Records written, including overwritten ones
+    uint32_t count;        // Records available
+} BurstInfo;
+
+// Raw sample store for high rate captures.
+//
+// The buffer is allocated once in begin(), from PSRAM when the board has
+// it. Control requests come from any task; the writer (the acquisition
+// task) picks them up with state(), configures the sensor, and calls
+// start() / record() / finish(). A capture limited to N samples stops by
+// itself, an unlimited one keeps overwriting the oldest records until
+// stopped. Readers lock a finished capture with beginRead() so a new
+// capture cannot start while it is being dumped.
+class BurstCapture {
+   public:
+    BurstCapture();
+    ~BurstCapture();
+
+    // Allocates room for capacity records; false if memory is short
+    bool begin(uint32_t capacity);
+    uint32_t capacity() const {
+        return _capacity;
+    }
+
+    // Control, any task. samples = 0 records until requestStop().
+    bool requestStart(uint32_t samples);
+    bool requestStop();
+    BurstState state() const {
+        return (BurstState)_state.load(std::memory_order_acquire);
+    }
+
+    // Writer side. start() returns false if the request was withdrawn
+    // since state() returned BURST_ARMED; nothing is recorded then.
+    bool start(uint8_t gainCode, uint8_t timeCode, uint32_t periodUs);
+    // Returns false once the requested number of records is reached
+    bool record(const AS7331Raw& raw, uint32_t seq, uint64_t timestampUs);
+    void finish();
+
+    // Reader side, only valid between beginRead() and endRead()
+    bool beginRead();
+    void endRead();
+    const BurstInfo& info() const {
+        return _info;
+    }
+    // Record index 0 is the oldest one still in the buffer
+    const BurstRecord& at(uint32_t index) const;
+
+    // Gain code giving the same counts at BURST_TIME_CODE as the given
+    // range, as far as the 2048x maximum allows
+    static uint8_t matchGainCode(uint8_t gainCode, uint8_t timeCode);
+
+   private:
+    bool transition(BurstState from, BurstState to);
+
+    BurstRecord* _records;
+    uint32_t _capacity;
+    uint32_t _target;  // 0 = unlimited
+    uint32_t _head;    // Next slot to write
+    BurstInfo _info;
+    std::atomic<uint8_t> _state;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "ButtonEvents.h"
+
+#include "esp_timer.h"
+#include "hal/gpio_ll.h"
+
+ButtonEvents::ButtonEvents()
+    : _count(0),
+      _queue(NULL),
+      _callback(nullptr),
+      _context(nullptr),
+      _lastLatencyUs(0),
+      _maxLatencyUs(0),
+      _eventCount(0),
+      _overflows(0) {
+}
+
+bool ButtonEvents::begin(const uint8_t* pins, uint8_t count,
+                         ButtonEventCallback callback, void* context,
+                         UBaseType_t priority) {
+    if (count > BUTTON_EVENTS_MAX_BUTTONS) return false;
+
+    _queue = xQueueCreate(BUTTON_EVENTS_QUEUE_LEN, sizeof(Edge));
+    if (_queue == NULL) return false;
+
+    _callback = callback;
+    _context  = context;
+    _count    = count;
+
+    for (uint8_t i = 0; i < count; i++) {
+        _pins[i].owner = this;
+        _pins[i].index = i;
+        _pins[i].pin   = pins[i];
+        _machines[i].begin(i, dispatch, this);
+        pinMode(pins[i], INPUT_PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(pins[i]), isr, &_pins[i],
+                           CHANGE);
+    }
+
+    return xTaskCreate(task, "Button Task", 4096, this, priority, NULL) ==
+           pdPASS;
+}
+
+// Runs with the flash cache possibly disabled: IRAM only, no digitalRead()
+void IRAM_ATTR ButtonEvents::isr(void* arg) {
+    PinContext* pin = static_cast<PinContext*>(arg);
+    Edge edge;
+    edge.button  = pin->index;
+    edge.pressed = gpio_ll_get_level(&GPIO, (gpio_num_t)pin->pin) == 0;
+    edge.timeUs  = (uint32_t)esp_timer_get_time();
+
+    BaseType_t woken = pdFALSE;
+    if (xQueueSendFromISR(pin->owner->_queue, &edge, &woken) != pdTRUE) {
+        pin->owner->_overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+void ButtonEvents::task(void* arg) {
+    ButtonEvents* self = static_cast<ButtonEvents*>(arg);
+
+    for (;;) {
+        // Sleep until the next edge, or until a debounce / long-press /
+        // double-click timer of any button expires
+        uint32_t now    = (uint32_t)esp_timer_get_time();
+        TickType_t wait = portMAX_DELAY;
+        for (uint8_t i = 0; i < self->_count; i++) {
+            uint32_t remainingUs;
+            if (self->_machines[i].nextDeadline(now, &remainingUs)) {
+                TickType_t ticks =
+                    (remainingUs + portTICK_PERIOD_MS * 1000 - 1) /
+                    (portTICK_PERIOD_MS * 1000);
+                if (ticks < wait) wait = ticks;
+            }
+        }
+
+        Edge edge;
+        if (xQueueReceive(self->_queue, &edge, wait) == pdTRUE) {
+            self->_machines[edge.button].onEdge(edge.pressed, edge.timeUs);
+        }
+
+        now = (uint32_t)esp_timer_get_time();
+        for (uint8_t i = 0; i < self->_count; i++) {
+            self->_machines[i].onTick(now);
+        }
+    }
+}
+
+void ButtonEvents::dispatch(const ButtonEvent& event, void* context) {
+    ButtonEvents* self = static_cast<ButtonEvents*>(context);
+
+    // Click, double-click and long-press are delayed on purpose by their
+    // timers, so only edge events say anything about input latency. Stored
+    // before the callback runs, so the callback reads its own event's.
+    if (event.type == BUTTON_PRESS || event.type == BUTTON_RELEASE) {
+        uint32_t latency = (uint32_t)esp_timer_get_time() - event.edgeUs;
+        self->_lastLatencyUs.store(latency, std::memory_order_relaxed);
+        if (latency > self->_maxLatencyUs.load(std::memory_order_relaxed)) {
+            self->_maxLatencyUs.store(latency, std::memory_order_relaxed);
+        }
+        self->_eventCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (self->_callback != nullptr) self->_callback(event, self->_context);
+}
@@ -0,0 +1,74 @@
+#ifndef _BUTTON_EVENTS_H_
+#define _BUTTON_EVENTS_H_
+
+#include <atomic>
+
+#include "Arduino.h"
+#include "ButtonStateMachine.h"
+
+#define BUTTON_EVENTS_MAX_BUTTONS 4
+#define BUTTON_EVENTS_QUEUE_LEN   16
+
+// Interrupt driven buttons.
+//
+// Each pin gets a CHANGE interrupt that only timestamps the edge and posts
+// it to a FreeRTOS queue. A handler task blocks on that queue (no polling,
+// no periodic wake-ups while idle), runs one ButtonStateMachine per button
+// and calls the event callback in task context. Buttons are active LOW.
+class ButtonEvents {
+   public:
+    ButtonEvents();
+
+    bool begin(const uint8_t* pins, uint8_t count, ButtonEventCallback callback,
+               void* context, UBaseType_t priority = 2);
+
+    // Edge-to-callback latency of press/release events so far
+    uint32_t lastLatencyUs() const {
+        return _lastLatencyUs.load(std::memory_order_relaxed);
+    }
+    uint32_t maxLatencyUs() const {
+        return _maxLatencyUs.load(std::memory_order_relaxed);
+    }
+    uint32_t eventCount() const {
+        return _eventCount.load(std::memory_order_relaxed);
+    }
+    uint32_t queueOverflows() const {
+        return _overflows.load(std::memory_order_relaxed);
+    }
+    void resetLatency() {
+        _lastLatencyUs.store(0, std::memory_order_relaxed);
+        _maxLatencyUs.store(0, std::memory_order_relaxed);
+    }
+
+   private:
+    typedef struct {
+        uint8_t button;
+        bool pressed;
+        uint32_t timeUs;
+    } Edge;
+
+    typedef struct {
+        ButtonEvents* owner;
+        uint8_t index;
+        uint8_t pin;
+    } PinContext;
+
+    static void IRAM_ATTR isr(void* arg);
+    static void task(void* arg);
+    static void dispatch(const ButtonEvent& event, void* context);
+
+    PinContext _pins[BUTTON_EVENTS_MAX_BUTTONS];
+    ButtonStateMachine _machines[BUTTON_EVENTS_MAX_BUTTONS];
+    uint8_t _count;
+    QueueHandle_t _queue;
+
+    ButtonEventCallback _callback;
+    void* _context;
+
+    std::atomic<uint32_t> _lastLatencyUs;
+    std::atomic<uint32_t> _maxLatencyUs;
+    std::atomic<uint32_t> _eventCount;
+    std::atomic<uint32_t> _overflows;
+};
+
+#endif
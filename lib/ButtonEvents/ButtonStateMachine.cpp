@@ -0,0 +1,122 @@
+#include "ButtonStateMachine.h"
+
+// Remaining time until start + length, or 0 if already passed
+static uint32_t remaining(uint32_t nowUs, uint32_t startUs, uint32_t length) {
+    uint32_t elapsed = nowUs - startUs;
+    return elapsed >= length ? 0 : length - elapsed;
+}
+
+ButtonStateMachine::ButtonStateMachine()
+    : _button(0),
+      _callback(nullptr),
+      _context(nullptr),
+      _state(STATE_IDLE),
+      _stable(false),
+      _raw(false),
+      _rawUs(0),
+      _lockout(false),
+      _lockoutUs(0),
+      _pressUs(0),
+      _releaseUs(0) {
+}
+
+void ButtonStateMachine::begin(uint8_t button, ButtonEventCallback callback,
+                               void* context) {
+    _button   = button;
+    _callback = callback;
+    _context  = context;
+}
+
+void ButtonStateMachine::onEdge(bool pressed, uint32_t nowUs) {
+    _raw   = pressed;
+    _rawUs = nowUs;
+    if (_lockout) return;  // Resolved by onTick() when the window closes
+    if (pressed != _stable) accept(pressed, nowUs);
+}
+
+void ButtonStateMachine::onTick(uint32_t nowUs) {
+    if (_lockout && remaining(nowUs, _lockoutUs, BUTTON_DEBOUNCE_US) == 0) {
+        _lockout = false;
+        if (_raw != _stable) accept(_raw, _rawUs);
+    }
+
+    switch (_state) {
+        case STATE_PRESSED:
+        case STATE_SECOND_PRESSED:
+            if (remaining(nowUs, _pressUs, BUTTON_LONG_PRESS_US) == 0) {
+                _state = STATE_LONG_HELD;
+                emit(BUTTON_LONG_PRESS, _pressUs);
+            }
+            break;
+        case STATE_WAIT_SECOND:
+            if (remaining(nowUs, _releaseUs, BUTTON_DOUBLE_CLICK_US) == 0) {
+                _state = STATE_IDLE;
+                emit(BUTTON_CLICK, _releaseUs);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool ButtonStateMachine::nextDeadline(uint32_t nowUs,
+                                      uint32_t* remainingUs) const {
+    bool pending    = false;
+    uint32_t soonest = UINT32_MAX;
+
+    if (_lockout) {
+        soonest = remaining(nowUs, _lockoutUs, BUTTON_DEBOUNCE_US);
+        pending = true;
+    }
+    uint32_t timer = UINT32_MAX;
+    if (_state == STATE_PRESSED || _state == STATE_SECOND_PRESSED) {
+        timer = remaining(nowUs, _pressUs, BUTTON_LONG_PRESS_US);
+    } else if (_state == STATE_WAIT_SECOND) {
+        timer = remaining(nowUs, _releaseUs, BUTTON_DOUBLE_CLICK_US);
+    }
+    if (timer != UINT32_MAX) {
+        pending = true;
+        if (timer < soonest) soonest = timer;
+    }
+
+    if (pending) *remainingUs = soonest;
+    return pending;
+}
+
+void ButtonStateMachine::accept(bool pressed, uint32_t edgeUs) {
+    _stable    = pressed;
+    _lockout   = true;
+    _lockoutUs = edgeUs;
+
+    if (pressed) {
+        _pressUs = edgeUs;
+        _state = _state == STATE_WAIT_SECOND ? STATE_SECOND_PRESSED
+                                             : STATE_PRESSED;
+        emit(BUTTON_PRESS, edgeUs);
+        return;
+    }
+
+    emit(BUTTON_RELEASE, edgeUs);
+    switch (_state) {
+        case STATE_PRESSED:
+            _state     = STATE_WAIT_SECOND;
+            _releaseUs = edgeUs;
+            break;
+        case STATE_SECOND_PRESSED:
+            _state = STATE_IDLE;
+            emit(BUTTON_DOUBLE_CLICK, edgeUs);
+            break;
+        default:
+            _state = STATE_IDLE;
+            break;
+    }
+}
+
+void ButtonStateMachine::emit(button_event_type_t type, uint32_t edgeUs) {
+    if (_callback == nullptr) return;
+    ButtonEvent event;
+    event.button = _button;
+    event.type   = type;
+    event.edgeUs = edgeUs;
+    _callback(event, _context);
+}
@@ -0,0 +1,77 @@
+#ifndef _BUTTON_STATE_MACHINE_H_
+#define _BUTTON_STATE_MACHINE_H_
+
+#include <stdint.h>
+
+#define BUTTON_DEBOUNCE_US     20000   // Edges closer than this are bounce
+#define BUTTON_LONG_PRESS_US   800000  // Hold time for BUTTON_LONG_PRESS
+#define BUTTON_DOUBLE_CLICK_US 300000  // Max gap between two clicks
+
+typedef enum {
+    BUTTON_PRESS,         // Debounced press, fired on the first edge
+    BUTTON_RELEASE,       // Debounced release
+    BUTTON_CLICK,         // Short press not followed by a second one
+    BUTTON_DOUBLE_CLICK,  // Two short presses within BUTTON_DOUBLE_CLICK_US
+    BUTTON_LONG_PRESS,    // Held for BUTTON_LONG_PRESS_US
+} button_event_type_t;
+
+typedef struct {
+    uint8_t button;            // Index passed to begin()
+    button_event_type_t type;
+    uint32_t edgeUs;           // Time of the edge that caused the event
+} ButtonEvent;
+
+typedef void (*ButtonEventCallback)(const ButtonEvent& event, void* context);
+
+// Debounce / click / double-click / long-press logic for one button.
+//
+// Pure logic with no hardware access: feed it raw edges with onEdge() and
+// call onTick() whenever nextDeadline() expires. The first edge of a press
+// is accepted immediately (no added latency) and the following
+// BUTTON_DEBOUNCE_US are a lockout window; if the raw level at the end of
+// the window differs from the accepted one, that transition is accepted
+// then. Times are free-running microseconds, wrap-around safe.
+class ButtonStateMachine {
+   public:
+    ButtonStateMachine();
+
+    void begin(uint8_t button, ButtonEventCallback callback, void* context);
+
+    void onEdge(bool pressed, uint32_t nowUs);
+    void onTick(uint32_t nowUs);
+
+    // Microseconds until onTick() has work to do. Returns false if the
+    // machine is idle and only a new edge can change its state.
+    bool nextDeadline(uint32_t nowUs, uint32_t* remainingUs) const;
+
+    bool isPressed() const {
+        return _stable;
+    }
+
+   private:
+    enum State {
+        STATE_IDLE,
+        STATE_PRESSED,
+        STATE_LONG_HELD,
+        STATE_WAIT_SECOND,
+        STATE_SECOND_PRESSED,
+    };
+
+    void accept(bool pressed, uint32_t edgeUs);
+    void emit(button_event_type_t type, uint32_t edgeUs);
+
+    uint8_t _button;
+    ButtonEventCallback _callback;
+    void* _context;
+
+    State _state;
+    bool _stable;
+    bool _raw;
+    uint32_t _rawUs;
+    bool _lockout;
+    uint32_t _lockoutUs;
+    uint32_t _pressUs;
+    uint32_t _releaseUs;
+};
+
+#endif
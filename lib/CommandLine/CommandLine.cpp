@@ -0,0 +1,80 @@
+#include "CommandLine.h"
+
+#include <string.h>
+
+CommandLine::CommandLine()
+    : _stream(NULL), _commandCount(0), _length(0), _overflow(false) {
+}
+
+void CommandLine::begin(Stream* stream) {
+    _stream   = stream;
+    _length   = 0;
+    _overflow = false;
+}
+
+bool CommandLine::addCommand(const char* name, const char* help,
+                             CommandHandler handler, void* context) {
+    if (_commandCount >= COMMAND_MAX_COMMANDS) return false;
+    Command& command = _commands[_commandCount++];
+    command.name     = name;
+    command.help     = help;
+    command.handler  = handler;
+    command.context  = context;
+    return true;
+}
+
+void CommandLine::poll() {
+    if (!_stream) return;
+
+    while (_stream->available() > 0) {
+        int c = _stream->read();
+        if (c < 0) break;
+
+        if (c == '\r' || c == '\n') {
+            if (_overflow) {
+                _stream->println("Line too long");
+            } else if (_length > 0) {
+                _line[_length] = '\0';
+                execute(_line);
+            }
+            _length   = 0;
+            _overflow = false;
+        } else if (_length < COMMAND_LINE_MAX - 1) {
+            _line[_length++] = (char)c;
+        } else {
+            _overflow = true;
+        }
+    }
+}
+
+bool CommandLine::execute(char* line) {
+    char* argv[COMMAND_MAX_ARGS];
+    int argc = 0;
+
+    char* word = strtok(line, " \t");
+    while (word && argc < COMMAND_MAX_ARGS) {
+        argv[argc++] = word;
+        word         = strtok(NULL, " \t");
+    }
+    if (argc == 0) return false;
+
+    if (strcmp(argv[0], "help") == 0) {
+        printHelp();
+        return true;
+    }
+    for (uint8_t i = 0; i < _commandCount; i++) {
+        if (strcmp(argv[0], _commands[i].name) == 0) {
+            _commands[i].handler(argc, argv, _stream, _commands[i].context);
+            return true;
+        }
+    }
+    if (_stream) _stream->printf("Unknown command '%s', try help\n", argv[0]);
+    return false;
+}
+
+void CommandLine::printHelp() {
+    if (!_stream) return;
+    for (uint8_t i = 0; i < _commandCount; i++) {
+        _stream->printf("%-10s %s\n", _commands[i].name, _commands[i].help);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef _COMMAND_LINE_H_
+#define _COMMAND_LINE_H_
+
+#include "Arduino.h"
+
+#define COMMAND_MAX_COMMANDS 16
+#define COMMAND_LINE_MAX     64
+#define COMMAND_MAX_ARGS     8
+
+// argv[0] is the command name; output goes to the stream the line came from
+typedef void (*CommandHandler)(int argc, char* argv[], Print* out,
+                               void* context);
+
+// Line based serial command interpreter.
+//
+// poll() consumes whatever the stream has buffered without blocking and
+// runs the matching handler for every complete line. Words are separated
+// by spaces; "help" lists the registered commands.
+class CommandLine {
+   public:
+    CommandLine();
+
+    void begin(Stream* stream);
+    bool addCommand(const char* name, const char* help, CommandHandler handler,
+                    void* context = NULL);
+
+    void poll();
+    // Runs one line; the buffer is split in place
+    bool execute(char* line);
+
+   private:
+    typedef struct {
+        const char* name;
+        const char* help;
+        CommandHandler handler;
+        void* context;
+    } Command;
+
+    void printHelp();
+
+    Stream* _stream;
+    Command _commands[COMMAND_MAX_COMMANDS];
+    uint8_t _commandCount;
+    char _line[COMMAND_LINE_MAX];
+    uint8_t _length;
+    bool _overflow;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "FrameGovernor.h"
+
+FrameGovernor::FrameGovernor(uint32_t minPeriodMs, uint32_t heartbeatMs)
+    : _minPeriodMs(minPeriodMs),
+      _heartbeatMs(heartbeatMs),
+      _lastKey(0),
+      _lastFrameMs(0),
+      _drawn(false),
+      _requested(false),
+      _stats() {
+}
+
+bool FrameGovernor::shouldDraw(uint32_t key, uint32_t nowMs) {
+    _stats.polls++;
+    uint32_t since = nowMs - _lastFrameMs;
+    bool changed   = !_drawn || _requested || key != _lastKey;
+
+    if (changed) {
+        if (_drawn && since < _minPeriodMs) {
+            _stats.deferred++;
+            return false;
+        }
+        _stats.changeFrames++;
+    } else if (since >= _heartbeatMs) {
+        _stats.heartbeatFrames++;
+    } else {
+        return false;
+    }
+
+    _lastKey     = key;
+    _lastFrameMs = nowMs;
+    _drawn       = true;
+    _requested   = false;
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef _FRAME_GOVERNOR_H_
+#define _FRAME_GOVERNOR_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t polls;            // Calls to shouldDraw()
+    uint32_t changeFrames;     // Frames drawn for a new key or a request
+    uint32_t heartbeatFrames;  // Frames drawn because nothing changed
+    uint32_t deferred;         // Polls that held a change back for the cap
+} GovernorStats;
+
+// FNV-1a hash of the values a frame would show, each already reduced to
+// its display precision, so the key only changes when the screen would.
+class FrameKey {
+   public:
+    FrameKey() : _hash(2166136261u) {
+    }
+
+    FrameKey& add(int32_t value) {
+        for (int i = 0; i < 4; i++) {
+            _hash ^= (uint8_t)(value >> (8 * i));
+            _hash *= 16777619u;
+        }
+        return *this;
+    }
+
+    uint32_t value() const {
+        return _hash;
+    }
+
+   private:
+    uint32_t _hash;
+};
+
+// Decides when the UI draws a frame.
+//
+// The caller polls often and passes the key of what it would show. A frame
+// is drawn when the key differs from the last drawn one, but no sooner than
+// minPeriodMs after the previous frame; a change that comes too early is
+// drawn at the first poll after that. While the key stays the same only a
+// heartbeat frame is drawn every heartbeatMs.
+class FrameGovernor {
+   public:
+    FrameGovernor(uint32_t minPeriodMs, uint32_t heartbeatMs);
+
+    // True when a frame should be drawn now; the frame is then counted as
+    // drawn with this key
+    bool shouldDraw(uint32_t key, uint32_t nowMs);
+    // Draws the next frame as soon as the cap allows, even if the key is
+    // unchanged (e.g. after the canvas was invalidated)
+    void request() {
+        _requested = true;
+    }
+
+    const GovernorStats& stats() const {
+        return _stats;
+    }
+    void resetStats() {
+        _stats = GovernorStats();
+    }
+
+   private:
+    uint32_t _minPeriodMs;
+    uint32_t _heartbeatMs;
+    uint32_t _lastKey;
+    uint32_t _lastFrameMs;
+    bool _drawn;  // False until the first frame
+    bool _requested;
+
+    GovernorStats _stats;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "I2CQueue.h"
+
+#include <chrono>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+I2CQueue::I2CQueue() : _bus(NULL), _head(0), _tail(0), _stats() {
+}
+
+bool I2CQueue::begin(I2C_Class* bus, bool startTask, uint8_t priority,
+                     int core) {
+    _bus = bus;
+    if (!startTask) return true;
+#ifdef ESP_PLATFORM
+    return xTaskCreatePinnedToCore(task, "I2C Queue", 3072, this, priority,
+                                   NULL, core) == pdPASS;
+#else
+    (void)priority;
+    (void)core;
+    return false;
+#endif
+}
+
+bool I2CQueue::submit(I2CRequest* request) {
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_head - _tail >= I2CQUEUE_DEPTH) {
+        _stats.rejected++;
+        return false;
+    }
+    request->state.store(I2C_PENDING, std::memory_order_relaxed);
+    // Submission time until the owner picks the request up
+    request->queuedUs = (uint32_t)_bus->nowUs();
+    request->busUs    = 0;
+    _requests[_head++ & (I2CQUEUE_DEPTH - 1)] = request;
+    _stats.submitted++;
+    if (_head - _tail > _stats.maxDepth) _stats.maxDepth = _head - _tail;
+    _submitted.notify_one();
+    return true;
+}
+
+bool I2CQueue::wait(I2CRequest* request, uint32_t timeoutMs) {
+    std::unique_lock<std::mutex> guard(_lock);
+    _finished.wait_for(guard, std::chrono::milliseconds(timeoutMs),
+                       [request] { return request->finished(); });
+    return request->state.load(std::memory_order_acquire) == I2C_DONE;
+}
+
+bool I2CQueue::transfer(I2CRequest* request, uint32_t timeoutMs) {
+    return submit(request) && wait(request, timeoutMs);
+}
+
+bool I2CQueue::process(uint32_t timeoutMs) {
+    I2CRequest* request;
+    {
+        std::unique_lock<std::mutex> guard(_lock);
+        if (!_submitted.wait_for(guard, std::chrono::milliseconds(timeoutMs),
+                                 [this] { return _head != _tail; })) {
+            return false;
+        }
+        request = _requests[_tail++ & (I2CQUEUE_DEPTH - 1)];
+    }
+
+    uint32_t start = (uint32_t)_bus->nowUs();
+    request->queuedUs = start - request->queuedUs;
+    bool ok           = execute(request);
+    request->busUs    = (uint32_t)_bus->nowUs() - start;
+
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stats.completed++;
+        if (!ok) _stats.failed++;
+        _stats.queuedUs += request->queuedUs;
+        _stats.busUs += request->busUs;
+        if (request->queuedUs > _stats.maxQueuedUs) {
+            _stats.maxQueuedUs = request->queuedUs;
+        }
+    }
+    // Once the state is published the caller may free the request, so the
+    // callback runs first
+    if (request->callback != NULL) {
+        request->callback(request, ok, request->context);
+    }
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        request->state.store(ok ? I2C_DONE : I2C_FAILED,
+                             std::memory_order_release);
+    }
+    _finished.notify_all();
+    return true;
+}
+
+bool I2CQueue::execute(I2CRequest* request) {
+    switch (request->op) {
+        case I2C_WRITE:
+            if (request->regBytes == 2) {
+                return _bus->writeBytes16(request->addr, request->reg,
+                                          request->buffer, request->length);
+            }
+            return _bus->writeBytes(request->addr, (uint8_t)request->reg,
+                                    request->buffer, request->length);
+        case I2C_READ:
+            return _bus->readBytes(request->addr, request->buffer,
+                                   request->length);
+        case I2C_WRITE_READ:
+            if (request->regBytes == 2) {
+                return _bus->readBytes16(request->addr, request->reg,
+                                         request->buffer, request->length);
+            }
+            return _bus->readBytes(request->addr, (uint8_t)request->reg,
+                                   request->buffer, request->length);
+    }
+    return false;
+}
+
+size_t I2CQueue::depth() {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _head - _tail;
+}
+
+I2CQueueStats I2CQueue::stats() {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _stats;
+}
+
+void I2CQueue::resetStats() {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stats = I2CQueueStats();
+}
+
+#ifdef ESP_PLATFORM
+void I2CQueue::task(void* arg) {
+    I2CQueue* self = (I2CQueue*)arg;
+    for (;;) {
+        self->process(1000);
+    }
+}
+#endif
@@ -0,0 +1,133 @@
+#ifndef _I2C_QUEUE_H_
+#define _I2C_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "I2C_Class.h"
+
+#define I2CQUEUE_DEPTH 16  // Requests waiting for the bus, power of two
+
+typedef enum {
+    I2C_WRITE,       // Register (if any) followed by data
+    I2C_READ,        // Plain read, no register address
+    I2C_WRITE_READ,  // Register, repeated start, read
+} I2COperation;
+
+typedef enum {
+    I2C_PENDING,
+    I2C_DONE,
+    I2C_FAILED,
+} I2CRequestState;
+
+struct I2CRequest;
+// Called in the bus owner's context when the transaction is over, just
+// before the request counts as finished
+typedef void (*I2CCallback)(I2CRequest* request, bool ok, void* context);
+
+// One bus transaction. The caller owns the request and must keep it alive
+// and unchanged until it has finished; it can be submitted again after
+// that, but not from its own callback.
+struct I2CRequest {
+    uint8_t op;        // I2COperation
+    uint8_t addr;
+    uint8_t regBytes;  // 1 or 2; I2C_READ ignores the register
+    uint16_t reg;
+    uint8_t* buffer;   // Data to write or room for the data read
+    size_t length;
+
+    I2CCallback callback;  // May be NULL
+    void* context;
+
+    // Set by the queue
+    std::atomic<uint8_t> state;  // I2CRequestState
+    uint32_t queuedUs;           // Time spent waiting for the bus
+    uint32_t busUs;              // Time spent executing
+
+    I2CRequest()
+        : op(I2C_WRITE_READ),
+          addr(0),
+          regBytes(1),
+          reg(0),
+          buffer(NULL),
+          length(0),
+          callback(NULL),
+          context(NULL),
+          state(I2C_DONE),
+          queuedUs(0),
+          busUs(0) {
+    }
+
+    bool finished() const {
+        return state.load(std::memory_order_acquire) != I2C_PENDING;
+    }
+};
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t completed;   // Including failed ones
+    uint32_t failed;
+    uint32_t rejected;    // submit() with the queue full
+    uint32_t maxDepth;    // Most requests waiting at once
+    uint64_t queuedUs;    // Sums over completed requests
+    uint64_t busUs;
+    uint32_t maxQueuedUs;
+} I2CQueueStats;
+
+// Asynchronous transactions on one I2C_Class bus.
+//
+// Any task submits requests; a single bus owner executes them back to back
+// in submission order and then calls the request's callback, so callers
+// never block on the bus unless they choose to wait(). On the ESP32
+// begin() starts the owner as a FreeRTOS task; elsewhere (host tests on a
+// simulated I2CBus) the owner is whatever thread calls process().
+//
+// Each request is one I2C_Class transaction and takes the bus lock at the
+// priority of its device address, so drivers calling the I2C_Class
+// directly can share the bus with the queue. Queue times are measured
+// with the clock of the I2C_Class.
+class I2CQueue {
+   public:
+    I2CQueue();
+
+    // Without a task the caller has to run process() itself
+    bool begin(I2C_Class* bus, bool startTask = true, uint8_t priority = 4,
+               int core = 0);
+
+    // Queues request; false (and counted) when the queue is full
+    bool submit(I2CRequest* request);
+    // Blocks until request has finished or timeoutMs passed; true on
+    // success of the transaction
+    bool wait(I2CRequest* request, uint32_t timeoutMs);
+    // submit() and wait() in one
+    bool transfer(I2CRequest* request, uint32_t timeoutMs);
+
+    // Bus owner: executes the oldest request, waiting up to timeoutMs for
+    // one. False if none arrived.
+    bool process(uint32_t timeoutMs);
+
+    size_t depth();
+    I2CQueueStats stats();
+    void resetStats();
+
+   private:
+#ifdef ESP_PLATFORM
+    static void task(void* arg);
+#endif
+    bool execute(I2CRequest* request);
+
+    I2C_Class* _bus;
+    I2CRequest* _requests[I2CQUEUE_DEPTH];
+    uint32_t _head;  // Free-running, guarded by _lock
+    uint32_t _tail;
+    std::mutex _lock;
+    std::condition_variable _submitted;  // Work for the owner
+    std::condition_variable _finished;   // Some request finished
+    I2CQueueStats _stats;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _I2C_BUS_H_
+#define _I2C_BUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Results of I2CBus::write, the codes of TwoWire::endTransmission()
+#define I2C_BUS_OK        0
+#define I2C_BUS_OVERFLOW  1  // More data than the driver can send at once
+#define I2C_BUS_ADDR_NACK 2
+#define I2C_BUS_DATA_NACK 3
+#define I2C_BUS_ERROR     4
+#define I2C_BUS_TIMEOUT   5
+
+// Microsecond clock for latency and wait statistics
+typedef uint64_t (*I2CClock)(void);
+
+// esp_timer on the ESP32, std::chrono::steady_clock elsewhere
+uint64_t i2cClockUs(void);
+
+// Byte transfers on one I2C bus, the part of TwoWire that I2C_Class uses.
+//
+// WireBus implements it on the Arduino TwoWire. Host tests supply a
+// simulated bus, so I2C_Class and everything built on it runs without
+// Arduino.
+class I2CBus {
+   public:
+    virtual ~I2CBus() {
+    }
+
+    // START (or repeated START), address with write, then data. With stop
+    // false the bus stays claimed for a read after a repeated START.
+    // Returns an I2C_BUS_* code.
+    virtual uint8_t write(uint8_t addr, const uint8_t* data, size_t length,
+                          bool stop) = 0;
+    // (Repeated) START, address with read, length bytes, STOP. Returns the
+    // bytes received, less than length when the device did not answer.
+    virtual size_t read(uint8_t addr, uint8_t* data, size_t length) = 0;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "I2CBusLock.h"
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+I2CBusLock::I2CBusLock()
+    : _clock(i2cClockUs),
+      _held(false),
+      _waiting(),
+#ifdef ESP_PLATFORM
+      _holder(NULL),
+      _holderPriority(0),
+      _raisedPriority(0),
+#endif
+      _stats() {
+}
+
+void I2CBusLock::acquire(uint8_t priority) {
+    if (priority >= I2C_PRIORITY_LEVELS) priority = I2C_PRIORITY_LEVELS - 1;
+#ifdef ESP_PLATFORM
+    // Read before taking _mutex: it inherits priorities, so inside it this
+    // could be a waiter's priority that release() would then make permanent
+    unsigned taskPriority = uxTaskPriorityGet(NULL);
+#endif
+    std::unique_lock<std::mutex> guard(_mutex);
+    I2CBusStats& stats = _stats[priority];
+    stats.transactions++;
+    if (!_held && !higherWaiting(priority)) {
+        _held = true;
+#ifdef ESP_PLATFORM
+        _holder         = xTaskGetCurrentTaskHandle();
+        _holderPriority = taskPriority;
+        _raisedPriority = 0;
+#endif
+        return;
+    }
+
+    uint32_t start = (uint32_t)_clock();
+    _waiting[priority]++;
+#ifdef ESP_PLATFORM
+    inherit(taskPriority);
+#endif
+    _released.wait(guard, [this, priority] {
+        return !_held && !higherWaiting(priority);
+    });
+    _waiting[priority]--;
+    _held = true;
+#ifdef ESP_PLATFORM
+    _holder         = xTaskGetCurrentTaskHandle();
+    _holderPriority = taskPriority;
+    _raisedPriority = 0;
+#endif
+
+    uint32_t waited = (uint32_t)_clock() - start;
+    stats.contended++;
+    stats.waitUs += waited;
+    if (waited > stats.maxWaitUs) stats.maxWaitUs = waited;
+}
+
+void I2CBusLock::release() {
+#ifdef ESP_PLATFORM
+    unsigned raised  = 0;
+    unsigned restore = 0;
+#endif
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _held = false;
+#ifdef ESP_PLATFORM
+        raised          = _raisedPriority;
+        restore         = _holderPriority;
+        _holder         = NULL;
+        _raisedPriority = 0;
+#endif
+    }
+    // Every waiter rechecks; only the highest priority one proceeds
+    _released.notify_all();
+#ifdef ESP_PLATFORM
+    // Back to its own priority only after the waiters were woken, or a
+    // middle priority task could run before the raised waiter gets the bus.
+    // A priority changed since the raise is someone else's and stays.
+    if (raised != 0 && uxTaskPriorityGet(NULL) == raised) {
+        vTaskPrioritySet(NULL, restore);
+    }
+#endif
+}
+
+#ifdef ESP_PLATFORM
+// Called with _mutex held by a task about to wait for the bus, with the
+// task priority it read before locking
+void I2CBusLock::inherit(unsigned mine) {
+    if (_holder == NULL) return;
+    unsigned current =
+        _raisedPriority != 0 ? _raisedPriority : _holderPriority;
+    if (mine <= current) return;
+    _raisedPriority = mine;
+    vTaskPrioritySet((TaskHandle_t)_holder, mine);
+}
+#endif
+
+I2CBusStats I2CBusLock::stats(uint8_t priority) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (priority >= I2C_PRIORITY_LEVELS) return I2CBusStats();
+    return _stats[priority];
+}
+
+void I2CBusLock::resetStats() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    for (int i = 0; i < I2C_PRIORITY_LEVELS; i++) _stats[i] = I2CBusStats();
+}
+
+bool I2CBusLock::higherWaiting(uint8_t priority) const {
+    for (int i = priority + 1; i < I2C_PRIORITY_LEVELS; i++) {
+        if (_waiting[i] > 0) return true;
+    }
+    return false;
+}
@@ -0,0 +1,94 @@
+#ifndef _I2C_BUS_LOCK_H_
+#define _I2C_BUS_LOCK_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+
+#include "I2CBus.h"
+
+// Bus priorities, higher wins
+#define I2C_PRIORITY_LOW    0  // Slow housekeeping, e.g. CO2 commands
+#define I2C_PRIORITY_NORMAL 1
+#define I2C_PRIORITY_HIGH   2  // Sampling that must keep its timing
+#define I2C_PRIORITY_LEVELS 3
+
+typedef struct {
+    uint32_t transactions;  // Acquisitions at this priority
+    uint32_t contended;     // Of those, how many had to wait
+    uint64_t waitUs;        // Total time spent waiting
+    uint32_t maxWaitUs;
+} I2CBusStats;
+
+// Mutex for one I2C bus that hands the bus to the highest priority waiter.
+//
+// A transaction in progress is never interrupted; when it ends, waiters of
+// a lower priority stay blocked as long as a higher one is waiting. Within
+// one priority the order is whatever the scheduler picks. Time spent
+// waiting is recorded per priority.
+//
+// The bus priority only orders the waiters. While a low priority task
+// holds the bus, a task of middle FreeRTOS priority could preempt it and
+// keep a high priority waiter blocked for as long as it runs (priority
+// inversion). On the ESP32 a waiter therefore raises the holder to its
+// own task priority until release(), like a FreeRTOS mutex does. Limits:
+// - The holder returns to the task priority it read before locking, and
+//   only if it still runs at the priority it was raised to; a priority
+//   set by anyone else in the meantime is left alone.
+// - Only the holder is raised. A chain (the holder itself waiting on
+//   another lock) is not followed.
+// - Host builds on std::thread have no inheritance; there the OS scheduler
+//   alone decides how long a preempted holder keeps the bus.
+class I2CBusLock {
+   public:
+    I2CBusLock();
+
+    // Clock for the wait statistics, i2cClockUs by default
+    void setClock(I2CClock clock) {
+        _clock = clock;
+    }
+
+    void acquire(uint8_t priority);
+    void release();
+
+    I2CBusStats stats(uint8_t priority);
+    void resetStats();
+
+   private:
+    bool higherWaiting(uint8_t priority) const;
+#ifdef ESP_PLATFORM
+    void inherit(unsigned mine);
+#endif
+
+    I2CClock _clock;
+    std::mutex _mutex;
+    std::condition_variable _released;
+    bool _held;
+    uint16_t _waiting[I2C_PRIORITY_LEVELS];
+#ifdef ESP_PLATFORM
+    void* _holder;             // TaskHandle_t of the task on the bus
+    unsigned _holderPriority;  // Its task priority before any raise
+    unsigned _raisedPriority;  // 0 when not raised
+#endif
+    I2CBusStats _stats[I2C_PRIORITY_LEVELS];
+};
+
+// Holds the bus for the lifetime of the guard
+class I2CBusGuard {
+   public:
+    I2CBusGuard(I2CBusLock& lock, uint8_t priority) : _lock(lock) {
+        _lock.acquire(priority);
+    }
+    ~I2CBusGuard() {
+        _lock.release();
+    }
+
+   private:
+    I2CBusGuard(const I2CBusGuard&);
+    I2CBusGuard& operator=(const I2CBusGuard&);
+
+    I2CBusLock& _lock;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "I2CRegisterShadow.h"
+
+#include <string.h>
+
+I2CRegisterShadow::I2CRegisterShadow(uint8_t addr)
+    : _addr(addr), _readsSaved(0) {
+    memset(_cached, 0, sizeof(_cached));
+    memset(_valid, 0, sizeof(_valid));
+    memset(_values, 0, sizeof(_values));
+}
+
+void I2CRegisterShadow::setCached(uint8_t first, uint8_t last, bool cached) {
+    for (unsigned reg = first; reg <= last; reg++) {
+        uint32_t bit = 1UL << (reg & 31);
+        if (cached) {
+            _cached[reg >> 5] |= bit;
+        } else {
+            _cached[reg >> 5] &= ~bit;
+        }
+        _valid[reg >> 5] &= ~bit;
+    }
+}
+
+bool I2CRegisterShadow::lookup(uint8_t reg, uint8_t* value) const {
+    if (!testBit(_cached, reg) || !testBit(_valid, reg)) return false;
+    *value = _values[reg];
+    return true;
+}
+
+void I2CRegisterShadow::store(uint8_t reg, uint8_t value) {
+    if (!testBit(_cached, reg)) return;
+    _values[reg] = value;
+    _valid[reg >> 5] |= 1UL << (reg & 31);
+}
+
+void I2CRegisterShadow::forget(uint8_t reg) {
+    _valid[reg >> 5] &= ~(1UL << (reg & 31));
+}
+
+void I2CRegisterShadow::invalidate() {
+    memset(_valid, 0, sizeof(_valid));
+}
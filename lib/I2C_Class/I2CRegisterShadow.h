@@ -0,0 +1,56 @@
+#ifndef _I2C_REGISTER_SHADOW_H_
+#define _I2C_REGISTER_SHADOW_H_
+
+#include <stdint.h>
+
+// Copy of the non-volatile registers of one device with 8-bit register
+// addresses.
+//
+// Registers are volatile (never cached) unless marked with setCached().
+// Once attached to the I2C_Class of its bus, every read or write of a
+// cached register updates the copy, and writeBitOn/Off on a register with
+// a known value becomes a single write instead of a read plus a write.
+// Mark only registers that nothing but this driver changes: no status
+// bits, no self-clearing bits. A failed write forgets the value.
+class I2CRegisterShadow {
+   public:
+    explicit I2CRegisterShadow(uint8_t addr);
+
+    uint8_t addr() const {
+        return _addr;
+    }
+
+    // Declares registers first..last as non-volatile (or volatile again)
+    void setCached(uint8_t first, uint8_t last, bool cached = true);
+    bool isCached(uint8_t reg) const {
+        return testBit(_cached, reg);
+    }
+
+    // Value of reg if it is cached and known
+    bool lookup(uint8_t reg, uint8_t* value) const;
+    // Records a value seen on the bus; ignored for volatile registers
+    void store(uint8_t reg, uint8_t value);
+    void forget(uint8_t reg);
+    void invalidate();
+
+    // Bus reads avoided by lookup() hits
+    uint32_t readsSaved() const {
+        return _readsSaved;
+    }
+    void countSaved() {
+        _readsSaved++;
+    }
+
+   private:
+    static bool testBit(const uint32_t* bits, uint8_t reg) {
+        return (bits[reg >> 5] >> (reg & 31)) & 1;
+    }
+
+    uint8_t _addr;
+    uint32_t _cached[8];  // Bitmaps over the 256 register addresses
+    uint32_t _valid[8];
+    uint8_t _values[256];
+    uint32_t _readsSaved;
+};
+
+#endif
@@ -1,46 +1,292 @@
 #include "I2C_Class.h"
 
+#include <string.h>
+
+I2C_Class::I2C_Class()
+    : _bus(NULL),
+      _clock(i2cClockUs),
+      _shadows(),
+      _shadowCount(0),
+      _devices(),
+      _deviceCount(0),
+      _error(0),
+      _written(0),
+      _read(0) {
+    memset(_priority, I2C_PRIORITY_NORMAL, sizeof(_priority));
+}
+
+I2C_Class::Transaction::Transaction(I2C_Class *bus, uint8_t addr)
+    : _guard(bus->_lock, bus->priorityOf(addr)),
+      _bus(bus),
+      _addr(addr),
+      _startUs((uint32_t)bus->_clock()),
+      _ok(false) {
+    _bus->_error   = 0;
+    _bus->_written = 0;
+    _bus->_read    = 0;
+}
+
+I2C_Class::Transaction::~Transaction() {
+    // Still holding the bus, the guard is released after this
+    _bus->record(_addr, _ok, (uint32_t)_bus->_clock() - _startUs);
+}
+
+void I2C_Class::record(uint8_t addr, bool ok, uint32_t latencyUs) {
+    std::lock_guard<std::mutex> guard(_statsMutex);
+    I2CDeviceStats *stats = statsOf(addr);
+    if (stats == NULL) return;
+    stats->transactions++;
+    stats->bytesWritten += _written;
+    stats->bytesRead += _read;
+    if (!ok) {
+        if (_error == I2C_BUS_ADDR_NACK || _error == I2C_BUS_DATA_NACK) {
+            stats->nacks++;
+        } else if (_error == I2C_BUS_TIMEOUT) {
+            stats->timeouts++;
+        } else {
+            stats->errors++;
+        }
+    }
+    if (latencyUs > stats->maxLatencyUs) stats->maxLatencyUs = latencyUs;
+    uint8_t bucket = 0;
+    while (bucket < I2C_LATENCY_BUCKETS - 1 && (latencyUs >> bucket) != 0) {
+        bucket++;
+    }
+    stats->latency[bucket]++;
+}
+
+// Called with _statsMutex held
+I2CDeviceStats *I2C_Class::statsOf(uint8_t addr) {
+    for (uint8_t i = 0; i < _deviceCount; i++) {
+        if (_devices[i].addr == addr) return &_devices[i];
+    }
+    if (_deviceCount >= I2C_CLASS_MAX_DEVICES) return NULL;
+    I2CDeviceStats *stats = &_devices[_deviceCount++];
+    memset(stats, 0, sizeof(*stats));
+    stats->addr = addr;
+    return stats;
+}
+
+bool I2C_Class::deviceStats(uint8_t index, I2CDeviceStats *stats) {
+    std::lock_guard<std::mutex> guard(_statsMutex);
+    if (index >= _deviceCount) return false;
+    *stats = _devices[index];
+    return true;
+}
+
+void I2C_Class::resetDeviceStats() {
+    std::lock_guard<std::mutex> guard(_statsMutex);
+    _deviceCount = 0;
+}
+
+void I2C_Class::reportCrcError(uint8_t addr) {
+    std::lock_guard<std::mutex> guard(_statsMutex);
+    I2CDeviceStats *stats = statsOf(addr);
+    if (stats != NULL) stats->crcErrors++;
+}
+
+void I2C_Class::begin(I2CBus *bus, I2CClock clock) {
+    _bus   = bus;
+    _clock = clock;
+    _lock.setClock(clock);
+}
+
+#ifdef ARDUINO
 void I2C_Class::begin(TwoWire *wire, uint8_t sda, uint8_t scl, long freq) {
-    _wire = wire;
-    _sda  = sda;
-    _scl  = scl;
-    _freq = freq;
-    _wire->end();
-    _wire->begin(static_cast<int>(_sda), _scl, freq);
+    _wire.begin(wire, sda, scl, freq);
+    begin(&_wire);
 }
+#endif
 
-bool I2C_Class::exist(uint8_t addr) {
-    int error;
-    _wire->beginTransmission(addr);
-    error = _wire->endTransmission();
-    if (error == 0) {
+void I2C_Class::setPriority(uint8_t addr, uint8_t priority) {
+    _priority[addr & 0x7f] = priority;
+}
+
+bool I2C_Class::attachShadow(I2CRegisterShadow *shadow) {
+    I2CBusGuard guard(_lock, priorityOf(shadow->addr()));
+    if (_shadowCount >= I2C_CLASS_MAX_SHADOWS) return false;
+    _shadows[_shadowCount++] = shadow;
+    return true;
+}
+
+void I2C_Class::invalidateShadow(uint8_t addr) {
+    I2CBusGuard guard(_lock, priorityOf(addr));
+    I2CRegisterShadow *shadow = shadowOf(addr);
+    if (shadow != NULL) shadow->invalidate();
+}
+
+bool I2C_Class::refreshShadow(uint8_t addr) {
+    I2CRegisterShadow *shadow = shadowOf(addr);
+    if (shadow == NULL) return false;
+    Transaction transaction(this, addr);
+    // Runs of cached registers are read in bursts; readRegister stores them
+    uint8_t buffer[32];
+    unsigned reg = 0;
+    while (reg < 256) {
+        if (!shadow->isCached((uint8_t)reg)) {
+            reg++;
+            continue;
+        }
+        unsigned end = reg;
+        while (end < 256 && end - reg < sizeof(buffer) &&
+               shadow->isCached((uint8_t)end)) {
+            end++;
+        }
+        if (!readRegister(addr, (uint8_t)reg, 1, buffer, end - reg)) {
+            return transaction.finish(false);
+        }
+        reg = end;
+    }
+    return transaction.finish(true);
+}
+
+bool I2C_Class::verifyShadow(uint8_t addr, uint16_t *mismatches) {
+    I2CRegisterShadow *shadow = shadowOf(addr);
+    if (mismatches != NULL) *mismatches = 0;
+    if (shadow == NULL) return false;
+    Transaction transaction(this, addr);
+    bool ok     = true;
+    bool failed = false;
+    for (unsigned reg = 0; reg < 256; reg++) {
+        uint8_t expected, actual;
+        if (!shadow->lookup((uint8_t)reg, &expected)) continue;
+        if (!readRegister(addr, (uint8_t)reg, 1, &actual, 1)) {
+            shadow->forget((uint8_t)reg);
+            failed = true;
+        } else if (actual != expected) {
+            if (mismatches != NULL) (*mismatches)++;
+            ok = false;
+        }
+    }
+    // A mismatch is not a bus failure
+    transaction.finish(!failed);
+    return ok && !failed;
+}
+
+I2CRegisterShadow *I2C_Class::shadowOf(uint8_t addr) const {
+    for (uint8_t i = 0; i < _shadowCount; i++) {
+        if (_shadows[i]->addr() == addr) return _shadows[i];
+    }
+    return NULL;
+}
+
+bool I2C_Class::readForModify(uint8_t addr, uint8_t reg, uint8_t *value) {
+    I2CRegisterShadow *shadow = shadowOf(addr);
+    if (shadow != NULL && shadow->lookup(reg, value)) {
+        shadow->countSaved();
         return true;
     }
-    return false;
+    return readRegister(addr, reg, 1, value, 1);
 }
 
-bool I2C_Class::writeBytes(uint8_t addr, uint8_t reg, uint8_t *buffer,
-                           uint8_t length) {
-    _wire->beginTransmission(addr);
-    _wire->write(reg);
-    _wire->write(buffer, length);
-    if (_wire->endTransmission() == 0) return true;
-    return false;
+bool I2C_Class::exist(uint8_t addr) {
+    Transaction transaction(this, addr);
+    _error = _bus->write(addr, NULL, 0, true);
+    return transaction.finish(_error == I2C_BUS_OK);
+}
+
+bool I2C_Class::writeBytes(uint8_t addr, uint8_t reg, const uint8_t *buffer,
+                           size_t length) {
+    Transaction transaction(this, addr);
+    return transaction.finish(writeRegister(addr, reg, 1, buffer, length));
 }
 
 bool I2C_Class::readBytes(uint8_t addr, uint8_t reg, uint8_t *buffer,
-                          uint8_t length) {
-    uint8_t index = 0;
-    _wire->beginTransmission(addr);
-    _wire->write(reg);
-    _wire->endTransmission();
-    if (_wire->requestFrom(addr, length)) {
-        for (uint8_t i = 0; i < length; i++) {
-            buffer[index++] = _wire->read();
+                          size_t length) {
+    Transaction transaction(this, addr);
+    return transaction.finish(readRegister(addr, reg, 1, buffer, length));
+}
+
+bool I2C_Class::writeBytes16(uint8_t addr, uint16_t reg,
+                             const uint8_t *buffer, size_t length) {
+    Transaction transaction(this, addr);
+    return transaction.finish(writeRegister(addr, reg, 2, buffer, length));
+}
+
+bool I2C_Class::readBytes16(uint8_t addr, uint16_t reg, uint8_t *buffer,
+                            size_t length) {
+    Transaction transaction(this, addr);
+    return transaction.finish(readRegister(addr, reg, 2, buffer, length));
+}
+
+bool I2C_Class::readBytes(uint8_t addr, uint8_t *buffer, size_t length) {
+    Transaction transaction(this, addr);
+    for (size_t done = 0; done < length; done += I2C_CLASS_CHUNK) {
+        size_t chunk = length - done;
+        if (chunk > I2C_CLASS_CHUNK) chunk = I2C_CLASS_CHUNK;
+        if (!receive(addr, buffer + done, chunk)) {
+            return transaction.finish(false);
+        }
+    }
+    return transaction.finish(true);
+}
+
+bool I2C_Class::writeRegister(uint8_t addr, uint16_t reg, uint8_t regBytes,
+                              const uint8_t *buffer, size_t length) {
+    I2CRegisterShadow *shadow = shadowOf(addr);
+    uint8_t frame[2 + I2C_CLASS_CHUNK];
+    size_t done = 0;
+    do {
+        size_t chunk = length - done;
+        if (chunk > I2C_CLASS_CHUNK) chunk = I2C_CLASS_CHUNK;
+        uint16_t at   = (uint16_t)(reg + done);
+        size_t header = 0;
+        if (regBytes == 2) frame[header++] = (uint8_t)(at >> 8);
+        frame[header++] = (uint8_t)(at & 0xff);
+        if (chunk > 0) memcpy(frame + header, buffer + done, chunk);
+        _error  = _bus->write(addr, frame, header + chunk, true);
+        bool ok = _error == I2C_BUS_OK;
+        if (ok) _written += regBytes + chunk;
+        if (regBytes == 1 && shadow != NULL) {
+            // After a failed write the register content is unknown
+            for (size_t i = 0; i < chunk; i++) {
+                if (ok) {
+                    shadow->store((uint8_t)(at + i), buffer[done + i]);
+                } else {
+                    shadow->forget((uint8_t)(at + i));
+                }
+            }
+        }
+        if (!ok) return false;
+        done += chunk;
+    } while (done < length);
+    return true;
+}
+
+bool I2C_Class::readRegister(uint8_t addr, uint16_t reg, uint8_t regBytes,
+                             uint8_t *buffer, size_t length) {
+    I2CRegisterShadow *shadow = shadowOf(addr);
+    for (size_t done = 0; done < length; done += I2C_CLASS_CHUNK) {
+        size_t chunk = length - done;
+        if (chunk > I2C_CLASS_CHUNK) chunk = I2C_CLASS_CHUNK;
+        uint16_t at = (uint16_t)(reg + done);
+        uint8_t header[2];
+        uint8_t headerBytes = 0;
+        if (regBytes == 2) header[headerBytes++] = (uint8_t)(at >> 8);
+        header[headerBytes++] = (uint8_t)(at & 0xff);
+        // No STOP: the data follows after a repeated start
+        _error = _bus->write(addr, header, headerBytes, false);
+        if (_error != I2C_BUS_OK) return false;
+        _written += regBytes;
+        if (!receive(addr, buffer + done, chunk)) return false;
+        if (regBytes == 1 && shadow != NULL) {
+            for (size_t i = 0; i < chunk; i++) {
+                shadow->store((uint8_t)(at + i), buffer[done + i]);
+            }
         }
-        return true;
     }
-    return false;
+    return true;
+}
+
+bool I2C_Class::receive(uint8_t addr, uint8_t *buffer, size_t length) {
+    size_t received = _bus->read(addr, buffer, length);
+    _read += received;
+    if (received != length) {
+        // Counted as a NACK: the device did not answer
+        _error = I2C_BUS_ADDR_NACK;
+        return false;
+    }
+    return true;
 }
 
 bool I2C_Class::readU16(uint8_t addr, uint8_t reg_addr, uint16_t *value) {
@@ -58,36 +304,33 @@ bool I2C_Class::writeU16(uint8_t addr, uint8_t reg_addr, uint16_t value) {
 }
 
 bool I2C_Class::writeByte(uint8_t addr, uint8_t reg, uint8_t data) {
-    _wire->beginTransmission(addr);
-    _wire->write(reg);
-    _wire->write(data);
-    if (_wire->endTransmission() == 0) return true;
-    return false;
+    Transaction transaction(this, addr);
+    return transaction.finish(writeRegister(addr, reg, 1, &data, 1));
 }
 
 uint8_t I2C_Class::readByte(uint8_t addr, uint8_t reg) {
-    _wire->beginTransmission(addr);
-    _wire->write(reg);
-    _wire->endTransmission();
-
-    if (_wire->requestFrom(addr, 1)) {
-        return _wire->read();
-    }
+    uint8_t data;
+    if (readByte(addr, reg, &data)) return data;
     return 0;
 }
 
+bool I2C_Class::readByte(uint8_t addr, uint8_t reg, uint8_t *value) {
+    Transaction transaction(this, addr);
+    return transaction.finish(readRegister(addr, reg, 1, value, 1));
+}
+
 bool I2C_Class::writeBitOn(uint8_t addr, uint8_t reg, uint8_t data) {
+    Transaction transaction(this, addr);
     uint8_t temp;
-    uint8_t write_back;
-    temp       = readByte(addr, reg);
-    write_back = (temp | data);
-    return (writeByte(addr, reg, write_back));
+    if (!readForModify(addr, reg, &temp)) return transaction.finish(false);
+    uint8_t write_back = (temp | data);
+    return transaction.finish(writeRegister(addr, reg, 1, &write_back, 1));
 }
 
 bool I2C_Class::writeBitOff(uint8_t addr, uint8_t reg, uint8_t data) {
+    Transaction transaction(this, addr);
     uint8_t temp;
-    uint8_t write_back;
-    temp       = readByte(addr, reg);
-    write_back = (temp & (~data));
-    return (writeByte(addr, reg, write_back));
-}
\ No newline at end of file
+    if (!readForModify(addr, reg, &temp)) return transaction.finish(false);
+    uint8_t write_back = (temp & (~data));
+    return transaction.finish(writeRegister(addr, reg, 1, &write_back, 1));
+}
@@ -1,30 +1,183 @@
 #ifndef _I2C_DEVICE_BUS_
 #define _I2C_DEVICE_BUS_
 
-#include "Arduino.h"
-#include "Wire.h"
+#include <stddef.h>
+#include <stdint.h>
 
+#include <mutex>
+
+#include "I2CBus.h"
+#include "I2CBusLock.h"
+#include "I2CRegisterShadow.h"
+#ifdef ARDUINO
+#include "WireBus.h"
+#endif
+
+// Most data bytes moved by one bus transaction; the Wire buffer also has
+// to hold the register address
+#ifdef I2C_BUFFER_LENGTH
+#define I2C_CLASS_CHUNK (I2C_BUFFER_LENGTH - 2)
+#else
+#define I2C_CLASS_CHUNK 30
+#endif
+
+#define I2C_CLASS_MAX_SHADOWS 4  // Devices with a register shadow per bus
+#define I2C_CLASS_MAX_DEVICES 8  // Devices with their own statistics
+#define I2C_LATENCY_BUCKETS   16 // Bucket b: latencies below 2^b us, last: rest
+
+typedef struct {
+    uint8_t addr;
+    uint32_t transactions;  // Logical transactions (public calls)
+    uint32_t bytesWritten;  // Register addresses and data
+    uint32_t bytesRead;
+    uint32_t nacks;         // Address or data not acknowledged, short reads
+    uint32_t timeouts;
+    uint32_t errors;        // Other bus errors
+    uint32_t crcErrors;     // Reported by drivers
+    uint32_t maxLatencyUs;
+    uint32_t latency[I2C_LATENCY_BUCKETS];  // Log2 histogram, us
+} I2CDeviceStats;
+
+// Register access on top of an I2CBus, on the device the Arduino TwoWire.
+//
+// Register reads send the address and then read the data after a repeated
+// start, so a read is one bus transaction that no other master or task can
+// split. Transfers longer than I2C_CLASS_CHUNK are split into transactions
+// addressed at reg + offset, which suits devices that auto-increment the
+// register address. The *16 variants send a 16-bit big-endian register
+// address or command.
+//
+// One I2C_Class owns one bus and is shared by every driver on it. Each
+// public call is one logical transaction (a read-modify-write included) and
+// holds the bus lock for its whole duration, so tasks never interleave on
+// the wire. Waiters are served by the priority set for the
+// device address with setPriority().
+//
+// Devices may attach an I2CRegisterShadow, which lets writeBitOn/Off skip
+// the read of registers whose value is already known.
+//
+// Every transaction is counted per device address: bytes, failures by
+// kind and the time on the bus (without waiting for the lock) in a log2
+// histogram. Recording costs two clock reads and a few increments. The
+// clock is passed to begin(), so host tests can run on simulated time.
 class I2C_Class {
    private:
-    TwoWire* _wire;
-    uint8_t _scl;
-    uint8_t _sda;
-    long _freq;
+    I2CBus* _bus;
+    I2CClock _clock;
+#ifdef ARDUINO
+    WireBus _wire;
+#endif
+    I2CBusLock _lock;
+    uint8_t _priority[128];  // By 7-bit device address
+    I2CRegisterShadow* _shadows[I2C_CLASS_MAX_SHADOWS];
+    uint8_t _shadowCount;
+    // Statistics have a lock of their own, so reading them neither waits
+    // for the bus nor shows up in its contention figures
+    std::mutex _statsMutex;
+    I2CDeviceStats _devices[I2C_CLASS_MAX_DEVICES];
+    uint8_t _deviceCount;
+    // Of the transaction in progress, guarded by _lock
+    uint8_t _error;  // Last I2C_BUS_* code, I2C_BUS_OK if none
+    uint32_t _written;
+    uint32_t _read;
+
+    // Holds the bus for one logical transaction and records its outcome
+    class Transaction {
+       public:
+        Transaction(I2C_Class* bus, uint8_t addr);
+        ~Transaction();
+        bool finish(bool ok) {
+            _ok = ok;
+            return ok;
+        }
+
+       private:
+        I2CBusGuard _guard;
+        I2C_Class* _bus;
+        uint8_t _addr;
+        uint32_t _startUs;
+        bool _ok;
+    };
+
+    void record(uint8_t addr, bool ok, uint32_t latencyUs);
+    I2CDeviceStats* statsOf(uint8_t addr);
+
+    bool writeRegister(uint8_t addr, uint16_t reg, uint8_t regBytes,
+                       const uint8_t* buffer, size_t length);
+    bool readRegister(uint8_t addr, uint16_t reg, uint8_t regBytes,
+                      uint8_t* buffer, size_t length);
+    bool receive(uint8_t addr, uint8_t* buffer, size_t length);
+    uint8_t priorityOf(uint8_t addr) const {
+        return _priority[addr & 0x7f];
+    }
+    I2CRegisterShadow* shadowOf(uint8_t addr) const;
+    // Current value of reg, from the shadow if possible
+    bool readForModify(uint8_t addr, uint8_t reg, uint8_t* value);
 
    public:
+    I2C_Class();
+
+    // The bus must outlive this object
+    void begin(I2CBus* bus, I2CClock clock = i2cClockUs);
+#ifdef ARDUINO
+    // Restarts wire on the given pins and uses it as the bus
     void begin(TwoWire* wire, uint8_t sda, uint8_t scl, long freq = 100000);
+#endif
     bool exist(uint8_t addr);
+    // The clock given to begin(), microseconds
+    uint64_t nowUs() const {
+        return _clock();
+    }
+
+    // Bus priority of the device at addr, I2C_PRIORITY_NORMAL by default
+    void setPriority(uint8_t addr, uint8_t priority);
+    // Contention at one priority level
+    I2CBusStats busStats(uint8_t priority) {
+        return _lock.stats(priority);
+    }
+    void resetBusStats() {
+        _lock.resetStats();
+    }
+
+    // Statistics of the index-th device seen on the bus; false past the
+    // last one
+    bool deviceStats(uint8_t index, I2CDeviceStats* stats);
+    void resetDeviceStats();
+    // For drivers that check a CRC on the data they read
+    void reportCrcError(uint8_t addr);
+
+    // Register shadows; false when all I2C_CLASS_MAX_SHADOWS are in use
+    bool attachShadow(I2CRegisterShadow* shadow);
+    void invalidateShadow(uint8_t addr);
+    // Reads every cached register of the device into its shadow
+    bool refreshShadow(uint8_t addr);
+    // Reads the known registers back and corrects the shadow; false if any
+    // differed (counted in mismatches) or a read failed
+    bool verifyShadow(uint8_t addr, uint16_t* mismatches = NULL);
+
+    bool writeBytes(uint8_t addr, uint8_t reg, const uint8_t* buffer,
+                    size_t length);
+    bool readBytes(uint8_t addr, uint8_t reg, uint8_t* buffer, size_t length);
+
+    // 16-bit register addresses or commands
+    bool writeBytes16(uint8_t addr, uint16_t reg, const uint8_t* buffer,
+                      size_t length);
+    bool readBytes16(uint8_t addr, uint16_t reg, uint8_t* buffer,
+                     size_t length);
 
-    bool writeBytes(uint8_t addr, uint8_t reg, uint8_t* buffer, uint8_t length);
-    bool readBytes(uint8_t addr, uint8_t reg, uint8_t* buffer, uint8_t length);
+    // Plain read without a register address, for devices that answer a
+    // command only after a delay
+    bool readBytes(uint8_t addr, uint8_t* buffer, size_t length);
 
     bool readU16(uint8_t addr, uint8_t reg_addr, uint16_t* value);
     bool writeU16(uint8_t addr, uint8_t reg_addr, uint16_t value);
 
     bool writeByte(uint8_t addr, uint8_t reg, uint8_t data);
+    // 0 on failure; the overload tells a failure from a zero register
     uint8_t readByte(uint8_t addr, uint8_t reg);
+    bool readByte(uint8_t addr, uint8_t reg, uint8_t* value);
     bool writeBitOn(uint8_t addr, uint8_t reg, uint8_t data);
     bool writeBitOff(uint8_t addr, uint8_t reg, uint8_t data);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,150 @@
+#include "SimulatedI2CBus.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#define SIMULATED_I2C_START_NS 2500  // At 400 kHz, scaled with the bit time
+#define SIMULATED_I2C_STOP_NS  1900
+
+std::atomic<uint64_t> SimulatedI2CBus::_clockNs(0);
+
+SimulatedI2CBus::SimulatedI2CBus(long freq)
+    : _bitNs((uint32_t)(1000000000L / freq)),
+      _realTime(false),
+      _devices(),
+      _deviceCount(0),
+      _failCount(0),
+      _failCode(I2C_BUS_OK),
+      _claimedBy(-1),
+      _busy(false),
+      _stats() {
+}
+
+bool SimulatedI2CBus::addDevice(uint8_t addr, uint8_t regBytes) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (_deviceCount >= SIMULATED_I2C_DEVICES) return false;
+    Device* device = &_devices[_deviceCount++];
+    memset(device, 0, sizeof(*device));
+    device->addr     = addr;
+    device->regBytes = regBytes;
+    return true;
+}
+
+uint8_t* SimulatedI2CBus::registers(uint8_t addr) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    Device* device = deviceOf(addr);
+    return device != NULL ? device->registers : NULL;
+}
+
+void SimulatedI2CBus::failNext(uint32_t count, uint8_t code) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _failCount = count;
+    _failCode  = code;
+}
+
+SimulatedI2CStats SimulatedI2CBus::stats() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _stats;
+}
+
+void SimulatedI2CBus::resetStats() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+uint64_t SimulatedI2CBus::clockUs(void) {
+    return _clockNs.load() / 1000;
+}
+
+void SimulatedI2CBus::advanceUs(uint64_t us) {
+    _clockNs += us * 1000;
+}
+
+void SimulatedI2CBus::resetClock() {
+    _clockNs = 0;
+}
+
+uint8_t SimulatedI2CBus::write(uint8_t addr, const uint8_t* data,
+                               size_t length, bool stop) {
+    bool overlapped = _busy.exchange(true);
+    uint8_t result  = I2C_BUS_OK;
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (overlapped) _stats.overlaps++;
+        Device* device = deviceOf(addr);
+        if (failing(&result) || device == NULL) {
+            // The master sends STOP after the failed byte
+            if (result == I2C_BUS_OK) result = I2C_BUS_ADDR_NACK;
+            length = 0;
+            stop   = true;
+        } else if (length >= device->regBytes) {
+            device->pointer = data[device->regBytes - 1];
+            for (size_t i = device->regBytes; i < length; i++) {
+                device->registers[device->pointer++] = data[i];
+            }
+        }
+        transfer(addr, 1 + length, stop);
+        _claimedBy = stop ? -1 : addr;
+    }
+    _busy = false;
+    return result;
+}
+
+size_t SimulatedI2CBus::read(uint8_t addr, uint8_t* data, size_t length) {
+    bool overlapped = _busy.exchange(true);
+    size_t received = 0;
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (overlapped) _stats.overlaps++;
+        Device* device = deviceOf(addr);
+        uint8_t code;
+        if (!failing(&code) && device != NULL) {
+            for (received = 0; received < length; received++) {
+                data[received] = device->registers[device->pointer++];
+            }
+        }
+        transfer(addr, 1 + received, true);
+        _claimedBy = -1;
+    }
+    _busy = false;
+    return received;
+}
+
+SimulatedI2CBus::Device* SimulatedI2CBus::deviceOf(uint8_t addr) {
+    for (uint8_t i = 0; i < _deviceCount; i++) {
+        if (_devices[i].addr == addr) return &_devices[i];
+    }
+    return NULL;
+}
+
+bool SimulatedI2CBus::failing(uint8_t* code) {
+    if (_failCount == 0) return false;
+    _failCount--;
+    *code = _failCode;
+    return true;
+}
+
+void SimulatedI2CBus::transfer(uint8_t addr, size_t bytes, bool stop) {
+    // Traffic to another device while one waits for its repeated START
+    if (_claimedBy >= 0 && _claimedBy != addr) _stats.interleaved++;
+    uint64_t ns = (uint64_t)bytes * 9 * _bitNs +
+                  (uint64_t)SIMULATED_I2C_START_NS * _bitNs / 2500;
+    _stats.starts++;
+    _stats.bytes += bytes;
+    if (stop) {
+        ns += (uint64_t)SIMULATED_I2C_STOP_NS * _bitNs / 2500;
+        _stats.transactions++;
+    }
+    _stats.busNs += ns;
+    pass(ns);
+}
+
+void SimulatedI2CBus::pass(uint64_t ns) {
+    if (_realTime) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+    } else {
+        _clockNs += ns;
+    }
+}
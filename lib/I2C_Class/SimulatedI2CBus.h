@@ -0,0 +1,90 @@
+#ifndef _SIMULATED_I2C_BUS_H_
+#define _SIMULATED_I2C_BUS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "I2CBus.h"
+
+#define SIMULATED_I2C_DEVICES 8
+
+typedef struct {
+    uint32_t transactions;  // Ended by a STOP
+    uint32_t starts;        // START and repeated START
+    uint32_t bytes;         // On the wire, address bytes included
+    uint32_t overlaps;      // Calls that started while another was running
+    uint32_t interleaved;   // Other traffic between a write without STOP
+                            // and its read
+    uint64_t busNs;         // Time the bus was busy
+} SimulatedI2CStats;
+
+// I2CBus stand-in with register-mapped devices and no hardware dependency.
+//
+// Each device has 256 registers. A write sets the register pointer with its
+// first byte (two for 16-bit devices, of which the low byte is used) and
+// stores the rest with auto-increment; a read returns registers from the
+// pointer on. Unknown addresses are not acknowledged.
+//
+// Every call takes the time it would take on the wire: 9 bit times per
+// byte, 2.5 us per START and 1.9 us per STOP at 400 kHz, scaled with the
+// bus frequency. By default that time is added to a shared virtual clock,
+// clockUs(), which can be handed to I2C_Class::begin(). With
+// setRealTime(true) the calling thread sleeps instead, for host
+// contention measurements against i2cClockUs().
+class SimulatedI2CBus : public I2CBus {
+   public:
+    explicit SimulatedI2CBus(long freq = 400000);
+
+    // False when all SIMULATED_I2C_DEVICES are in use
+    bool addDevice(uint8_t addr, uint8_t regBytes = 1);
+    // Register file of the device at addr, NULL if there is none
+    uint8_t* registers(uint8_t addr);
+    // The next count calls fail: writes return code, reads return no data
+    void failNext(uint32_t count, uint8_t code = I2C_BUS_ADDR_NACK);
+    void setRealTime(bool realTime) {
+        _realTime = realTime;
+    }
+
+    SimulatedI2CStats stats();
+    void resetStats();
+
+    // Virtual clock shared by all simulated buses
+    static uint64_t clockUs(void);
+    static void advanceUs(uint64_t us);
+    static void resetClock();
+
+    uint8_t write(uint8_t addr, const uint8_t* data, size_t length,
+                  bool stop) override;
+    size_t read(uint8_t addr, uint8_t* data, size_t length) override;
+
+   private:
+    typedef struct {
+        uint8_t addr;
+        uint8_t regBytes;
+        uint8_t pointer;
+        uint8_t registers[256];
+    } Device;
+
+    Device* deviceOf(uint8_t addr);
+    bool failing(uint8_t* code);
+    // Counts one call of bytes (address included) and passes its time
+    void transfer(uint8_t addr, size_t bytes, bool stop);
+    void pass(uint64_t ns);
+
+    std::mutex _mutex;
+    uint32_t _bitNs;
+    bool _realTime;
+    Device _devices[SIMULATED_I2C_DEVICES];
+    uint8_t _deviceCount;
+    uint32_t _failCount;
+    uint8_t _failCode;
+    int16_t _claimedBy;  // Address of a write without STOP, -1 if none
+    std::atomic<bool> _busy;
+    SimulatedI2CStats _stats;
+
+    static std::atomic<uint64_t> _clockNs;
+};
+
+#endif
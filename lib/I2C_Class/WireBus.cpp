@@ -0,0 +1,32 @@
+#include "WireBus.h"
+
+#ifdef ARDUINO
+
+WireBus::WireBus() : _wire(NULL) {
+}
+
+void WireBus::begin(TwoWire* wire, uint8_t sda, uint8_t scl, long freq) {
+    _wire = wire;
+    _wire->end();
+    _wire->begin(static_cast<int>(sda), scl, freq);
+}
+
+uint8_t WireBus::write(uint8_t addr, const uint8_t* data, size_t length,
+                       bool stop) {
+    _wire->beginTransmission(addr);
+    if (length > 0 && _wire->write(data, length) != length) {
+        _wire->endTransmission(true);
+        return I2C_BUS_OVERFLOW;
+    }
+    return _wire->endTransmission(stop);
+}
+
+size_t WireBus::read(uint8_t addr, uint8_t* data, size_t length) {
+    size_t received = _wire->requestFrom(addr, length, true);
+    for (size_t i = 0; i < received && i < length; i++) {
+        data[i] = _wire->read();
+    }
+    return received;
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _WIRE_BUS_H_
+#define _WIRE_BUS_H_
+
+#ifdef ARDUINO
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#include "I2CBus.h"
+
+// I2CBus on an Arduino TwoWire
+class WireBus : public I2CBus {
+   public:
+    WireBus();
+
+    // Restarts wire on the given pins
+    void begin(TwoWire* wire, uint8_t sda, uint8_t scl, long freq);
+
+    uint8_t write(uint8_t addr, const uint8_t* data, size_t length,
+                  bool stop) override;
+    size_t read(uint8_t addr, uint8_t* data, size_t length) override;
+
+   private:
+    TwoWire* _wire;
+};
+
+#endif
+
+#endif
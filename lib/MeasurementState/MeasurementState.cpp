@@ -0,0 +1,56 @@
+#include "MeasurementState.h"
+
+MeasurementState::MeasurementState() : _working() {
+    _working.brightness = BRIGHTNESS_DEFAULT;
+    _published.store(_working);
+}
+
+void MeasurementState::publishSample(const UVSample& sample,
+                                     const UVDoseTotals& dose) {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _working.current   = sample;
+    _working.hasSample = true;
+    _working.dose      = dose;
+    if (sample.uva > _working.maxUva) _working.maxUva = sample.uva;
+    if (sample.uvb > _working.maxUvb) _working.maxUvb = sample.uvb;
+    if (sample.uvc > _working.maxUvc) _working.maxUvc = sample.uvc;
+    _uvaStats.add(sample.uva);
+    _uvbStats.add(sample.uvb);
+    _uvcStats.add(sample.uvc);
+    _working.statsUva = _uvaStats.summary();
+    _working.statsUvb = _uvbStats.summary();
+    _working.statsUvc = _uvcStats.summary();
+    _published.store(_working);
+}
+
+void MeasurementState::resetMaxima() {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _working.maxUva = 0;
+    _working.maxUvb = 0;
+    _working.maxUvc = 0;
+    _uvaStats.reset();
+    _uvbStats.reset();
+    _uvcStats.reset();
+    _working.statsUva = _uvaStats.summary();
+    _working.statsUvb = _uvbStats.summary();
+    _working.statsUvc = _uvcStats.summary();
+    _working.resetCount++;
+    _published.store(_working);
+}
+
+// Steps BRIGHTNESS_STEP..100 and wraps, returns the new value
+uint8_t MeasurementState::cycleBrightness() {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    int brightness = _working.brightness + BRIGHTNESS_STEP;
+    if (brightness > 100) brightness = BRIGHTNESS_STEP;
+    _working.brightness = (uint8_t)brightness;
+    _published.store(_working);
+    return _working.brightness;
+}
+
+bool MeasurementState::togglePaused() {
+    std::lock_guard<std::mutex> lock(_writeLock);
+    _working.paused = !_working.paused;
+    _published.store(_working);
+    return _working.paused;
+}
@@ -0,0 +1,64 @@
+#ifndef _MEASUREMENT_STATE_H_
+#define _MEASUREMENT_STATE_H_
+
+#include <stdint.h>
+
+#include <mutex>
+
+#include "SeqLock.h"
+#include "StreamStats.h"
+#include "UVDose.h"
+#include "UVSample.h"
+
+#define BRIGHTNESS_STEP    25
+#define BRIGHTNESS_DEFAULT 100
+
+typedef struct {
+    UVSample current;     // Newest sample
+    bool hasSample;       // False until the first sample is published
+    UVDoseTotals dose;    // Accumulated dose up to the current sample
+    float maxUva;         // Running maxima since the last reset
+    float maxUvb;
+    float maxUvc;
+    ChannelStats statsUva;  // Mean, deviation and percentiles, reset
+    ChannelStats statsUvb;  // together with the maxima
+    ChannelStats statsUvc;
+    uint32_t resetCount;  // Number of resets applied so far
+    uint8_t brightness;   // Display settings
+    bool paused;
+} MeasurementSnapshot;
+
+// State shared between the sample consumer, the button handler and the UI.
+//
+// Writers (any task) are serialised by a mutex and republish the whole
+// state through a SeqLock on every change; readers call snapshot(), which
+// never blocks and always returns a consistent copy, so the max column can
+// not show a half-applied reset or a value torn by a concurrent update.
+class MeasurementState {
+   public:
+    MeasurementState();
+
+    void publishSample(const UVSample& sample, const UVDoseTotals& dose);
+    // Clears the maxima and the channel statistics in one update
+    void resetMaxima();
+
+    uint8_t cycleBrightness();
+    bool togglePaused();
+
+    MeasurementSnapshot snapshot() const {
+        return _published.load();
+    }
+    uint32_t version() const {
+        return _published.version();
+    }
+
+   private:
+    std::mutex _writeLock;
+    MeasurementSnapshot _working;  // Guarded by _writeLock
+    ChannelStatistics _uvaStats;   // Estimator state, also guarded
+    ChannelStatistics _uvbStats;
+    ChannelStatistics _uvcStats;
+    SeqLock<MeasurementSnapshot> _published;
+};
+
+#endif
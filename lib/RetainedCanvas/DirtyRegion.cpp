@@ -0,0 +1,67 @@
+#include "DirtyRegion.h"
+
+static uint32_t rectArea(const UiRect& r) {
+    return (uint32_t)r.w * (uint32_t)r.h;
+}
+
+static bool rectsTouch(const UiRect& a, const UiRect& b) {
+    return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h &&
+           b.y <= a.y + a.h;
+}
+
+static UiRect rectUnion(const UiRect& a, const UiRect& b) {
+    int16_t left   = a.x < b.x ? a.x : b.x;
+    int16_t top    = a.y < b.y ? a.y : b.y;
+    int16_t right  = (a.x + a.w) > (b.x + b.w) ? (a.x + a.w) : (b.x + b.w);
+    int16_t bottom = (a.y + a.h) > (b.y + b.h) ? (a.y + a.h) : (b.y + b.h);
+    UiRect u       = {left, top, (int16_t)(right - left),
+                      (int16_t)(bottom - top)};
+    return u;
+}
+
+void DirtyRegion::add(const UiRect& rect) {
+    if (rect.w <= 0 || rect.h <= 0) return;
+
+    UiRect merged = rect;
+    bool changed  = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < _count; i++) {
+            if (rectsTouch(merged, _rects[i])) {
+                merged = rectUnion(merged, _rects[i]);
+                remove(i);
+                changed = true;
+                break;
+            }
+        }
+        if (!changed && _count == DIRTY_MAX_RECTS) {
+            // Out of slots: fold into the rectangle that grows the least
+            size_t best         = 0;
+            uint32_t bestGrowth = UINT32_MAX;
+            for (size_t i = 0; i < _count; i++) {
+                uint32_t growth = rectArea(rectUnion(merged, _rects[i])) -
+                                  rectArea(_rects[i]);
+                if (growth < bestGrowth) {
+                    bestGrowth = growth;
+                    best       = i;
+                }
+            }
+            merged = rectUnion(merged, _rects[best]);
+            remove(best);
+            changed = true;
+        }
+    }
+    _rects[_count++] = merged;
+}
+
+uint32_t DirtyRegion::area() const {
+    uint32_t total = 0;
+    for (size_t i = 0; i < _count; i++) {
+        total += rectArea(_rects[i]);
+    }
+    return total;
+}
+
+void DirtyRegion::remove(size_t index) {
+    _rects[index] = _rects[--_count];
+}
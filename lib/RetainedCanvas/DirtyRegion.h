@@ -0,0 +1,48 @@
+#ifndef _DIRTY_REGION_H_
+#define _DIRTY_REGION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DIRTY_MAX_RECTS 8
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+} UiRect;
+
+// Set of screen areas that changed since the last push.
+//
+// Rectangles that overlap or touch are merged as they are added, so the
+// stored rectangles never overlap and area() is exactly the number of pixels
+// a push of all of them transfers. When more than DIRTY_MAX_RECTS disjoint
+// areas are dirty, the new one is merged into whichever stored rectangle
+// grows the least.
+class DirtyRegion {
+   public:
+    DirtyRegion() : _count(0) {
+    }
+
+    void add(const UiRect& rect);
+    void clear() {
+        _count = 0;
+    }
+
+    size_t count() const {
+        return _count;
+    }
+    const UiRect& rect(size_t index) const {
+        return _rects[index];
+    }
+    uint32_t area() const;
+
+   private:
+    void remove(size_t index);
+
+    UiRect _rects[DIRTY_MAX_RECTS];
+    size_t _count;
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "RetainedCanvas.h"
+
+#include <esp_timer.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+RetainedCanvas::RetainedCanvas(M5Canvas* canvas, uint32_t background)
+    : _canvas(canvas),
+      _second(NULL),
+      _dmaPending(false),
+      _writing(false),
+      _background(background),
+      _widgetCount(0),
+      _lastPixels(0),
+      _totalPixels(0),
+      _frames(0),
+      _frameStartUs(0),
+      _times() {
+}
+
+void RetainedCanvas::resetStats() {
+    _lastPixels  = 0;
+    _totalPixels = 0;
+    _frames      = 0;
+    _times       = FrameTimes();
+}
+
+void RetainedCanvas::setSecondBuffer(M5Canvas* second) {
+    _second = second;
+    invalidateAll();  // Both sprites start from the same full frame
+}
+
+int RetainedCanvas::addWidget(int16_t x, int16_t y, int16_t w, int16_t h) {
+    if (_widgetCount >= RETAINED_MAX_WIDGETS) return -1;
+    Widget& widget  = _widgets[_widgetCount];
+    UiRect rect     = {x, y, w, h};
+    widget.rect     = rect;
+    widget.textX    = x;
+    widget.textY    = y;
+    widget.textSize = 1;
+    widget.color    = 0;
+    widget.key      = 0;
+    widget.valid    = false;
+    return _widgetCount++;
+}
+
+int RetainedCanvas::addTextWidget(int16_t x, int16_t y, int16_t w, int16_t h,
+                                  float textSize, uint32_t color) {
+    int id = addWidget(x, (int16_t)(y - h / 2), w, h);
+    if (id < 0) return id;
+    _widgets[id].textY    = y;
+    _widgets[id].textSize = textSize;
+    _widgets[id].color    = color;
+    return id;
+}
+
+bool RetainedCanvas::beginWidget(int id, uint32_t key) {
+    Widget& widget = _widgets[id];
+    if (widget.valid && widget.key == key) return false;
+
+    widget.key   = key;
+    widget.valid = true;
+    _canvas->fillRect(widget.rect.x, widget.rect.y, widget.rect.w,
+                      widget.rect.h, _background);
+    _dirty.add(widget.rect);
+    return true;
+}
+
+void RetainedCanvas::markDirty(int id) {
+    _dirty.add(_widgets[id].rect);
+}
+
+bool RetainedCanvas::printf(int id, const char* format, ...) {
+    char text[RETAINED_TEXT_MAX];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (!beginWidget(id, hash(text))) return false;
+
+    const Widget& widget = _widgets[id];
+    _canvas->setTextSize(widget.textSize);
+    _canvas->setTextColor(widget.color, _background);
+    _canvas->setTextDatum(middle_left);
+    _canvas->drawString(text, widget.textX, widget.textY);
+    return true;
+}
+
+void RetainedCanvas::invalidateAll() {
+    for (int i = 0; i < _widgetCount; i++) {
+        _widgets[i].valid = false;
+    }
+    _canvas->fillScreen(_background);
+    UiRect all = {0, 0, (int16_t)_canvas->width(), (int16_t)_canvas->height()};
+    _dirty.add(all);
+}
+
+void RetainedCanvas::beginFrame() {
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    if (_frameStartUs != 0) _times.frameUs = now - _frameStartUs;
+    _frameStartUs = now;
+}
+
+uint32_t RetainedCanvas::flush(LovyanGFX* display) {
+    uint32_t start = (uint32_t)esp_timer_get_time();
+    if (_frameStartUs != 0) _times.renderUs = start - _frameStartUs;
+    _times.syncUs = 0;
+
+    uint32_t pixels = _second ? pushDma(display) : pushBlocking(display);
+    _dirty.clear();
+
+    _times.transferUs =
+        (uint32_t)esp_timer_get_time() - start - _times.syncUs;
+    _times.renderTotalUs += _times.renderUs;
+    _times.transferTotalUs += _times.transferUs;
+    _times.syncTotalUs += _times.syncUs;
+    _lastPixels = pixels;
+    _totalPixels += pixels;
+    _frames++;
+    return pixels;
+}
+
+uint32_t RetainedCanvas::pushBlocking(LovyanGFX* display) {
+    if (_dirty.count() == 0) return 0;
+
+    // The clip rectangle limits pushSprite to the dirty area, so only
+    // those pixels go over SPI
+    display->startWrite();
+    for (size_t i = 0; i < _dirty.count(); i++) {
+        const UiRect& r = _dirty.rect(i);
+        display->setClipRect(r.x, r.y, r.w, r.h);
+        _canvas->pushSprite(display, 0, 0);
+    }
+    display->clearClipRect();
+    display->endWrite();
+    return _dirty.area();
+}
+
+uint32_t RetainedCanvas::pushDma(LovyanGFX* display) {
+    // The other sprite may still be on its way out
+    if (_dmaPending) {
+        uint32_t waitStart = (uint32_t)esp_timer_get_time();
+        display->waitDMA();
+        _times.syncUs = (uint32_t)esp_timer_get_time() - waitStart;
+        _dmaPending   = false;
+    }
+    if (_dirty.count() == 0) return 0;
+
+    // Rows covered by dirty rectangles, merged into disjoint bands
+    int16_t bandTop[DIRTY_MAX_RECTS];
+    int16_t bandEnd[DIRTY_MAX_RECTS];
+    size_t bands = 0;
+    for (size_t i = 0; i < _dirty.count(); i++) {
+        const UiRect& r = _dirty.rect(i);
+        int16_t top     = r.y;
+        int16_t end     = (int16_t)(r.y + r.h);
+        size_t j        = 0;
+        while (j < bands) {
+            if (top <= bandEnd[j] && end >= bandTop[j]) {
+                if (bandTop[j] < top) top = bandTop[j];
+                if (bandEnd[j] > end) end = bandEnd[j];
+                bands--;  // Absorbed; fill its slot with the last band
+                bandTop[j] = bandTop[bands];
+                bandEnd[j] = bandEnd[bands];
+                j          = 0;
+            } else {
+                j++;
+            }
+        }
+        bandTop[bands] = top;
+        bandEnd[bands] = end;
+        bands++;
+    }
+
+    // The transaction stays open, as ending it would wait for the DMA
+    if (!_writing) {
+        display->startWrite();
+        _writing = true;
+    }
+    int32_t width      = _canvas->width();
+    size_t rowBytes    = _canvas->bufferLength() / _canvas->height();
+    const uint8_t* src = (const uint8_t*)_canvas->getBuffer();
+    uint8_t* dst       = (uint8_t*)_second->getBuffer();
+    uint32_t pixels    = 0;
+    for (size_t i = 0; i < bands; i++) {
+        int16_t rows      = (int16_t)(bandEnd[i] - bandTop[i]);
+        const uint8_t* at = src + bandTop[i] * rowBytes;
+        if (_canvas->getColorDepth() == lgfx::rgb565_2Byte) {
+            display->pushImageDMA(0, bandTop[i], width, rows,
+                                  (const lgfx::swap565_t*)at);
+        } else {
+            // Paletted rows are expanded to RGB565 by the CPU on the way
+            // out, before drawing can go on
+            display->pushImageDMA(0, bandTop[i], width, rows, at,
+                                  _canvas->getColorDepth(),
+                                  _canvas->getPalette());
+        }
+        pixels += (uint32_t)width * rows;
+    }
+    _dmaPending = true;
+
+    // The sprite just queued becomes the front; the DMA only reads it, so
+    // its new rows can be copied into the back sprite right away
+    for (size_t i = 0; i < bands; i++) {
+        memcpy(dst + bandTop[i] * rowBytes, src + bandTop[i] * rowBytes,
+               (bandEnd[i] - bandTop[i]) * rowBytes);
+    }
+    M5Canvas* drawn = _canvas;
+    _canvas         = _second;
+    _second         = drawn;
+    return pixels;
+}
+
+// FNV-1a, used as a content key for text widgets
+uint32_t RetainedCanvas::hash(const char* text) {
+    uint32_t h = 2166136261u;
+    while (*text) {
+        h ^= (uint8_t)*text++;
+        h *= 16777619u;
+    }
+    return h;
+}
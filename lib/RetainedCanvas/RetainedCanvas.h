@@ -0,0 +1,142 @@
+#ifndef _RETAINED_CANVAS_H_
+#define _RETAINED_CANVAS_H_
+
+#include <stdint.h>
+
+#include "DirtyRegion.h"
+#include "M5GFX.h"
+
+#define RETAINED_MAX_WIDGETS 24
+#define RETAINED_TEXT_MAX    32
+
+// Last frame's timing; totals give averages over framesFlushed()
+typedef struct {
+    uint32_t renderUs;    // beginFrame() to flush()
+    uint32_t transferUs;  // Spent in flush() pushing, or queueing the DMA
+    uint32_t syncUs;      // Spent in flush() waiting for the previous DMA
+    uint32_t frameUs;     // beginFrame() to beginFrame()
+    uint64_t renderTotalUs;
+    uint64_t transferTotalUs;
+    uint64_t syncTotalUs;
+} FrameTimes;
+
+// Retained-mode layer over an M5Canvas.
+//
+// The screen is split into widgets with fixed rectangles. Every frame the
+// caller hands each widget a key describing its content (for text widgets
+// the formatted string itself); only widgets whose key changed are cleared
+// and redrawn into the canvas, and flush() pushes only the union of their
+// rectangles to the display instead of the whole sprite.
+//
+// With a second sprite the canvas is double buffered: flush() queues the
+// dirty rows of the drawn sprite for DMA and returns, and the next frame
+// is drawn into the other sprite while the transfer runs. The next flush()
+// waits for it first. Whole rows are sent because they are contiguous in
+// the sprite, so each band is a single DMA transfer; after the swap the
+// same rows are copied into the new back sprite to keep both identical.
+// canvas() always returns the sprite to draw into.
+//
+// Paletted sprites (4 or 8 bit) work in both modes; colours passed to the
+// widgets are then palette indices, and the rows are expanded to RGB565
+// while they are pushed. That expansion runs on the CPU, so with paletted
+// sprites double buffering saves little besides the wait for the last
+// rows.
+class RetainedCanvas {
+   public:
+    RetainedCanvas(M5Canvas* canvas, uint32_t background = 0);
+
+    // Double buffers with second, which must match the first sprite in
+    // size and colour depth. Both need DMA-capable (internal) memory for
+    // the transfer to run without the CPU.
+    void setSecondBuffer(M5Canvas* second);
+    bool doubleBuffered() const {
+        return _second != NULL;
+    }
+
+    // Custom widget covering the given rectangle. Returns its id, or -1 if
+    // RETAINED_MAX_WIDGETS is exceeded.
+    int addWidget(int16_t x, int16_t y, int16_t w, int16_t h);
+
+    // Text widget drawn middle-left aligned at (x, y), h pixels tall.
+    int addTextWidget(int16_t x, int16_t y, int16_t w, int16_t h,
+                      float textSize, uint32_t color);
+
+    // For custom widgets: returns true if key differs from what is on the
+    // canvas. The widget area has then been cleared and marked dirty and the
+    // caller must draw the new content inside it.
+    bool beginWidget(int id, uint32_t key);
+
+    // For custom widgets that update part of their pixels in place (e.g.
+    // by scrolling): marks the widget area dirty without clearing it.
+    void markDirty(int id);
+
+    // For text widgets: formats, compares and redraws only on change.
+    bool printf(int id, const char* format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+    // Forget all widget content and repaint the whole canvas on next frame.
+    void invalidateAll();
+
+    // Marks the start of drawing, for the render time
+    void beginFrame();
+    // Pushes dirty areas to display. Returns the number of pixels sent.
+    uint32_t flush(LovyanGFX* display);
+
+    M5Canvas* canvas() {
+        return _canvas;
+    }
+    const UiRect& widgetRect(int id) const {
+        return _widgets[id].rect;
+    }
+    uint32_t background() const {
+        return _background;
+    }
+
+    uint32_t lastPixelsPushed() const {
+        return _lastPixels;
+    }
+    uint32_t totalPixelsPushed() const {
+        return _totalPixels;
+    }
+    uint32_t framesFlushed() const {
+        return _frames;
+    }
+    const FrameTimes& frameTimes() const {
+        return _times;
+    }
+    // Clears the pixel and frame counters and the frame times
+    void resetStats();
+
+    static uint32_t hash(const char* text);
+
+   private:
+    typedef struct {
+        UiRect rect;
+        int16_t textX;
+        int16_t textY;
+        float textSize;
+        uint32_t color;
+        uint32_t key;
+        bool valid;
+    } Widget;
+
+    uint32_t pushBlocking(LovyanGFX* display);
+    uint32_t pushDma(LovyanGFX* display);
+
+    M5Canvas* _canvas;  // Drawn into
+    M5Canvas* _second;  // Being transferred, when double buffered
+    bool _dmaPending;
+    bool _writing;      // Display transaction kept open for DMA
+    uint32_t _background;
+    Widget _widgets[RETAINED_MAX_WIDGETS];
+    int _widgetCount;
+    DirtyRegion _dirty;
+
+    uint32_t _lastPixels;
+    uint32_t _totalPixels;
+    uint32_t _frames;
+    uint32_t _frameStartUs;
+    FrameTimes _times;
+};
+
+#endif
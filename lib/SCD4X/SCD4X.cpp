@@ -23,20 +23,18 @@
 
 #include "SCD4X.h"
 
-SCD4X::SCD4X(scd4x_sensor_type_e sensorType) {
+SCD4X::SCD4X(scd4x_sensor_type_e sensorType) : _i2c(NULL), _addr(0) {
     // Constructor
     _sensorType = sensorType;
 }
 
-bool SCD4X::begin(TwoWire *wire, uint8_t addr, uint8_t sda, uint8_t scl,
-                  long freq, bool measBegin, bool autoCalibrate,
-                  bool skipStopPeriodicMeasurements,
+bool SCD4X::begin(I2C_Class *bus, uint8_t addr, bool measBegin,
+                  bool autoCalibrate, bool skipStopPeriodicMeasurements,
                   bool pollAndSetDeviceType) {
-    _i2c.begin(wire, sda, scl, freq);
+    _i2c  = bus;
     _addr = addr;
-    _wire = wire;
 
-    if (!_i2c.exist(_addr)) {
+    if (!_i2c->exist(_addr)) {
         return false;
     }
     bool success = true;
@@ -95,27 +93,11 @@ bool SCD4X::startPeriodicMeasurement(void) {
 // power. Note that the sensor will only respond to other commands after waiting
 // 500 ms after issuing the stop_periodic_measurement command.
 
-bool SCD4X::stopPeriodicMeasurement(uint16_t delayMillis, TwoWire &wirePort)
+bool SCD4X::stopPeriodicMeasurement(uint16_t delayMillis) {
+    // Before begin() there is no bus to send it on
+    if (_i2c == NULL) return (false);
 
-{
-    uint8_t i2cResult;
-    if (_wire != NULL)  // If the sensor has been begun (_wire is not
-                        // NULL) then _wire is used
-    {
-        _wire->beginTransmission(_addr);
-        _wire->write(SCD4x_COMMAND_STOP_PERIODIC_MEASUREMENT >> 8);    // MSB
-        _wire->write(SCD4x_COMMAND_STOP_PERIODIC_MEASUREMENT & 0xFF);  // LSB
-        i2cResult = _wire->endTransmission();
-    } else {
-        // If the sensor has not been begun (_wire is NULL) then wirePort
-        // is used (which will default to Wire)
-        wirePort.beginTransmission(_addr);
-        wirePort.write(SCD4x_COMMAND_STOP_PERIODIC_MEASUREMENT >> 8);    // MSB
-        wirePort.write(SCD4x_COMMAND_STOP_PERIODIC_MEASUREMENT & 0xFF);  // LSB
-        i2cResult = wirePort.endTransmission();
-    }
-
-    if (i2cResult == 0) {
+    if (sendCommand(SCD4x_COMMAND_STOP_PERIODIC_MEASUREMENT)) {
         periodicMeasurementsAreRunning = false;
         if (delayMillis > 0) delay(delayMillis);
         return (true);
@@ -142,19 +124,17 @@ bool SCD4X::readMeasurement(void) {
     scd4x_unsigned16Bytes_t tempTemperature;
     tempTemperature.unsigned16 = 0;
 
-    _wire->beginTransmission(_addr);
-    _wire->write(SCD4x_COMMAND_READ_MEASUREMENT >> 8);    // MSB
-    _wire->write(SCD4x_COMMAND_READ_MEASUREMENT & 0xFF);  // LSB
-    if (_wire->endTransmission() != 0) return (false);    // Sensor did not ACK
+    if (!sendCommand(SCD4x_COMMAND_READ_MEASUREMENT))
+        return (false);  // Sensor did not ACK
 
     delay(1);  // Datasheet specifies this
 
-    _wire->requestFrom((uint8_t)_addr, (uint8_t)9);
+    uint8_t response[9];
     bool error = false;
-    if (_wire->available()) {
+    if (_i2c->readBytes(_addr, response, sizeof(response))) {
         byte bytesToCrc[2];
         for (byte x = 0; x < 9; x++) {
-            byte incoming = _wire->read();
+            byte incoming = response[x];
 
             switch (x) {
                 case 0:
@@ -202,6 +182,7 @@ bool SCD4X::readMeasurement(void) {
     }
 
     if (error) {
+        _i2c->reportCrcError(_addr);
         return (false);
     }
     // Now copy the int16s into their associated floats
@@ -407,15 +388,15 @@ bool SCD4X::performForcedRecalibration(uint16_t concentration,
 
     delay(400);  // Datasheet specifies this
 
-    _wire->requestFrom((uint8_t)_addr, (uint8_t)3);
+    uint8_t response[3];
     bool error = false;
-    if (_wire->available()) {
+    if (_i2c->readBytes(_addr, response, sizeof(response))) {
         byte bytesToCrc[2];
-        bytesToCrc[0]  = _wire->read();
+        bytesToCrc[0]  = response[0];
         correctionWord = ((uint16_t)bytesToCrc[0]) << 8;
-        bytesToCrc[1]  = _wire->read();
+        bytesToCrc[1]  = response[1];
         correctionWord |= (uint16_t)bytesToCrc[1];
-        byte incomingCrc = _wire->read();
+        byte incomingCrc = response[2];
         uint8_t foundCrc = computeCRC8(bytesToCrc, 2);
         if (foundCrc != incomingCrc) {
             error = true;
@@ -425,6 +406,7 @@ bool SCD4X::performForcedRecalibration(uint16_t concentration,
     }
 
     if (error) {
+        _i2c->reportCrcError(_addr);
         return (false);
     }
 
@@ -535,20 +517,18 @@ bool SCD4X::getSerialNumber(char *serialNumber) {
         return (false);
     }
 
-    _wire->beginTransmission(_addr);
-    _wire->write(SCD4x_COMMAND_GET_SERIAL_NUMBER >> 8);    // MSB
-    _wire->write(SCD4x_COMMAND_GET_SERIAL_NUMBER & 0xFF);  // LSB
-    if (_wire->endTransmission() != 0) return (false);     // Sensor did not ACK
+    if (!sendCommand(SCD4x_COMMAND_GET_SERIAL_NUMBER))
+        return (false);  // Sensor did not ACK
 
     delay(1);  // Datasheet specifies this
 
-    _wire->requestFrom((uint8_t)_addr, (uint8_t)9);
+    uint8_t response[9];
     bool error = false;
-    if (_wire->available()) {
+    if (_i2c->readBytes(_addr, response, sizeof(response))) {
         byte bytesToCrc[2];
         int digit = 0;
         for (byte x = 0; x < 9; x++) {
-            byte incoming = _wire->read();
+            byte incoming = response[x];
 
             switch (x) {
                 case 0:  // The serial number arrives as: two bytes, CRC,
@@ -582,6 +562,7 @@ bool SCD4X::getSerialNumber(char *serialNumber) {
     }
 
     if (error) {
+        _i2c->reportCrcError(_addr);
         return (false);
     }
 
@@ -716,55 +697,41 @@ bool SCD4X::getFeatureSetVersion(scd4x_sensor_type_e *sensorType) {
 
 // Sends a command along with arguments and CRC
 bool SCD4X::sendCommand(uint16_t command, uint16_t arguments) {
-    uint8_t data[2];
-    data[0]     = arguments >> 8;
-    data[1]     = arguments & 0xFF;
-    uint8_t crc = computeCRC8(
+    uint8_t data[3];
+    data[0] = arguments >> 8;    // MSB
+    data[1] = arguments & 0xFF;  // LSB
+    data[2] = computeCRC8(
         data, 2);  // Calc CRC on the arguments only, not the command
 
-    _wire->beginTransmission(_addr);
-    _wire->write(command >> 8);      // MSB
-    _wire->write(command & 0xFF);    // LSB
-    _wire->write(arguments >> 8);    // MSB
-    _wire->write(arguments & 0xFF);  // LSB
-    _wire->write(crc);
-    if (_wire->endTransmission() != 0) return (false);  // Sensor did not ACK
-
-    return (true);
+    // One transaction: command, arguments, CRC
+    return _i2c->writeBytes16(_addr, command, data, sizeof(data));
 }
 
 // Sends just a command, no arguments, no CRC
 bool SCD4X::sendCommand(uint16_t command) {
-    _wire->beginTransmission(_addr);
-    _wire->write(command >> 8);                         // MSB
-    _wire->write(command & 0xFF);                       // LSB
-    if (_wire->endTransmission() != 0) return (false);  // Sensor did not ACK
-
-    return (true);
+    return _i2c->writeBytes16(_addr, command, NULL, 0);
 }
 
 // Gets two bytes from SCD4X plus CRC.
-// Returns true if endTransmission returns zero _and_ the CRC check is valid
+// Returns true if the sensor ACKs _and_ the CRC check is valid
 bool SCD4X::readRegister(uint16_t registerAddress, uint16_t *response,
                          uint16_t delayMillis) {
-    _wire->beginTransmission(_addr);
-    _wire->write(registerAddress >> 8);                 // MSB
-    _wire->write(registerAddress & 0xFF);               // LSB
-    if (_wire->endTransmission() != 0) return (false);  // Sensor did not ACK
+    if (!sendCommand(registerAddress)) return (false);  // Sensor did not ACK
 
+    // The bus is free for other devices while the sensor works
     delay(delayMillis);
 
-    _wire->requestFrom((uint8_t)_addr,
-                       (uint8_t)3);  // Request data and CRC
-    if (_wire->available()) {
+    uint8_t received[3];  // Data and CRC
+    if (_i2c->readBytes(_addr, received, sizeof(received))) {
         uint8_t data[2];
-        data[0]             = _wire->read();
-        data[1]             = _wire->read();
-        uint8_t crc         = _wire->read();
+        data[0]             = received[0];
+        data[1]             = received[1];
+        uint8_t crc         = received[2];
         *response           = (uint16_t)data[0] << 8 | data[1];
         uint8_t expectedCRC = computeCRC8(data, 2);
         if (crc == expectedCRC)  // Return true if CRC check is OK
             return (true);
+        _i2c->reportCrcError(_addr);
     }
     return (false);
 }
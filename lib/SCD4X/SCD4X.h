@@ -100,34 +100,27 @@ typedef enum {
 
 class SCD4X {
    private:
-    TwoWire *_wire;
+    I2C_Class *_i2c;  // Shared bus, begun by its owner
     uint8_t _addr;
-    I2C_Class _i2c;
 
    public:
     SCD4X(scd4x_sensor_type_e sensorType = SCD4x_SENSOR_SCD40);
 
-    bool begin(TwoWire *wire = &Wire, uint8_t addr = SCD4X_I2C_ADDR,
-               uint8_t sda = 21, uint8_t scl = 22, long freq = 400000U,
+    // Every command is one transaction on bus; the bus is released while
+    // the sensor executes it
+    bool begin(I2C_Class *bus, uint8_t addr = SCD4X_I2C_ADDR,
                bool measBegin = true, bool autoCalibrate = true,
                bool skipStopPeriodicMeasurements = false,
-               bool pollAndSetDeviceType         = true
-
-    );
+               bool pollAndSetDeviceType         = true);
 
     bool update(void);
 
     bool startPeriodicMeasurement(void);  // Signal update interval is 5 seconds
 
-    // stopPeriodicMeasurement can be called before .begin if required
-    // If the sensor has been begun (_i2cPort is not NULL) then _i2cPort is used
-    // If the sensor has not been begun (_i2cPort is NULL) then wirePort and
-    // address are used (which will default to Wire) Note that the sensor will
-    // only respond to other commands after waiting 500 ms after issuing the
+    // Returns false before begin(). Note that the sensor will only respond
+    // to other commands after waiting 500 ms after issuing the
     // stop_periodic_measurement command.
-
-    bool stopPeriodicMeasurement(uint16_t delayMillis = 500,
-                                 TwoWire &wirePort    = Wire);
+    bool stopPeriodicMeasurement(uint16_t delayMillis = 500);
 
     bool readMeasurement(void);  // Check for fresh data; store it. Returns true
                                  // if fresh data is available
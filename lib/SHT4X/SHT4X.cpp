@@ -1,11 +1,9 @@
 #include "SHT4X.h"
 
-bool SHT4X::begin(TwoWire* wire, uint8_t addr, uint8_t sda, uint8_t scl,
-                  long freq) {
-    _i2c.begin(wire, sda, scl, freq);
+bool SHT4X::begin(I2C_Class* bus, uint8_t addr) {
+    _i2c  = bus;
     _addr = addr;
-    _wire = wire;
-    return _i2c.exist(_addr);
+    return _i2c->exist(_addr);
 }
 
 bool SHT4X::update() {
@@ -55,19 +53,16 @@ bool SHT4X::update() {
         duration = 110;
     }
 
-    _i2c.writeByte(_addr, cmd, 1);
+    // The command alone, then the bus is free until the result is ready
+    if (!_i2c->writeBytes(_addr, cmd, NULL, 0)) return false;
 
     delay(duration);
 
-    _wire->requestFrom(_addr, (uint8_t)6);
-
-    Serial.println();
-    for (uint16_t i = 0; i < 6; i++) {
-        readbuffer[i] = _wire->read();
-    }
+    if (!_i2c->readBytes(_addr, readbuffer, sizeof(readbuffer))) return false;
 
     if (readbuffer[2] != crc8(readbuffer, 2) ||
         readbuffer[5] != crc8(readbuffer + 3, 2)) {
+        _i2c->reportCrcError(_addr);
         return false;
     }
 
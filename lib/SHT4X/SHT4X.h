@@ -56,8 +56,8 @@ typedef enum {
 
 class SHT4X {
    public:
-    bool begin(TwoWire* wire = &Wire, uint8_t addr = SHT40_I2C_ADDR_44,
-               uint8_t sda = 21, uint8_t scl = 22, long freq = 400000U);
+    // bus is shared and begun by its owner
+    bool begin(I2C_Class* bus, uint8_t addr = SHT40_I2C_ADDR_44);
     bool update(void);
 
     float cTemp    = 0;
@@ -69,9 +69,8 @@ class SHT4X {
     sht4x_heater_t getHeater(void);
 
    private:
-    TwoWire* _wire;
+    I2C_Class* _i2c;
     uint8_t _addr;
-    I2C_Class _i2c;
 
     sht4x_precision_t _precision = SHT4X_HIGH_PRECISION;
     sht4x_heater_t _heater       = SHT4X_NO_HEATER;
@@ -0,0 +1,104 @@
+#include "SampleCodec.h"
+
+static inline uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static inline size_t putVarint(uint64_t value, uint8_t* out) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+// Returns the bytes consumed, 0 if the varint runs past the end
+static inline size_t getVarint(const uint8_t* in, size_t length,
+                               uint64_t* value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < length && i < 10; i++) {
+        result |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+SampleEncoder::SampleEncoder() {
+    reset();
+}
+
+void SampleEncoder::reset() {
+    _last      = LogSample();
+    _lastDelta = 0;
+    _first     = true;
+}
+
+size_t SampleEncoder::encode(const LogSample& sample, uint8_t* out) {
+    size_t length = 0;
+
+    if (_first) {
+        length += putVarint(sample.timestampUs, out);
+        _lastDelta = 0;
+        _first     = false;
+    } else {
+        int64_t delta = (int64_t)(sample.timestampUs - _last.timestampUs);
+        length += putVarint(zigzag(delta - _lastDelta), out);
+        _lastDelta = delta;
+    }
+    length += putVarint(zigzag((int64_t)sample.uva - _last.uva), out + length);
+    length += putVarint(zigzag((int64_t)sample.uvb - _last.uvb), out + length);
+    length += putVarint(zigzag((int64_t)sample.uvc - _last.uvc), out + length);
+    length += putVarint(zigzag((int64_t)sample.tempCenti - _last.tempCenti),
+                        out + length);
+
+    _last = sample;
+    return length;
+}
+
+SampleDecoder::SampleDecoder() {
+    reset();
+}
+
+void SampleDecoder::reset() {
+    _last      = LogSample();
+    _lastDelta = 0;
+    _first     = true;
+}
+
+size_t SampleDecoder::decode(const uint8_t* in, size_t length,
+                             LogSample* sample) {
+    uint64_t fields[5];
+    size_t used = 0;
+    for (int i = 0; i < 5; i++) {
+        size_t n = getVarint(in + used, length - used, &fields[i]);
+        if (n == 0) return 0;
+        used += n;
+    }
+
+    LogSample next;
+    if (_first) {
+        next.timestampUs = fields[0];
+        _lastDelta       = 0;
+        _first           = false;
+    } else {
+        _lastDelta += unzigzag(fields[0]);
+        next.timestampUs = _last.timestampUs + (uint64_t)_lastDelta;
+    }
+    next.uva       = (uint32_t)(_last.uva + unzigzag(fields[1]));
+    next.uvb       = (uint32_t)(_last.uvb + unzigzag(fields[2]));
+    next.uvc       = (uint32_t)(_last.uvc + unzigzag(fields[3]));
+    next.tempCenti = (int16_t)(_last.tempCenti + unzigzag(fields[4]));
+
+    _last   = next;
+    *sample = next;
+    return used;
+}
@@ -0,0 +1,60 @@
+#ifndef _SAMPLE_CODEC_H_
+#define _SAMPLE_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact sample record shared by the flash log and the telemetry stream;
+// irradiance in the fixed-point units of uvToFixed()
+typedef struct {
+    uint64_t timestampUs;  // Since 1970 when the RTC was set, else boot
+    uint32_t uva;          // uW/m^2
+    uint32_t uvb;
+    uint32_t uvc;
+    int16_t tempCenti;     // Degrees C * 100
+} LogSample;
+
+// Worst case encoded size of one sample: 10 byte timestamp, 5 bytes per
+// channel and 3 for the temperature
+#define SAMPLECODEC_MAX_SAMPLE 28
+
+// Streaming delta encoder for LogSample sequences.
+//
+// Timestamps are stored as delta-of-delta and the channels and temperature
+// as deltas to the previous sample, all as zigzag varints. A steady sample
+// rate makes the timestamp a single zero byte, and slowly changing light
+// keeps the channels at one or two bytes each. The channels are already
+// integers, so a float XOR scheme would gain nothing here.
+//
+// Every block (flash batch, telemetry frame) starts with reset(), so each
+// can be decoded on its own.
+class SampleEncoder {
+   public:
+    SampleEncoder();
+
+    void reset();
+    // Appends sample to out; returns the bytes written
+    size_t encode(const LogSample& sample, uint8_t* out);
+
+   private:
+    LogSample _last;
+    int64_t _lastDelta;
+    bool _first;
+};
+
+class SampleDecoder {
+   public:
+    SampleDecoder();
+
+    void reset();
+    // Decodes one sample; returns the bytes consumed, 0 when in is
+    // truncated or malformed
+    size_t decode(const uint8_t* in, size_t length, LogSample* sample);
+
+   private:
+    LogSample _last;
+    int64_t _lastDelta;
+    bool _first;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "EspPartitionFlash.h"
+
+#ifdef ESP_PLATFORM
+
+EspPartitionFlash::EspPartitionFlash() : _partition(NULL) {
+}
+
+bool EspPartitionFlash::begin(const char* label) {
+    _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                          ESP_PARTITION_SUBTYPE_ANY, label);
+    return _partition != NULL;
+}
+
+uint32_t EspPartitionFlash::sectorCount() const {
+    return _partition ? _partition->size / SPI_FLASH_SEC_SIZE : 0;
+}
+
+bool EspPartitionFlash::read(uint32_t offset, void* data, size_t length) {
+    return esp_partition_read(_partition, offset, data, length) == ESP_OK;
+}
+
+bool EspPartitionFlash::write(uint32_t offset, const void* data,
+                              size_t length) {
+    return esp_partition_write(_partition, offset, data, length) == ESP_OK;
+}
+
+bool EspPartitionFlash::eraseSector(uint32_t sector) {
+    return esp_partition_erase_range(_partition, sector * SPI_FLASH_SEC_SIZE,
+                                     SPI_FLASH_SEC_SIZE) == ESP_OK;
+}
+
+#endif
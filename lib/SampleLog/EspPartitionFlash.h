@@ -0,0 +1,33 @@
+#ifndef _ESP_PARTITION_FLASH_H_
+#define _ESP_PARTITION_FLASH_H_
+
+#ifdef ESP_PLATFORM
+
+#include <esp_partition.h>
+
+#include "FlashPort.h"
+
+// FlashPort on a data partition of the internal flash (see partitions.csv)
+class EspPartitionFlash : public FlashPort {
+   public:
+    EspPartitionFlash();
+
+    // Finds the partition by label; false if the table has none
+    bool begin(const char* label);
+
+    uint32_t sectorSize() const override {
+        return SPI_FLASH_SEC_SIZE;
+    }
+    uint32_t sectorCount() const override;
+
+    bool read(uint32_t offset, void* data, size_t length) override;
+    bool write(uint32_t offset, const void* data, size_t length) override;
+    bool eraseSector(uint32_t sector) override;
+
+   private:
+    const esp_partition_t* _partition;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,121 @@
+#include "FileFlash.h"
+
+FileFlash::FileFlash()
+    : _file(NULL),
+      _sectorSize(0),
+      _sectorCount(0),
+      _powerLost(false),
+      _lossAfterBytes(0),
+      _lossAtErase(0),
+      _bytesWritten(0),
+      _erases(0) {
+}
+
+FileFlash::~FileFlash() {
+    close();
+}
+
+bool FileFlash::open(const char* path, uint32_t sectorSize,
+                     uint32_t sectorCount) {
+    close();
+    _file = fopen(path, "r+b");
+    if (!_file) _file = fopen(path, "w+b");
+    if (!_file) return false;
+
+    _sectorSize   = sectorSize;
+    _sectorCount  = sectorCount;
+    _bytesWritten = 0;
+    _erases       = 0;
+
+    // Extend a new or short image with erased sectors
+    fseek(_file, 0, SEEK_END);
+    long size = ftell(_file);
+    long full = (long)sectorSize * sectorCount;
+    return size >= full || fill((uint32_t)size, 0xFF, (size_t)(full - size));
+}
+
+void FileFlash::close() {
+    if (_file) fclose(_file);
+    _file = NULL;
+}
+
+void FileFlash::powerLossAfterBytes(uint64_t bytes) {
+    _lossAfterBytes = bytes ? _bytesWritten + bytes : 0;
+}
+
+void FileFlash::powerLossAtErase(uint32_t erases) {
+    _lossAtErase = erases ? _erases + erases : 0;
+}
+
+void FileFlash::powerCycle() {
+    _powerLost      = false;
+    _lossAfterBytes = 0;
+    _lossAtErase    = 0;
+}
+
+bool FileFlash::read(uint32_t offset, void* data, size_t length) {
+    if (_powerLost || !_file) return false;
+    if ((uint64_t)offset + length > (uint64_t)_sectorSize * _sectorCount) {
+        return false;
+    }
+    fseek(_file, offset, SEEK_SET);
+    return fread(data, 1, length, _file) == length;
+}
+
+bool FileFlash::write(uint32_t offset, const void* data, size_t length) {
+    if (_powerLost || !_file) return false;
+    if ((uint64_t)offset + length > (uint64_t)_sectorSize * _sectorCount) {
+        return false;
+    }
+
+    // Bytes programmed before the injected power loss
+    size_t programmed = length;
+    if (_lossAfterBytes && _bytesWritten + length >= _lossAfterBytes) {
+        programmed = (size_t)(_lossAfterBytes - _bytesWritten);
+        _powerLost = true;
+    }
+
+    const uint8_t* in = (const uint8_t*)data;
+    uint8_t buffer[256];
+    for (size_t done = 0; done < programmed;) {
+        size_t chunk = programmed - done;
+        if (chunk > sizeof(buffer)) chunk = sizeof(buffer);
+        fseek(_file, offset + done, SEEK_SET);
+        if (fread(buffer, 1, chunk, _file) != chunk) return false;
+        for (size_t i = 0; i < chunk; i++) buffer[i] &= in[done + i];
+        fseek(_file, offset + done, SEEK_SET);
+        if (fwrite(buffer, 1, chunk, _file) != chunk) return false;
+        done += chunk;
+    }
+    fflush(_file);
+    _bytesWritten += programmed;
+    return !_powerLost;
+}
+
+bool FileFlash::eraseSector(uint32_t sector) {
+    if (_powerLost || !_file || sector >= _sectorCount) return false;
+
+    _erases++;
+    uint32_t offset = sector * _sectorSize;
+    if (_lossAtErase && _erases >= _lossAtErase) {
+        // Interrupted: only the first half made it
+        fill(offset, 0xFF, _sectorSize / 2);
+        _powerLost = true;
+        return false;
+    }
+    return fill(offset, 0xFF, _sectorSize);
+}
+
+bool FileFlash::fill(uint32_t offset, uint8_t value, size_t length) {
+    uint8_t buffer[256];
+    for (size_t i = 0; i < sizeof(buffer); i++) buffer[i] = value;
+    fseek(_file, offset, SEEK_SET);
+    for (size_t done = 0; done < length;) {
+        size_t chunk = length - done;
+        if (chunk > sizeof(buffer)) chunk = sizeof(buffer);
+        if (fwrite(buffer, 1, chunk, _file) != chunk) return false;
+        done += chunk;
+    }
+    fflush(_file);
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef _FILE_FLASH_H_
+#define _FILE_FLASH_H_
+
+#include <stdio.h>
+
+#include "FlashPort.h"
+
+// NOR flash stand-in backed by a file, for running SampleLog on a host.
+//
+// Writes AND into the existing contents like real flash. Power loss can be
+// injected after a number of programmed bytes (the write in progress stops
+// half way) or during the n-th erase (half of the sector is left with its
+// old contents); every operation after that fails until powerCycle().
+class FileFlash : public FlashPort {
+   public:
+    FileFlash();
+    ~FileFlash();
+
+    // Opens path, creating an erased image when it is missing or too small
+    bool open(const char* path, uint32_t sectorSize, uint32_t sectorCount);
+    void close();
+
+    void powerLossAfterBytes(uint64_t bytes);
+    void powerLossAtErase(uint32_t erases);
+    void powerCycle();
+    bool powerLost() const {
+        return _powerLost;
+    }
+
+    // Totals since open(), for write amplification
+    uint64_t bytesWritten() const {
+        return _bytesWritten;
+    }
+    uint32_t erases() const {
+        return _erases;
+    }
+
+    uint32_t sectorSize() const override {
+        return _sectorSize;
+    }
+    uint32_t sectorCount() const override {
+        return _sectorCount;
+    }
+
+    bool read(uint32_t offset, void* data, size_t length) override;
+    bool write(uint32_t offset, const void* data, size_t length) override;
+    bool eraseSector(uint32_t sector) override;
+
+   private:
+    bool fill(uint32_t offset, uint8_t value, size_t length);
+
+    FILE* _file;
+    uint32_t _sectorSize;
+    uint32_t _sectorCount;
+
+    bool _powerLost;
+    uint64_t _lossAfterBytes;  // 0 = disarmed
+    uint32_t _lossAtErase;     // 0 = disarmed
+    uint64_t _bytesWritten;
+    uint32_t _erases;
+};
+
+#endif
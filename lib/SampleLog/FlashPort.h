@@ -0,0 +1,25 @@
+#ifndef _FLASH_PORT_H_
+#define _FLASH_PORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw NOR flash region as seen by SampleLog.
+//
+// Erased bytes read 0xFF and programming can only clear bits, so a byte
+// can be written once per erase. Implemented by EspPartitionFlash on the
+// device and by FileFlash on a Linux host.
+class FlashPort {
+   public:
+    virtual ~FlashPort() {
+    }
+
+    virtual uint32_t sectorSize() const = 0;
+    virtual uint32_t sectorCount() const = 0;
+
+    virtual bool read(uint32_t offset, void* data, size_t length) = 0;
+    virtual bool write(uint32_t offset, const void* data, size_t length) = 0;
+    virtual bool eraseSector(uint32_t sector) = 0;
+};
+
+#endif
@@ -0,0 +1,488 @@
+#include "SampleLog.h"
+
+#include <stdlib.h>
+
+#include "Crc16.h"
+
+#if defined(ARDUINO) && defined(BOARD_HAS_PSRAM)
+#include <esp32-hal-psram.h>
+#define SAMPLELOG_ALLOC(size) ps_malloc(size)
+#else
+#define SAMPLELOG_ALLOC(size) malloc(size)
+#endif
+
+static inline void put16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static inline void put32(uint8_t* out, uint32_t value) {
+    put16(out, (uint16_t)value);
+    put16(out + 2, (uint16_t)(value >> 16));
+}
+
+static inline uint16_t get16(const uint8_t* in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static inline uint32_t get32(const uint8_t* in) {
+    return get16(in) | ((uint32_t)get16(in + 2) << 16);
+}
+
+static_assert(SAMPLELOG_BATCH_BYTES >= SAMPLECODEC_MAX_SAMPLE,
+              "SampleLog batch must hold at least one sample");
+
+// Decodes the samples of one batch that lie in [fromUs, toUs) into out,
+// which has room for SAMPLELOG_BATCH_SAMPLES
+static size_t decodeRange(const uint8_t* payload, size_t length,
+                          uint64_t fromUs, uint64_t toUs, LogSample* out) {
+    SampleDecoder decoder;
+    LogSample sample;
+    size_t found = 0;
+    size_t used;
+    for (size_t pos = 0; pos < length && found < SAMPLELOG_BATCH_SAMPLES;
+         pos += used) {
+        used = decoder.decode(payload + pos, length - pos, &sample);
+        if (used == 0) break;
+        if (sample.timestampUs >= fromUs && sample.timestampUs < toUs) {
+            out[found++] = sample;
+        }
+    }
+    return found;
+}
+
+SampleLog::SampleLog(FlashPort* flash)
+    : _flash(flash),
+      _sectorSize(0),
+      _sectorCount(0),
+      _headOpen(false),
+      _head(0),
+      _headOffset(0),
+      _nextSeq(0),
+      _usedSectors(0),
+      _batchCount(0),
+      _batchBytes(0),
+      _batchSummary(),
+      _index(NULL),
+      _stats() {
+}
+
+SampleLog::~SampleLog() {
+    free(_index);
+}
+
+bool SampleLog::begin() {
+    std::lock_guard<std::mutex> lock(_lock);
+    _sectorSize  = _flash->sectorSize();
+    _sectorCount = _flash->sectorCount();
+    _headOpen    = false;
+    _usedSectors = 0;
+    _batchCount  = 0;
+    _batchBytes  = 0;
+    _encoder.reset();
+    summaryClear(&_batchSummary);
+    if (_sectorCount < 2) return false;
+
+    free(_index);
+    _index = (SectorIndex*)SAMPLELOG_ALLOC(_sectorCount * sizeof(SectorIndex));
+    if (_index == NULL) return false;
+
+    // The newest valid header is where writing continues
+    bool found = false;
+    SectorHeader header;
+    for (uint32_t sector = 0; sector < _sectorCount; sector++) {
+        _index[sector] = SectorIndex();
+        if (!readHeader(sector, &header)) continue;
+        _usedSectors++;
+        _index[sector].seq = header.seq;
+        if (!found || (int32_t)(header.seq - (_nextSeq - 1)) > 0) {
+            _head    = sector;
+            _nextSeq = header.seq + 1;
+            found    = true;
+        }
+    }
+    if (!found) {
+        _head    = _sectorCount - 1;  // First sector opened is 0
+        _nextSeq = 0;
+        return true;
+    }
+
+    // Reading every sector once rebuilds the index
+    bool torn;
+    for (uint32_t sector = 0; sector < _sectorCount; sector++) {
+        if (!readHeader(sector, &header)) continue;
+        uint32_t end = scanSector(sector, &torn, &_index[sector].summary);
+        if (sector == _head) {
+            _headOffset = end;
+            if (torn) _stats.tornBatches++;
+            _headOpen = !torn;
+        }
+    }
+    return true;
+}
+
+bool SampleLog::format() {
+    std::lock_guard<std::mutex> lock(_lock);
+    bool success = true;
+    for (uint32_t sector = 0; sector < _sectorCount; sector++) {
+        success &= _flash->eraseSector(sector);
+        _stats.erases++;
+    }
+    _headOpen    = false;
+    _head        = _sectorCount - 1;
+    _nextSeq     = 0;
+    _usedSectors = 0;
+    _batchCount  = 0;
+    _batchBytes  = 0;
+    _encoder.reset();
+    summaryClear(&_batchSummary);
+    if (_index != NULL) {
+        for (uint32_t sector = 0; sector < _sectorCount; sector++) {
+            _index[sector] = SectorIndex();
+        }
+    }
+    return success;
+}
+
+bool SampleLog::append(const LogSample& sample) {
+    std::lock_guard<std::mutex> lock(_lock);
+    _batchBytes += _encoder.encode(
+        sample, _batch + SAMPLELOG_BATCH_HEADER + _batchBytes);
+    _batchCount++;
+    summaryAdd(&_batchSummary, sample);
+    _stats.samples++;
+    // Write when the next sample might not fit
+    if (_batchCount < SAMPLELOG_BATCH_SAMPLES &&
+        _batchBytes + SAMPLECODEC_MAX_SAMPLE <= SAMPLELOG_BATCH_BYTES) {
+        return true;
+    }
+    return writeBatch();
+}
+
+bool SampleLog::flush() {
+    std::lock_guard<std::mutex> lock(_lock);
+    return writeBatch();
+}
+
+uint32_t SampleLog::forEach(Visitor visit, void* context) {
+    std::lock_guard<std::mutex> lock(_lock);
+    uint8_t payload[SAMPLELOG_BATCH_BYTES];
+    uint32_t visited = 0;
+
+    // Sectors are written in a circle, so the oldest follows the head
+    for (uint32_t i = 1; i <= _sectorCount; i++) {
+        uint32_t sector = (_head + i) % _sectorCount;
+        SectorHeader header;
+        if (!readHeader(sector, &header)) continue;
+
+        uint32_t offset = SAMPLELOG_HEADER_SIZE;
+        uint16_t length;
+        while (readBatch(sector, offset, payload, &length) > 0) {
+            SampleDecoder decoder;
+            LogSample sample;
+            size_t used;
+            for (size_t pos = 0; pos < length; pos += used) {
+                used = decoder.decode(payload + pos, length - pos, &sample);
+                if (used == 0) break;
+                visited++;
+                if (!visit(sample, context)) return visited;
+            }
+            offset += SAMPLELOG_BATCH_HEADER + length;
+        }
+    }
+    return visited;
+}
+
+uint32_t SampleLog::query(uint64_t fromUs, uint64_t toUs, Visitor visit,
+                          void* context) {
+    return scan(fromUs, toUs, visit, NULL, context);
+}
+
+namespace {
+
+// Bucket being filled by aggregate()
+struct BucketState {
+    uint64_t fromUs;
+    uint64_t bucketUs;
+    SampleLog::BucketVisitor visit;
+    void* context;
+    uint64_t current;  // Bucket number of summary
+    SampleSummary summary;
+    uint32_t emitted;
+    bool stopped;
+};
+
+// Moves to bucket, emitting the previous one; false once visit said stop
+bool enterBucket(BucketState* state, uint64_t bucket) {
+    if (state->summary.count > 0 && bucket != state->current) {
+        state->emitted++;
+        if (!state->visit(state->fromUs + state->current * state->bucketUs,
+                          state->summary, state->context)) {
+            state->stopped = true;
+            return false;
+        }
+        summaryClear(&state->summary);
+    }
+    state->current = bucket;
+    return true;
+}
+
+bool bucketSample(const LogSample& sample, void* context) {
+    BucketState* state = (BucketState*)context;
+    if (state->stopped) return false;
+    uint64_t bucket = (sample.timestampUs - state->fromUs) / state->bucketUs;
+    if (!enterBucket(state, bucket)) return false;
+    summaryAdd(&state->summary, sample);
+    return true;
+}
+
+// Sectors inside the range and inside one bucket are merged whole
+bool bucketSummary(const SampleSummary& summary, void* context) {
+    BucketState* state = (BucketState*)context;
+    if (state->stopped) return true;  // Nothing more to read
+    uint64_t bucket = (summary.startUs - state->fromUs) / state->bucketUs;
+    if (bucket != (summary.endUs - state->fromUs) / state->bucketUs) {
+        return false;
+    }
+    if (!enterBucket(state, bucket)) return true;
+    summaryMerge(&state->summary, summary);
+    return true;
+}
+
+}  // namespace
+
+uint32_t SampleLog::aggregate(uint64_t fromUs, uint64_t toUs,
+                              uint64_t bucketUs, BucketVisitor visit,
+                              void* context) {
+    if (bucketUs == 0 || toUs <= fromUs) return 0;
+
+    BucketState state = {};
+    state.fromUs      = fromUs;
+    state.bucketUs    = bucketUs;
+    state.visit       = visit;
+    state.context     = context;
+    scan(fromUs, toUs, bucketSample, bucketSummary, &state);
+    if (!state.stopped && state.summary.count > 0) {
+        state.emitted++;
+        visit(fromUs + state.current * bucketUs, state.summary, context);
+    }
+    return state.emitted;
+}
+
+uint32_t SampleLog::scan(uint64_t fromUs, uint64_t toUs, Visitor visit,
+                         SummaryVisitor take, void* context) {
+    uint8_t payload[SAMPLELOG_BATCH_BYTES];
+    LogSample found[SAMPLELOG_BATCH_SAMPLES];
+    uint32_t visited = 0;
+    uint32_t sector;
+    uint32_t startHead;  // Sectors up to here hold data older than the walk
+    uint32_t startSeq;   // Sectors opened later have this or a higher one
+    bool pastStart = false;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_index == NULL) return 0;
+        sector    = (_head + 1) % _sectorCount;
+        startHead = _head;
+        startSeq  = _nextSeq;
+    }
+
+    // Oldest sector first, following the head if it moves meanwhile. A
+    // sector recycled under us is noticed by its changed sequence number.
+    for (uint32_t walked = 0; walked < 2 * _sectorCount; walked++) {
+        uint32_t offset = SAMPLELOG_HEADER_SIZE;
+        SectorIndex entry;
+        bool growing;  // The head sector's summary may change meanwhile
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            // New data ahead of the old means the writer overtook the walk
+            // and recycled the sectors in between; the oldest sector left
+            // follows its head and is newer than anything visited so far
+            if (!pastStart && openedSince(sector, startSeq)) {
+                sector = (_head + 1) % _sectorCount;
+                // Lapped: no data from before the walk is left
+                if (openedSince(sector, startSeq)) pastStart = true;
+            }
+            if (sector == startHead) pastStart = true;
+            entry   = _index[sector];
+            growing = sector == _head;
+        }
+        bool wanted = summaryOverlaps(entry.summary, fromUs, toUs);
+        if (wanted && take != NULL && !growing &&
+            entry.summary.startUs >= fromUs &&
+            entry.summary.endUs < toUs && take(entry.summary, context)) {
+            std::lock_guard<std::mutex> lock(_lock);
+            _stats.querySectors++;
+            wanted = false;
+        }
+
+        bool head = false;
+        for (bool more = true; more;) {
+            size_t count = 0;
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                uint16_t length;
+                if (wanted && _index[sector].seq == entry.seq &&
+                    readBatch(sector, offset, payload, &length) > 0) {
+                    count = decodeRange(payload, length, fromUs, toUs, found);
+                    offset += SAMPLELOG_BATCH_HEADER + length;
+                    _stats.queryBatches++;
+                } else {
+                    // Checked under the same lock as the last batch, so a
+                    // batch written meanwhile is never missed
+                    head = sector == _head;
+                    if (head && _batchCount > 0) {
+                        count = decodeRange(_batch + SAMPLELOG_BATCH_HEADER,
+                                            _batchBytes, fromUs, toUs, found);
+                    }
+                    more = false;
+                }
+            }
+            for (size_t i = 0; i < count; i++) {
+                visited++;
+                if (!visit(found[i], context)) return visited;
+            }
+        }
+        if (head) break;
+        sector = (sector + 1) % _sectorCount;
+    }
+    return visited;
+}
+
+bool SampleLog::openedSince(uint32_t sector, uint32_t seq) const {
+    const SectorIndex& entry = _index[sector];
+    return entry.summary.count > 0 && (int32_t)(entry.seq - seq) >= 0;
+}
+
+SampleLogStats SampleLog::stats() {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _stats;
+}
+
+float SampleLog::writeAmplification() {
+    SampleLogStats current = stats();
+    if (current.payloadBytes == 0) return 0;
+    return (float)current.flashBytes / (float)current.payloadBytes;
+}
+
+float SampleLog::bytesPerSample() {
+    SampleLogStats current = stats();
+    if (current.samples == 0) return 0;
+    return (float)current.flashBytes / (float)current.samples;
+}
+
+bool SampleLog::readHeader(uint32_t sector, SectorHeader* header) {
+    uint8_t raw[SAMPLELOG_HEADER_SIZE];
+    if (!_flash->read(sector * _sectorSize, raw, sizeof(raw))) return false;
+    header->magic = get32(raw);
+    header->seq   = get32(raw + 4);
+    return header->magic == SAMPLELOG_MAGIC &&
+           get16(raw + 8) == crc16Ccitt(raw, 8);
+}
+
+int SampleLog::readBatch(uint32_t sector, uint32_t offset, uint8_t* payload,
+                         uint16_t* length) {
+    uint32_t base = sector * _sectorSize;
+    uint8_t head[SAMPLELOG_BATCH_HEADER];
+    if (offset + SAMPLELOG_BATCH_HEADER > _sectorSize) return 0;
+    if (!_flash->read(base + offset, head, sizeof(head))) return -1;
+
+    uint16_t size = get16(head);
+    uint16_t crc  = get16(head + 2);
+    if (size == 0xFFFF && crc == 0xFFFF) return 0;  // Never written
+    if (size == 0 || size > SAMPLELOG_BATCH_BYTES ||
+        offset + SAMPLELOG_BATCH_HEADER + size > _sectorSize) {
+        return -1;
+    }
+    if (!_flash->read(base + offset + SAMPLELOG_BATCH_HEADER, payload, size)) {
+        return -1;
+    }
+    if (crc16Ccitt(payload, size, crc16Ccitt(head, 2)) != crc) return -1;
+    *length = size;
+    return 1;
+}
+
+uint32_t SampleLog::scanSector(uint32_t sector, bool* torn,
+                               SampleSummary* summary) {
+    uint8_t payload[SAMPLELOG_BATCH_BYTES];
+    LogSample samples[SAMPLELOG_BATCH_SAMPLES];
+    uint32_t offset = SAMPLELOG_HEADER_SIZE;
+    uint16_t length;
+    int result;
+    summaryClear(summary);
+    while ((result = readBatch(sector, offset, payload, &length)) > 0) {
+        size_t count = decodeRange(payload, length, 0, UINT64_MAX, samples);
+        for (size_t i = 0; i < count; i++) summaryAdd(summary, samples[i]);
+        offset += SAMPLELOG_BATCH_HEADER + length;
+    }
+    *torn = result < 0;
+    return offset;
+}
+
+bool SampleLog::openSector() {
+    uint32_t next = (_head + 1) % _sectorCount;
+    SectorHeader old;
+    if (readHeader(next, &old)) _usedSectors--;  // Oldest data goes
+
+    // Advance even on failure so a bad sector is skipped next time
+    _head     = next;
+    _headOpen = false;
+    _index[next] = SectorIndex();
+    _index[next].seq = _nextSeq;
+
+    _stats.erases++;
+    if (!_flash->eraseSector(next)) {
+        _stats.errors++;
+        return false;
+    }
+
+    uint8_t raw[SAMPLELOG_HEADER_SIZE];
+    put32(raw, SAMPLELOG_MAGIC);
+    put32(raw + 4, _nextSeq);
+    put16(raw + 8, crc16Ccitt(raw, 8));
+    put16(raw + 10, 0xFFFF);
+    if (!_flash->write(next * _sectorSize, raw, sizeof(raw))) {
+        _stats.errors++;
+        return false;
+    }
+    _stats.flashBytes += sizeof(raw);
+
+    _nextSeq++;
+    _usedSectors++;
+    _headOffset = SAMPLELOG_HEADER_SIZE;
+    _headOpen   = true;
+    return true;
+}
+
+bool SampleLog::writeBatch() {
+    if (_batchCount == 0) return true;
+
+    uint16_t length = (uint16_t)_batchBytes;
+    uint32_t size   = SAMPLELOG_BATCH_HEADER + length;
+    SampleSummary summary = _batchSummary;
+    _batchCount     = 0;
+    _batchBytes     = 0;
+    _encoder.reset();  // Every batch decodes on its own
+    summaryClear(&_batchSummary);
+
+    if (!_headOpen || _headOffset + size > _sectorSize) {
+        if (!openSector()) return false;
+    }
+
+    put16(_batch, length);
+    put16(_batch + 2,
+          crc16Ccitt(_batch + SAMPLELOG_BATCH_HEADER, length,
+                     crc16Ccitt(_batch, 2)));
+    if (!_flash->write(_head * _sectorSize + _headOffset, _batch, size)) {
+        // The slot may be partly programmed; never write there again
+        _stats.errors++;
+        _headOpen = false;
+        return false;
+    }
+
+    _headOffset += size;
+    summaryMerge(&_index[_head].summary, summary);
+    _stats.batches++;
+    _stats.payloadBytes += length;
+    _stats.flashBytes += size;
+    return true;
+}
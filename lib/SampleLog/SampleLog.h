@@ -0,0 +1,146 @@
+#ifndef _SAMPLE_LOG_H_
+#define _SAMPLE_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+
+#include "FlashPort.h"
+#include "SampleCodec.h"
+#include "SampleSummary.h"
+
+#define SAMPLELOG_MAGIC         0x324C5655UL  // "UVL2", delta coded batches
+#define SAMPLELOG_HEADER_SIZE   12
+#define SAMPLELOG_BATCH_HEADER  4
+#define SAMPLELOG_BATCH_SAMPLES 32   // Samples per flash write at most
+#define SAMPLELOG_BATCH_BYTES   512  // Encoded bytes per batch at most
+
+typedef struct {
+    uint32_t samples;       // Samples appended since begin()
+    uint32_t batches;       // Batches written
+    uint64_t payloadBytes;  // Delta coded sample bytes
+    uint64_t flashBytes;    // Bytes programmed, headers included
+    uint32_t erases;        // Sectors erased
+    uint32_t tornBatches;   // Incomplete batches found during recovery
+    uint32_t errors;        // Failed flash operations
+    uint32_t queryBatches;  // Batches read by query() and aggregate()
+    uint32_t querySectors;  // Sectors aggregate() took from the index
+} SampleLogStats;
+
+// Append-only sample log on raw flash.
+//
+// The region is used as a circular sequence of sectors. Each sector starts
+// with a header (magic, sequence number, CRC) written right after the
+// erase; samples follow in batches, each with its own length and CRC, so a
+// batch is either fully valid or recognisably torn. A batch is a
+// SampleEncoder block and decodes on its own. Appends are buffered
+// in RAM and written one batch at a time. When the region is full the
+// oldest sector is erased, so every sector is erased equally often.
+//
+// begin() recovers after a power loss: sectors with a bad header count as
+// free, the newest sector is scanned to its last valid batch, and a torn
+// batch closes that sector so no half-programmed bytes are reused.
+//
+// A RAM index keeps a SampleSummary per sector. begin() rebuilds it by
+// decoding the region once and writes keep it current, so time range
+// queries only read the sectors that overlap the range.
+class SampleLog {
+   public:
+    explicit SampleLog(FlashPort* flash);
+    ~SampleLog();
+
+    bool begin();
+    // Erases the whole region
+    bool format();
+
+    // Buffers one sample, writing a batch when the buffer is full
+    bool append(const LogSample& sample);
+    // Writes buffered samples now
+    bool flush();
+
+    // Calls visit for every stored sample, oldest first, until it returns
+    // false. Samples still in the RAM buffer are not included.
+    typedef bool (*Visitor)(const LogSample& sample, void* context);
+    uint32_t forEach(Visitor visit, void* context);
+
+    // Calls visit for the samples with fromUs <= timestamp < toUs, buffered
+    // ones included, oldest sector first. The lock is taken per batch, so
+    // appends continue during a long export.
+    uint32_t query(uint64_t fromUs, uint64_t toUs, Visitor visit,
+                   void* context);
+    // Summarises [fromUs, toUs) in buckets of bucketUs starting at fromUs
+    // and calls visit for every bucket that has samples, until it returns
+    // false. Sectors lying within one bucket come from the index without
+    // a flash read. Returns the buckets visited.
+    typedef bool (*BucketVisitor)(uint64_t startUs,
+                                  const SampleSummary& summary,
+                                  void* context);
+    uint32_t aggregate(uint64_t fromUs, uint64_t toUs, uint64_t bucketUs,
+                       BucketVisitor visit, void* context);
+
+    uint32_t usedSectors() const {
+        return _usedSectors;
+    }
+    uint32_t sectorCount() const {
+        return _sectorCount;
+    }
+    SampleLogStats stats();
+    // Flash bytes programmed per encoded sample byte, and per sample
+    float writeAmplification();
+    float bytesPerSample();
+
+   private:
+    typedef struct {
+        uint32_t magic;
+        uint32_t seq;
+    } SectorHeader;
+
+    typedef struct {
+        uint32_t seq;           // Header sequence the summary belongs to
+        SampleSummary summary;  // Empty for free sectors
+    } SectorIndex;
+
+    // Returns true when summary was used in place of the sector's samples
+    typedef bool (*SummaryVisitor)(const SampleSummary& summary,
+                                   void* context);
+    uint32_t scan(uint64_t fromUs, uint64_t toUs, Visitor visit,
+                  SummaryVisitor take, void* context);
+    // Whether sector holds samples written in a sector opened with seq or
+    // later; callers hold _lock
+    bool openedSince(uint32_t sector, uint32_t seq) const;
+
+    bool readHeader(uint32_t sector, SectorHeader* header);
+    // Reads the batch at offset into payload: 1 = valid, 0 = end of the
+    // written area, -1 = torn
+    int readBatch(uint32_t sector, uint32_t offset, uint8_t* payload,
+                  uint16_t* length);
+    // Finds the end of the valid batches and summarises them; torn is set
+    // when one is broken
+    uint32_t scanSector(uint32_t sector, bool* torn, SampleSummary* summary);
+    bool openSector();
+    bool writeBatch();
+
+    FlashPort* _flash;
+    uint32_t _sectorSize;
+    uint32_t _sectorCount;
+
+    bool _headOpen;        // _head has a header and room
+    uint32_t _head;        // Sector being written
+    uint32_t _headOffset;  // Next free byte in _head
+    uint32_t _nextSeq;
+    uint32_t _usedSectors;
+
+    SampleEncoder _encoder;
+    uint8_t _batch[SAMPLELOG_BATCH_HEADER + SAMPLELOG_BATCH_BYTES];
+    uint32_t _batchCount;
+    uint32_t _batchBytes;
+    SampleSummary _batchSummary;
+
+    SectorIndex* _index;  // _sectorCount entries
+
+    std::mutex _lock;  // Writer and readers may be different tasks
+    SampleLogStats _stats;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _SAMPLE_SUMMARY_H_
+#define _SAMPLE_SUMMARY_H_
+
+#include <stdint.h>
+
+#include "SampleCodec.h"
+
+#define SAMPLESUMMARY_CHANNELS 3  // uva, uvb, uvc
+
+// Min, max and sum per channel over a run of samples; the mean is sum /
+// count. startUs and endUs are the earliest and latest timestamps, so the
+// summary stays correct when the clock was set backwards in between.
+typedef struct {
+    uint64_t startUs;
+    uint64_t endUs;
+    uint32_t count;
+    uint32_t min[SAMPLESUMMARY_CHANNELS];
+    uint32_t max[SAMPLESUMMARY_CHANNELS];
+    uint64_t sum[SAMPLESUMMARY_CHANNELS];
+} SampleSummary;
+
+inline void summaryClear(SampleSummary* summary) {
+    *summary = SampleSummary();
+}
+
+inline void summaryAdd(SampleSummary* summary, const LogSample& sample) {
+    const uint32_t values[SAMPLESUMMARY_CHANNELS] = {sample.uva, sample.uvb,
+                                                     sample.uvc};
+    bool first = summary->count == 0;
+    if (first || sample.timestampUs < summary->startUs) {
+        summary->startUs = sample.timestampUs;
+    }
+    if (first || sample.timestampUs > summary->endUs) {
+        summary->endUs = sample.timestampUs;
+    }
+    for (int i = 0; i < SAMPLESUMMARY_CHANNELS; i++) {
+        if (first || values[i] < summary->min[i]) summary->min[i] = values[i];
+        if (first || values[i] > summary->max[i]) summary->max[i] = values[i];
+        summary->sum[i] += values[i];
+    }
+    summary->count++;
+}
+
+inline void summaryMerge(SampleSummary* summary, const SampleSummary& other) {
+    if (other.count == 0) return;
+    if (summary->count == 0) {
+        *summary = other;
+        return;
+    }
+    if (other.startUs < summary->startUs) summary->startUs = other.startUs;
+    if (other.endUs > summary->endUs) summary->endUs = other.endUs;
+    for (int i = 0; i < SAMPLESUMMARY_CHANNELS; i++) {
+        if (other.min[i] < summary->min[i]) summary->min[i] = other.min[i];
+        if (other.max[i] > summary->max[i]) summary->max[i] = other.max[i];
+        summary->sum[i] += other.sum[i];
+    }
+    summary->count += other.count;
+}
+
+// True when some sample may lie in [fromUs, toUs)
+inline bool summaryOverlaps(const SampleSummary& summary, uint64_t fromUs,
+                            uint64_t toUs) {
+    return summary.count > 0 && summary.startUs < toUs &&
+           summary.endUs >= fromUs;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _SAMPLE_RING_H_
+#define _SAMPLE_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Single-producer / single-consumer lock-free ring buffer.
+//
+// push() must only ever be called from one task and pop() from one other
+// task; no locks are taken on either side. Head and tail are free-running
+// counters, so all Capacity slots are usable. When the ring is full the
+// newest item is rejected and counted in dropped(), the consumer never sees
+// a partially written slot.
+template <typename T, size_t Capacity>
+class SampleRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SampleRing capacity must be a power of two");
+
+   public:
+    SampleRing() : _head(0), _tail(0), _dropped(0) {
+    }
+
+    // Producer side. Returns false (and counts a drop) if the ring is full.
+    bool push(const T& item) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        if (head - tail >= Capacity) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _items[head & (Capacity - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool pop(T& item) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        if (head == tail) {
+            return false;
+        }
+        item = _items[tail & (Capacity - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        uint32_t head = _head.load(std::memory_order_acquire);
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        return head - tail;
+    }
+
+    size_t capacity() const {
+        return Capacity;
+    }
+
+    // Number of items rejected by push() because the consumer fell behind.
+    uint32_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+   private:
+    T _items[Capacity];
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+    std::atomic<uint32_t> _dropped;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _SEQ_LOCK_H_
+#define _SEQ_LOCK_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Sequence lock for publishing small POD snapshots from one writer task to
+// any number of reader tasks.
+//
+// store() never blocks; load() never blocks the writer and retries until it
+// has copied a value that was not modified during the copy, so readers never
+// see torn data. Only one task may call store() at a time. A reader must not
+// run at a higher priority than the writer on the same core, or it could
+// spin while the writer it preempted is half way through a store().
+template <typename T>
+class SeqLock {
+   public:
+    SeqLock() : _seq(0), _value() {
+    }
+
+    void store(const T& value) {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);  // odd: write begins
+        std::atomic_thread_fence(std::memory_order_release);
+        _value = value;
+        _seq.store(seq + 2, std::memory_order_release);  // even: write done
+    }
+
+    T load() const {
+        T copy;
+        uint32_t before;
+        uint32_t after;
+        do {
+            before = _seq.load(std::memory_order_acquire);
+            copy   = _value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = _seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return copy;
+    }
+
+    // Number of completed store() calls; cheap change detection for readers.
+    uint32_t version() const {
+        return _seq.load(std::memory_order_acquire) >> 1;
+    }
+
+   private:
+    std::atomic<uint32_t> _seq;
+    T _value;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "SparklineChart.h"
+
+#include <esp_timer.h>
+#include <math.h>
+#include <string.h>
+
+#define SPARKLINE_SHRINK 0.4f  // Visible peak / scale that shrinks the scale
+
+SparklineChart::SparklineChart(uint32_t color, uint32_t gridColor,
+                               float minScale)
+    : _ui(NULL),
+      _widget(-1),
+      _rect(),
+      _color(color),
+      _gridColor(gridColor),
+      _minScale(minScale),
+      _scale(minScale),
+      _head(0),
+      _count(0),
+      _columns(0),
+      _undrawn(0),
+      _open(0),
+      _hasOpen(false),
+      _stats() {
+}
+
+void SparklineChart::begin(RetainedCanvas* ui, int widget) {
+    _ui     = ui;
+    _widget = widget;
+    _rect   = ui->widgetRect(widget);
+}
+
+void SparklineChart::add(float value) {
+    if (!_hasOpen || value > _open) _open = value;
+    _hasOpen = true;
+}
+
+void SparklineChart::nextColumn() {
+    _head           = (uint16_t)((_head + 1) % SPARKLINE_MAX_WIDTH);
+    _history[_head] = _hasOpen ? _open : 0;
+    _hasOpen        = false;
+    if (_count < SPARKLINE_MAX_WIDTH) _count++;
+    if (_undrawn < SPARKLINE_MAX_WIDTH) _undrawn++;
+    _columns++;
+    updateScale();
+}
+
+void SparklineChart::render() {
+    if (_ui == NULL) return;
+    uint32_t start = (uint32_t)esp_timer_get_time();
+    int16_t width  = _rect.w < SPARKLINE_MAX_WIDTH ? _rect.w
+                                                   : SPARKLINE_MAX_WIDTH;
+
+    // The scale is the content key, so a new scale clears the widget
+    uint32_t key;
+    memcpy(&key, &_scale, sizeof(key));
+    bool full = _ui->beginWidget(_widget, key);
+    if (full) {
+        for (uint16_t age = 0; age < _count && age < width; age++) {
+            drawColumn((int16_t)(_rect.x + width - 1 - age), age);
+        }
+    } else if (_undrawn > 0) {
+        int16_t shift = _undrawn < width ? (int16_t)_undrawn : width;
+        if (shift < width) {
+            _ui->canvas()->copyRect(_rect.x, _rect.y, width - shift, _rect.h,
+                                    _rect.x + shift, _rect.y);
+        }
+        for (uint16_t age = 0; age < shift; age++) {
+            drawColumn((int16_t)(_rect.x + width - 1 - age), age);
+        }
+        _ui->markDirty(_widget);
+    } else {
+        return;
+    }
+    _undrawn = 0;
+
+    uint32_t elapsed = (uint32_t)esp_timer_get_time() - start;
+    _stats.lastUs    = elapsed;
+    if (full) {
+        _stats.fullRenders++;
+        _stats.fullUs += elapsed;
+    } else {
+        _stats.scrollRenders++;
+        _stats.scrollUs += elapsed;
+    }
+}
+
+float SparklineChart::niceScale(float peak) const {
+    if (peak <= _minScale) return _minScale;
+    float decade = powf(10.0f, floorf(log10f(peak)));
+    if (decade >= peak) return decade;
+    if (2 * decade >= peak) return 2 * decade;
+    if (5 * decade >= peak) return 5 * decade;
+    return 10 * decade;
+}
+
+void SparklineChart::updateScale() {
+    float peak = 0;
+    for (uint16_t age = 0; age < _count; age++) {
+        float value = _history[(_head + SPARKLINE_MAX_WIDTH - age) %
+                               SPARKLINE_MAX_WIDTH];
+        if (value > peak) peak = value;
+    }
+    if (peak > _scale || peak < _scale * SPARKLINE_SHRINK) {
+        _scale = niceScale(peak);
+    }
+}
+
+void SparklineChart::drawColumn(int16_t x, uint16_t age) {
+    M5Canvas* canvas = _ui->canvas();
+    float value =
+        _history[(_head + SPARKLINE_MAX_WIDTH - age) % SPARKLINE_MAX_WIDTH];
+    int16_t bar = (int16_t)(value / _scale * _rect.h + 0.5f);
+    if (bar < 0) bar = 0;
+    if (bar > _rect.h) bar = _rect.h;
+
+    int16_t top = (int16_t)(_rect.y + _rect.h - bar);
+    canvas->drawFastVLine(x, _rect.y, _rect.h - bar, _ui->background());
+    // Dotted lines at the full and half scale, fixed to the data
+    if ((_columns - 1 - age) % SPARKLINE_GRID_STEP == 0) {
+        int16_t half = (int16_t)(_rect.y + _rect.h / 2);
+        if (_rect.y < top) canvas->drawPixel(x, _rect.y, _gridColor);
+        if (half < top) canvas->drawPixel(x, half, _gridColor);
+    }
+    canvas->drawFastVLine(x, top, bar, _color);
+}
@@ -0,0 +1,76 @@
+#ifndef _SPARKLINE_CHART_H_
+#define _SPARKLINE_CHART_H_
+
+#include <stdint.h>
+
+#include "RetainedCanvas.h"
+
+#define SPARKLINE_MAX_WIDTH 240  // History columns kept, one per pixel
+#define SPARKLINE_GRID_STEP 4    // Columns between dots of the grid lines
+
+typedef struct {
+    uint32_t fullRenders;    // Redraws of every column
+    uint32_t fullUs;         // Time spent in them
+    uint32_t scrollRenders;  // Renders that scrolled and drew new columns
+    uint32_t scrollUs;
+    uint32_t lastUs;         // Duration of the last render()
+} SparklineStats;
+
+// Scrolling history chart in a custom RetainedCanvas widget.
+//
+// Each column is the peak of the values added while it was open. The
+// chart keeps its own history, one value per pixel column, so it can be
+// redrawn at any time. Normally render() moves the existing pixels left
+// with copyRect() and only draws the new columns at the right edge; the
+// whole chart is redrawn only when the autoscale changes or the canvas
+// was invalidated. The scale is 1, 2 or 5 times a power of ten and only
+// shrinks once the visible peak is below 40 % of it, so it does not flap.
+class SparklineChart {
+   public:
+    SparklineChart(uint32_t color, uint32_t gridColor, float minScale);
+
+    // Draws into the custom widget of ui
+    void begin(RetainedCanvas* ui, int widget);
+
+    // Raises the open column to value if it is higher
+    void add(float value);
+    // Closes the open column; render() draws it
+    void nextColumn();
+    void render();
+
+    float scale() const {
+        return _scale;
+    }
+    const SparklineStats& stats() const {
+        return _stats;
+    }
+    void resetStats() {
+        _stats = SparklineStats();
+    }
+
+   private:
+    float niceScale(float peak) const;
+    void updateScale();
+    // Draws history column age (0 = newest) at canvas column x
+    void drawColumn(int16_t x, uint16_t age);
+
+    RetainedCanvas* _ui;
+    int _widget;
+    UiRect _rect;
+    uint32_t _color;
+    uint32_t _gridColor;
+    float _minScale;
+    float _scale;
+
+    float _history[SPARKLINE_MAX_WIDTH];  // Ring, _head is the newest
+    uint16_t _head;
+    uint16_t _count;
+    uint32_t _columns;  // Columns closed so far, keeps the grid in place
+    uint16_t _undrawn;  // Columns closed since the last render
+    float _open;        // Peak of the open column
+    bool _hasOpen;
+
+    SparklineStats _stats;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "StreamStats.h"
+
+#include <math.h>
+
+// Target quantile of every marker
+static const float markerQuantiles[STREAMSTATS_MARKERS] = {
+    0.0f, 0.25f, 0.5f, 0.725f, 0.95f, 0.97f, 0.99f, 0.995f, 1.0f};
+
+QuantileEstimator::QuantileEstimator() {
+    reset();
+}
+
+void QuantileEstimator::reset() {
+    _count = 0;
+    for (int i = 0; i < STREAMSTATS_MARKERS; i++) {
+        _heights[i]   = 0;
+        _positions[i] = i + 1;
+    }
+}
+
+void QuantileEstimator::add(float value) {
+    // The first samples are kept sorted and become the initial markers
+    if (_count < STREAMSTATS_MARKERS) {
+        int i = (int)_count++;
+        for (; i > 0 && _heights[i - 1] > value; i--) {
+            _heights[i] = _heights[i - 1];
+        }
+        _heights[i] = value;
+        return;
+    }
+    _count++;
+
+    // Cell the value falls into; the extremes move outwards
+    int cell;
+    if (value < _heights[0]) {
+        _heights[0] = value;
+        cell        = 0;
+    } else if (value >= _heights[STREAMSTATS_MARKERS - 1]) {
+        _heights[STREAMSTATS_MARKERS - 1] = value;
+        cell                              = STREAMSTATS_MARKERS - 2;
+    } else {
+        cell = 0;
+        while (value >= _heights[cell + 1]) cell++;
+    }
+    for (int i = cell + 1; i < STREAMSTATS_MARKERS; i++) _positions[i]++;
+
+    // Nudge interior markers that fell a rank or more off their target
+    float last = (float)(_count - 1);
+    for (int i = 1; i < STREAMSTATS_MARKERS - 1; i++) {
+        float offset = 1.0f + last * markerQuantiles[i] - _positions[i];
+        int step;
+        if (offset >= 1.0f && _positions[i + 1] - _positions[i] > 1) {
+            step = 1;
+        } else if (offset <= -1.0f && _positions[i - 1] - _positions[i] < -1) {
+            step = -1;
+        } else {
+            continue;
+        }
+        float height = parabolic(i, step);
+        if (height <= _heights[i - 1] || height >= _heights[i + 1]) {
+            height = linear(i, step);
+        }
+        _heights[i] = height;
+        _positions[i] += step;
+    }
+}
+
+float QuantileEstimator::parabolic(int i, int step) const {
+    float below = (float)(_positions[i] - _positions[i - 1]);
+    float above = (float)(_positions[i + 1] - _positions[i]);
+    return _heights[i] +
+           step / (below + above) *
+               ((below + step) * (_heights[i + 1] - _heights[i]) / above +
+                (above - step) * (_heights[i] - _heights[i - 1]) / below);
+}
+
+float QuantileEstimator::linear(int i, int step) const {
+    return _heights[i] + step * (_heights[i + step] - _heights[i]) /
+                             (float)(_positions[i + step] - _positions[i]);
+}
+
+float QuantileEstimator::quantile(int marker) const {
+    if (_count == 0) return 0;
+    if (_count >= STREAMSTATS_MARKERS) return _heights[marker];
+    // Nearest rank among the samples seen so far
+    int rank = (int)(markerQuantiles[marker] * (_count - 1) + 0.5f);
+    return _heights[rank];
+}
+
+ChannelStats ChannelStatistics::summary() const {
+    ChannelStats stats;
+    stats.count  = _moments.count();
+    stats.mean   = _moments.mean();
+    stats.stddev = sqrtf(_moments.variance());
+    stats.p50    = _quantiles.p50();
+    stats.p95    = _quantiles.p95();
+    stats.p99    = _quantiles.p99();
+    return stats;
+}
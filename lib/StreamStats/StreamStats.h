@@ -0,0 +1,111 @@
+#ifndef _STREAM_STATS_H_
+#define _STREAM_STATS_H_
+
+#include <stdint.h>
+
+// p50, p95 and p99 are tracked with 2 * 3 + 3 markers
+#define STREAMSTATS_MARKERS 9
+
+typedef struct {
+    uint32_t count;
+    float mean;
+    float stddev;  // Sample standard deviation, 0 below two samples
+    float p50;
+    float p95;
+    float p99;
+} ChannelStats;
+
+// Welford's running mean and variance. Single precision, since the ESP32
+// FPU has no doubles; the update form keeps the error small regardless.
+class RunningStats {
+   public:
+    RunningStats() {
+        reset();
+    }
+
+    void reset() {
+        _count = 0;
+        _mean  = 0;
+        _m2    = 0;
+    }
+
+    void add(float value) {
+        _count++;
+        float delta = value - _mean;
+        _mean += delta / _count;
+        _m2 += delta * (value - _mean);
+    }
+
+    uint32_t count() const {
+        return _count;
+    }
+    float mean() const {
+        return _mean;
+    }
+    float variance() const {
+        return _count > 1 ? _m2 / (_count - 1) : 0;
+    }
+
+   private:
+    uint32_t _count;
+    float _mean;
+    float _m2;
+};
+
+// Extended P^2 quantile estimator (Jain & Chlamtac, extended to several
+// quantiles by Raatikainen) for p50, p95 and p99.
+//
+// Nine markers track the minimum, the three quantiles, the points midway
+// between them and the maximum. Each sample moves the markers by at most
+// one position, adjusted with a parabolic fit, so memory and time per
+// sample are constant. Until nine samples are in, exact order statistics
+// are returned.
+class QuantileEstimator {
+   public:
+    QuantileEstimator();
+
+    void reset();
+    void add(float value);
+
+    uint32_t count() const {
+        return _count;
+    }
+    float p50() const {
+        return quantile(2);
+    }
+    float p95() const {
+        return quantile(4);
+    }
+    float p99() const {
+        return quantile(6);
+    }
+
+   private:
+    float quantile(int marker) const;
+    float parabolic(int i, int step) const;
+    float linear(int i, int step) const;
+
+    uint32_t _count;
+    float _heights[STREAMSTATS_MARKERS];
+    int32_t _positions[STREAMSTATS_MARKERS];  // 1-based ranks
+};
+
+// Mean, deviation and percentiles of one channel
+class ChannelStatistics {
+   public:
+    void reset() {
+        _moments.reset();
+        _quantiles.reset();
+    }
+    void add(float value) {
+        _moments.add(value);
+        _quantiles.add(value);
+    }
+    ChannelStats summary() const;
+
+   private:
+    RunningStats _moments;
+    QuantileEstimator _quantiles;
+};
+
+#endif
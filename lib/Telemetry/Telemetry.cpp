@@ -0,0 +1,104 @@
+#include "Telemetry.h"
+
+Telemetry::Telemetry()
+    : _serial(NULL),
+      _enabled(false),
+      _packed(true),
+      _seq(0),
+      _stats(),
+      _blockBytes(0),
+      _blockStartUs(0) {
+}
+
+void Telemetry::begin(HardwareSerial* serial) {
+    _serial = serial;
+}
+
+void Telemetry::setEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(_lock);
+    // A block left open would start the next session with stale samples
+    if (!enabled) _blockBytes = 0;
+    _enabled = enabled;
+}
+
+void Telemetry::setPacked(bool packed) {
+    std::lock_guard<std::mutex> lock(_lock);
+    if (!packed && _blockBytes != 0 && _serial) sendBlock();
+    _packed = packed;
+}
+
+bool Telemetry::sendUV(const UVSample& sample) {
+    if (!_enabled) return false;
+    uint8_t payload[TELEMETRY_UV_SIZE];
+    return send(TELEMETRY_UV, payload, telemetryPackUV(sample, payload));
+}
+
+bool Telemetry::sendPacked(const LogSample& sample) {
+    if (!_enabled || !_serial) return false;
+
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_blockBytes == 0) {
+        _encoder.reset();
+        _block[0]     = 0;
+        _blockBytes   = 1;
+        _blockStartUs = sample.timestampUs;
+    }
+    _blockBytes += _encoder.encode(sample, _block + _blockBytes);
+    _block[0]++;
+
+    if (_block[0] < TELEMETRY_BLOCK_SAMPLES &&
+        _blockBytes + SAMPLECODEC_MAX_SAMPLE <= TELEMETRY_MAX_PAYLOAD &&
+        sample.timestampUs - _blockStartUs < TELEMETRY_BLOCK_US) {
+        return true;
+    }
+    return sendBlock();
+}
+
+bool Telemetry::flushIfDue(uint64_t nowUs) {
+    if (!_enabled || !_serial) return false;
+
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_blockBytes == 0 || nowUs - _blockStartUs < TELEMETRY_BLOCK_US) {
+        return false;
+    }
+    return sendBlock();
+}
+
+bool Telemetry::sendBattery(const BatterySnapshot& battery) {
+    if (!_enabled) return false;
+    uint8_t payload[TELEMETRY_BATTERY_SIZE];
+    return send(TELEMETRY_BATTERY, payload,
+                telemetryPackBattery(battery, payload));
+}
+
+bool Telemetry::send(uint8_t type, const uint8_t* payload, size_t length) {
+    if (!_serial) return false;
+
+    std::lock_guard<std::mutex> lock(_lock);
+    return write(type, payload, length);
+}
+
+bool Telemetry::write(uint8_t type, const uint8_t* payload, size_t length) {
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    size_t size = telemetryFrame(type, _seq++, payload, length, frame);
+
+    if (_serial->availableForWrite() < (int)size) {
+        _stats.dropped++;
+        return false;
+    }
+    _serial->write(frame, size);
+    _stats.frames++;
+    _stats.bytes += size;
+    return true;
+}
+
+bool Telemetry::sendBlock() {
+    size_t length = _blockBytes;
+    _blockBytes   = 0;
+    return write(TELEMETRY_UV_BLOCK, _block, length);
+}
+
+TelemetryStats Telemetry::stats() {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _stats;
+}
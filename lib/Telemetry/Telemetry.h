@@ -0,0 +1,74 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <atomic>
+#include <mutex>
+
+#include "Arduino.h"
+#include "TelemetryFrame.h"
+
+#define TELEMETRY_BLOCK_US 250000ULL
+
+typedef struct {
+    uint32_t frames;   // Frames written
+    uint32_t dropped;  // Frames skipped because the TX buffer was full
+    uint32_t bytes;    // Encoded bytes written
+} TelemetryStats;
+
+// Binary sample stream on a serial port.
+//
+// Any task may send; frames are built on the caller's stack and written
+// under a mutex so they never interleave. A frame that does not fit into
+// the TX buffer is dropped instead of blocking the sender, and its
+// sequence number is consumed so the host sees the gap.
+//
+// In packed mode UV samples are delta coded into TELEMETRY_UV_BLOCK frames
+// of up to TELEMETRY_BLOCK_SAMPLES samples; a block is also sent once its
+// first sample is TELEMETRY_BLOCK_US old, so the host never lags further.
+// The next sample checks that age, and flushIfDue() does when samples stop
+// coming. Switching to raw mode sends the open block, disabling drops it.
+class Telemetry {
+   public:
+    Telemetry();
+
+    void begin(HardwareSerial* serial);
+    void setEnabled(bool enabled);
+    bool enabled() const {
+        return _enabled;
+    }
+
+    void setPacked(bool packed);
+    bool packed() const {
+        return _packed;
+    }
+
+    bool sendUV(const UVSample& sample);
+    // Adds sample to the current block, sending the block when it is full
+    bool sendPacked(const LogSample& sample);
+    // Sends the open block if its first sample is TELEMETRY_BLOCK_US older
+    // than nowUs, on the clock of LogSample::timestampUs
+    bool flushIfDue(uint64_t nowUs);
+    bool sendBattery(const BatterySnapshot& battery);
+
+    TelemetryStats stats();
+
+   private:
+    bool send(uint8_t type, const uint8_t* payload, size_t length);
+    // Callers hold _lock
+    bool write(uint8_t type, const uint8_t* payload, size_t length);
+    bool sendBlock();
+
+    HardwareSerial* _serial;
+    std::atomic<bool> _enabled;
+    std::atomic<bool> _packed;
+    std::mutex _lock;
+    uint16_t _seq;  // Guarded by _lock, like the stats and the block
+    TelemetryStats _stats;
+
+    SampleEncoder _encoder;
+    uint8_t _block[TELEMETRY_MAX_PAYLOAD];
+    size_t _blockBytes;  // 0 when no block is open
+    uint64_t _blockStartUs;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "TelemetryFrame.h"
+
+#include "Crc16.h"
+#include "UVWeighting.h"
+
+static inline uint8_t* put16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    return out + 2;
+}
+
+static inline uint8_t* put32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+    return out + 4;
+}
+
+size_t cobsEncode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t codePos = 0;
+    size_t outPos  = 1;
+    uint8_t code   = 1;
+
+    for (size_t i = 0; i < length; i++) {
+        if (in[i] != 0) {
+            out[outPos++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[codePos] = code;
+            codePos      = outPos++;
+            code         = 1;
+        }
+    }
+    out[codePos] = code;
+    return outPos;
+}
+
+size_t cobsDecode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t inPos  = 0;
+    size_t outPos = 0;
+
+    while (inPos < length) {
+        uint8_t code = in[inPos++];
+        if (code == 0 || inPos + code - 1 > length) return 0;
+        for (uint8_t i = 1; i < code; i++) {
+            if (in[inPos] == 0) return 0;
+            out[outPos++] = in[inPos++];
+        }
+        if (code != 0xFF && inPos < length) out[outPos++] = 0;
+    }
+    return outPos;
+}
+
+size_t telemetryFrame(uint8_t type, uint16_t seq, const uint8_t* payload,
+                      size_t length, uint8_t* out) {
+    if (length > TELEMETRY_MAX_PAYLOAD) return 0;
+
+    uint8_t raw[TELEMETRY_MAX_PAYLOAD + 5];
+    raw[0]     = type;
+    uint8_t* p = put16(raw + 1, seq);
+    for (size_t i = 0; i < length; i++) *p++ = payload[i];
+    p = put16(p, crc16Ccitt(raw, (size_t)(p - raw)));
+
+    out[0]         = 0;
+    size_t encoded = 1 + cobsEncode(raw, (size_t)(p - raw), out + 1);
+    out[encoded++] = 0;
+    return encoded;
+}
+
+size_t telemetryPackUV(const UVSample& sample, uint8_t* out) {
+    uint8_t* p = put32(out, (uint32_t)sample.timestampUs);
+    p          = put32(p, sample.seq);
+    p          = put32(p, uvToFixed(sample.uva));
+    p          = put32(p, uvToFixed(sample.uvb));
+    p          = put32(p, uvToFixed(sample.uvc));
+    float temp = sample.temp * 100.0f;
+    p = put16(p, (uint16_t)(int16_t)(temp < 0 ? temp - 0.5f : temp + 0.5f));
+    return (size_t)(p - out);
+}
+
+size_t telemetryPackBattery(const BatterySnapshot& battery, uint8_t* out) {
+    uint8_t* p = put32(out, battery.timestampMs);
+    p          = put16(p, battery.millivolts);
+    *p++       = battery.percent;
+    p          = put16(p, (uint16_t)battery.rateMvPerHour);
+    return (size_t)(p - out);
+}
@@ -0,0 +1,49 @@
+#ifndef _TELEMETRY_FRAME_H_
+#define _TELEMETRY_FRAME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BatteryMonitor.h"
+#include "SampleCodec.h"
+#include "UVSample.h"
+
+// Wire format (tools/telemetry_decode.py is the reference decoder):
+//
+//   0x00 COBS( type u8 | seq u16 | payload | crc16 u16 ) 0x00
+//
+// The leading delimiter costs one byte but keeps a text log line written
+// between two frames from swallowing the next one. Integers are little
+// endian. seq counts every frame the device tried to send, so a gap on the
+// host means frames were dropped. The CRC is CRC-16/CCITT-FALSE over type,
+// seq and payload.
+#define TELEMETRY_UV       0x01
+#define TELEMETRY_BATTERY  0x02
+#define TELEMETRY_UV_BLOCK 0x03
+
+#define TELEMETRY_UV_SIZE      22
+#define TELEMETRY_BATTERY_SIZE 9
+
+// UV block: count u8 | count SampleEncoder samples
+#define TELEMETRY_BLOCK_SAMPLES 16
+#define TELEMETRY_MAX_PAYLOAD   (1 + TELEMETRY_BLOCK_SAMPLES * 12)
+// Header + CRC, COBS overhead and both delimiters
+#define TELEMETRY_MAX_FRAME                                  \
+    (TELEMETRY_MAX_PAYLOAD + 5 + (TELEMETRY_MAX_PAYLOAD + 5) / 254 + 1 + 2)
+
+// COBS without the trailing delimiter. Encoding needs length + 1 + length
+// / 254 bytes of output; decoding returns 0 on malformed input.
+size_t cobsEncode(const uint8_t* in, size_t length, uint8_t* out);
+size_t cobsDecode(const uint8_t* in, size_t length, uint8_t* out);
+
+// Builds a complete, delimited frame into out (TELEMETRY_MAX_FRAME bytes)
+size_t telemetryFrame(uint8_t type, uint16_t seq, const uint8_t* payload,
+                      size_t length, uint8_t* out);
+
+// timestamp_us u32 | sample seq u32 | uva, uvb, uvc u32 uW/m^2 |
+// temp i16 centi-degrees C
+size_t telemetryPackUV(const UVSample& sample, uint8_t* out);
+// timestamp_ms u32 | millivolts u16 | percent u8 | rate i16 mV/h
+size_t telemetryPackBattery(const BatterySnapshot& battery, uint8_t* out);
+
+#endif
@@ -0,0 +1,112 @@
+#include "AS7331Port.h"
+
+#ifdef ARDUINO
+
+AS7331Port::AS7331Port()
+    : _i2c(NULL),
+      _addr(AS7331_I2C_ADDR),
+      _gainCode(10),
+      _timeCode(6),
+      _breakTime(0),
+      _measuring(false) {
+}
+
+bool AS7331Port::begin(I2C_Class* i2c, uint8_t addr, uint8_t gainCode,
+                       uint8_t timeCode, uint8_t breakTime) {
+    _i2c       = i2c;
+    _addr      = addr;
+    _gainCode  = gainCode;
+    _timeCode  = timeCode;
+    _breakTime = breakTime;
+    _measuring = false;
+
+    if (!_i2c->exist(_addr)) return false;
+
+    // Software reset, then leave power down in configuration state
+    _i2c->writeByte(_addr, AS7331_REG_OSR,
+                    AS7331_OSR_SW_RES | AS7331_OSR_DOS_CFG);
+    delay(1);
+    if (!_i2c->writeByte(_addr, AS7331_REG_OSR, AS7331_OSR_DOS_CFG)) {
+        return false;
+    }
+
+    uint8_t agen;
+    if (!_i2c->readByte(_addr, AS7331_REG_AGEN, &agen) ||
+        (agen & 0xF0) != AS7331_AGEN_DEVID) {
+        return false;
+    }
+
+    bool success = true;
+    success &= _i2c->writeByte(_addr, AS7331_REG_CREG1,
+                               (uint8_t)((_gainCode << 4) | _timeCode));
+    success &= _i2c->writeByte(_addr, AS7331_REG_CREG3, AS7331_CREG3_CONT);
+    success &= _i2c->writeByte(_addr, AS7331_REG_BREAK, _breakTime);
+    return success;
+}
+
+bool AS7331Port::start() {
+    _measuring = _i2c->writeByte(_addr, AS7331_REG_OSR,
+                                 AS7331_OSR_SS | AS7331_OSR_DOS_MEAS);
+    return _measuring;
+}
+
+bool AS7331Port::readStatus(uint8_t* status) {
+    // In measurement state address 0 reads OSR followed by STATUS
+    uint8_t buffer[2];
+    if (!_i2c->readBytes(_addr, AS7331_REG_OSR, buffer, 2)) return false;
+    *status = buffer[1];
+    return true;
+}
+
+bool AS7331Port::readResults(AS7331Raw* raw) {
+    // OSR, STATUS, TEMP, MRES1, MRES2, MRES3; 16 bit values LSB first
+    uint8_t buffer[10];
+    if (!_i2c->readBytes(_addr, AS7331_REG_OSR, buffer, sizeof(buffer))) {
+        return false;
+    }
+    raw->status = buffer[1];
+    raw->temp   = (uint16_t)(buffer[2] | (buffer[3] << 8));
+    raw->uva    = (uint16_t)(buffer[4] | (buffer[5] << 8));
+    raw->uvb    = (uint16_t)(buffer[6] | (buffer[7] << 8));
+    raw->uvc    = (uint16_t)(buffer[8] | (buffer[9] << 8));
+    return true;
+}
+
+bool AS7331Port::setRange(uint8_t gainCode, uint8_t timeCode) {
+    if (gainCode > AS7331_GAIN_CODE_MAX || timeCode > AS7331_TIME_CODE_MAX) {
+        return false;
+    }
+    if (!writeConfig(AS7331_REG_CREG1,
+                     (uint8_t)((gainCode << 4) | timeCode))) {
+        return false;
+    }
+    _gainCode = gainCode;
+    _timeCode = timeCode;
+    return true;
+}
+
+bool AS7331Port::setBreakTime(uint8_t breakTime) {
+    if (!writeConfig(AS7331_REG_BREAK, breakTime)) return false;
+    _breakTime = breakTime;
+    return true;
+}
+
+bool AS7331Port::writeConfig(uint8_t reg, uint8_t value) {
+    // Configuration registers are only writable in configuration state
+    bool wasMeasuring = _measuring;
+    bool success      = true;
+    if (wasMeasuring) {
+        success &= _i2c->writeByte(_addr, AS7331_REG_OSR, AS7331_OSR_DOS_CFG);
+        _measuring = false;
+    }
+    success &= _i2c->writeByte(_addr, reg, value);
+    if (wasMeasuring) success &= start();
+    return success;
+}
+
+uint32_t AS7331Port::conversionPeriodUs() const {
+    // 1024 clocks at 1.024 MHz = 1 ms, plus the break in 8 us steps
+    return (1000UL << _timeCode) + (uint32_t)_breakTime * 8;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _AS7331_PORT_H_
+#define _AS7331_PORT_H_
+
+#ifdef ARDUINO
+
+#include "Arduino.h"
+#include "I2C_Class.h"
+#include "UVSensorPort.h"
+
+// AS7331 on a real I2C bus, configured for continuous measurement with the
+// conversion clock fixed at 1.024 MHz.
+class AS7331Port : public UVSensorPort {
+   public:
+    AS7331Port();
+
+    // Soft reset, ID check and configuration. Leaves the sensor in
+    // configuration state; call start() to begin converting.
+    bool begin(I2C_Class* i2c, uint8_t addr = AS7331_I2C_ADDR,
+               uint8_t gainCode = 10, uint8_t timeCode = 6,
+               uint8_t breakTime = 112);
+    bool start();
+
+    bool readStatus(uint8_t* status) override;
+    bool readResults(AS7331Raw* raw) override;
+    bool setRange(uint8_t gainCode, uint8_t timeCode) override;
+    bool setBreakTime(uint8_t breakTime) override;
+    uint8_t gainCode() const override {
+        return _gainCode;
+    }
+    uint8_t timeCode() const override {
+        return _timeCode;
+    }
+    uint8_t breakTime() const override {
+        return _breakTime;
+    }
+    uint32_t conversionPeriodUs() const override;
+
+   private:
+    // Writes a configuration register, leaving and re-entering the
+    // measurement state around it when needed
+    bool writeConfig(uint8_t reg, uint8_t value);
+
+    I2C_Class* _i2c;
+    uint8_t _addr;
+    uint8_t _gainCode;
+    uint8_t _timeCode;
+    uint8_t _breakTime;
+    bool _measuring;
+};
+
+#endif
+
+#endif
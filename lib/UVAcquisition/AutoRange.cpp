@@ -0,0 +1,102 @@
+#include "AutoRange.h"
+
+#define AS7331_OVERFLOW_FLAGS \
+    (AS7331_STATUS_OUTCONVOF | AS7331_STATUS_MRESOF | AS7331_STATUS_ADCOF)
+
+AutoRange::AutoRange(uint8_t lowPercent, uint8_t highPercent,
+                     uint8_t minTimeCode, uint8_t maxTimeCode)
+    : _lowPercent(0), _highPercent(0), _minTimeCode(0), _maxTimeCode(0) {
+    setBand(lowPercent, highPercent);
+    setTimeLimits(minTimeCode, maxTimeCode);
+}
+
+void AutoRange::setBand(uint8_t lowPercent, uint8_t highPercent) {
+    if (highPercent > 100) highPercent = 100;
+    if (lowPercent >= highPercent) lowPercent = highPercent / 2;
+    _lowPercent  = lowPercent;
+    _highPercent = highPercent;
+}
+
+void AutoRange::setTimeLimits(uint8_t minTimeCode, uint8_t maxTimeCode) {
+    if (maxTimeCode > AS7331_TIME_CODE_MAX) maxTimeCode = AS7331_TIME_CODE_MAX;
+    if (minTimeCode > maxTimeCode) minTimeCode = maxTimeCode;
+    _minTimeCode = minTimeCode;
+    _maxTimeCode = maxTimeCode;
+}
+
+uint32_t AutoRange::fullScaleCounts(uint8_t timeCode) {
+    uint32_t clocks = as7331ConversionClocks(timeCode);
+    return clocks > 65535 ? 65535 : clocks;
+}
+
+uint8_t AutoRange::exponent(uint8_t gainCode, uint8_t timeCode) {
+    return (uint8_t)(AS7331_GAIN_CODE_MAX - gainCode + timeCode);
+}
+
+void AutoRange::split(uint8_t exp, uint8_t* gainCode, uint8_t* timeCode) const {
+    // Highest gain first; conversion time only makes up what gain cannot
+    uint8_t time = _minTimeCode;
+    if (exp > AS7331_GAIN_CODE_MAX + time) {
+        time = (uint8_t)(exp - AS7331_GAIN_CODE_MAX);
+    }
+    *timeCode = time;
+    *gainCode = (uint8_t)(AS7331_GAIN_CODE_MAX - (exp - time));
+}
+
+bool AutoRange::update(const AS7331Raw& raw, uint8_t* gainCode,
+                       uint8_t* timeCode) const {
+    uint8_t gain = *gainCode;
+    uint8_t time = *timeCode;
+
+    uint32_t fullScale = fullScaleCounts(time);
+    uint32_t peak      = raw.uva;
+    if (raw.uvb > peak) peak = raw.uvb;
+    if (raw.uvc > peak) peak = raw.uvc;
+
+    bool overflow = (raw.status & AS7331_OVERFLOW_FLAGS) || peak >= fullScale;
+    bool inRange  = time >= _minTimeCode && time <= _maxTimeCode;
+    if (!overflow && inRange && peak * 100 >= fullScale * _lowPercent &&
+        peak * 100 <= fullScale * _highPercent) {
+        return false;
+    }
+
+    // A clipped result only tells that the light is at least full scale;
+    // assume twice that and let the next result refine it
+    if (overflow) peak = fullScale * 2;
+    if (peak == 0) peak = 1;
+
+    uint8_t current  = exponent(gain, time);
+    uint8_t minExp   = _minTimeCode;
+    uint8_t maxExp   = (uint8_t)(AS7331_GAIN_CODE_MAX + _maxTimeCode);
+    uint32_t target  = (_lowPercent + _highPercent) / 2;  // Percent
+    uint8_t bestExp  = current;
+    uint64_t bestErr = UINT64_MAX;
+
+    for (uint8_t exp = minExp; exp <= maxExp; exp++) {
+        uint8_t g, t;
+        split(exp, &g, &t);
+        // Predicted peak relative to the target, both in percent * counts
+        uint64_t predicted = (uint64_t)peak * 100;
+        if (exp >= current) {
+            predicted <<= (exp - current);
+        } else {
+            predicted >>= (current - exp);
+        }
+        uint64_t wanted = (uint64_t)fullScaleCounts(t) * target;
+        // Log distance: ratio above 1 counts the same as its inverse
+        uint64_t err = predicted > wanted ? predicted * 1024 / wanted
+                                          : wanted * 1024 / (predicted | 1);
+        // Strictly better only, so the shortest time wins a tie
+        if (err < bestErr) {
+            bestErr = err;
+            bestExp = exp;
+        }
+    }
+
+    uint8_t newGain, newTime;
+    split(bestExp, &newGain, &newTime);
+    if (newGain == gain && newTime == time) return false;
+    *gainCode = newGain;
+    *timeCode = newTime;
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef _AUTO_RANGE_H_
+#define _AUTO_RANGE_H_
+
+#include <stdint.h>
+
+#include "UVSensorPort.h"
+
+// Default headroom band, in percent of the full scale counts
+#define AUTORANGE_LOW_PERCENT  20
+#define AUTORANGE_HIGH_PERCENT 80
+// Shortest conversion allowed (16 ms, 14 bit) and longest (256 ms)
+#define AUTORANGE_MIN_TIME_CODE 4
+#define AUTORANGE_MAX_TIME_CODE 8
+
+// Picks AS7331 gain and conversion time from the last raw result.
+//
+// The largest of the three channels must stay inside a headroom band
+// [low, high] of the full scale counts. While it does, the range is left
+// alone; once it leaves the band (or the sensor flags an overflow), the
+// controller predicts the counts for every allowed range and picks the one
+// closest to the middle of the band. Gain is raised before conversion time,
+// so the shortest conversion that still reaches the band is used and time is
+// traded back for gain as soon as the light allows it.
+//
+// Reported irradiance is computed with the range each conversion was made
+// at, so values stay continuous across changes.
+class AutoRange {
+   public:
+    AutoRange(uint8_t lowPercent = AUTORANGE_LOW_PERCENT,
+              uint8_t highPercent = AUTORANGE_HIGH_PERCENT,
+              uint8_t minTimeCode = AUTORANGE_MIN_TIME_CODE,
+              uint8_t maxTimeCode = AUTORANGE_MAX_TIME_CODE);
+
+    void setBand(uint8_t lowPercent, uint8_t highPercent);
+    void setTimeLimits(uint8_t minTimeCode, uint8_t maxTimeCode);
+
+    // Returns true and sets gainCode/timeCode to the new range when raw,
+    // measured at the given range, asks for a change.
+    bool update(const AS7331Raw& raw, uint8_t* gainCode,
+                uint8_t* timeCode) const;
+
+    // Counts at which the 16 bit result or the conversion clips
+    static uint32_t fullScaleCounts(uint8_t timeCode);
+
+   private:
+    // Sensitivity exponent: log2(gain) + timeCode
+    static uint8_t exponent(uint8_t gainCode, uint8_t timeCode);
+    void split(uint8_t exp, uint8_t* gainCode, uint8_t* timeCode) const;
+
+    uint8_t _lowPercent;
+    uint8_t _highPercent;
+    uint8_t _minTimeCode;
+    uint8_t _maxTimeCode;
+};
+
+#endif
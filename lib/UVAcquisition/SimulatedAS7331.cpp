@@ -0,0 +1,89 @@
+#include "SimulatedAS7331.h"
+
+SimulatedAS7331::SimulatedAS7331(ClockFn clock, uint8_t gainCode,
+                                 uint8_t timeCode, uint32_t breakUs)
+    : _clock(clock),
+      _gainCode(gainCode),
+      _timeCode(timeCode),
+      _breakUs(breakUs),
+      _periodOverrideUs(0),
+      _startUs(clock()),
+      _lastRead(0),
+      _delivered(0),
+      _uva(0),
+      _uvb(0),
+      _uvc(0) {
+}
+
+void SimulatedAS7331::setIrradiance(float uva, float uvb, float uvc) {
+    _uva = uva;
+    _uvb = uvb;
+    _uvc = uvc;
+}
+
+void SimulatedAS7331::setReadyPeriodUs(uint32_t periodUs) {
+    _periodOverrideUs = periodUs;
+}
+
+uint32_t SimulatedAS7331::readyPeriodUs() const {
+    if (_periodOverrideUs != 0) return _periodOverrideUs;
+    return (1000UL << _timeCode) + _breakUs;
+}
+
+uint32_t SimulatedAS7331::conversions() const {
+    return (uint32_t)((_clock() - _startUs) / readyPeriodUs());
+}
+
+bool SimulatedAS7331::readStatus(uint8_t* status) {
+    uint32_t completed = conversions();
+    uint8_t value      = 0;
+    if (completed > _lastRead) value |= AS7331_STATUS_NDATA;
+    if (completed > _lastRead + 1) value |= AS7331_STATUS_LDATA;
+    *status = value;
+    return true;
+}
+
+bool SimulatedAS7331::readResults(AS7331Raw* raw) {
+    readStatus(&raw->status);
+    raw->uva  = counts(_uva, AS7331_FSR_UVA);
+    raw->uvb  = counts(_uvb, AS7331_FSR_UVB);
+    raw->uvc  = counts(_uvc, AS7331_FSR_UVC);
+    raw->temp = (uint16_t)((25.0f + 66.9f) / 0.05f);  // 25 C
+    if (raw->status & AS7331_STATUS_NDATA) {
+        if (raw->uva == 0xFFFF || raw->uvb == 0xFFFF || raw->uvc == 0xFFFF) {
+            raw->status |= AS7331_STATUS_MRESOF;
+        }
+        _lastRead = conversions();
+        _delivered++;
+    }
+    return true;
+}
+
+bool SimulatedAS7331::setRange(uint8_t gainCode, uint8_t timeCode) {
+    if (gainCode > AS7331_GAIN_CODE_MAX || timeCode > AS7331_TIME_CODE_MAX) {
+        return false;
+    }
+    _gainCode = gainCode;
+    _timeCode = timeCode;
+    restart();
+    return true;
+}
+
+bool SimulatedAS7331::setBreakTime(uint8_t breakTime) {
+    _breakUs = (uint32_t)breakTime * 8;
+    restart();
+    return true;
+}
+
+void SimulatedAS7331::restart() {
+    _startUs  = _clock();
+    _lastRead = 0;
+}
+
+uint16_t SimulatedAS7331::counts(float irradiance, float fsr) const {
+    float value = irradiance * (float)as7331GainValue(_gainCode) *
+                  (float)as7331ConversionClocks(_timeCode) / fsr;
+    if (value >= 65535.0f) return 0xFFFF;
+    if (value <= 0.0f) return 0;
+    return (uint16_t)(value + 0.5f);
+}
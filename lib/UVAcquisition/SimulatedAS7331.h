@@ -0,0 +1,69 @@
+#ifndef _SIMULATED_AS7331_H_
+#define _SIMULATED_AS7331_H_
+
+#include <stdint.h>
+
+#include "UVSensorPort.h"
+
+// AS7331 stand-in with no hardware dependency.
+//
+// Conversions complete every readyPeriodUs() on the supplied clock. Status
+// reads report NDATA when a completed conversion has not been read yet and
+// LDATA when at least one was overwritten, like the real part in
+// continuous mode. Counts scale with gain and conversion time, so range
+// changes behave like on the sensor.
+class SimulatedAS7331 : public UVSensorPort {
+   public:
+    typedef uint64_t (*ClockFn)(void);
+
+    SimulatedAS7331(ClockFn clock, uint8_t gainCode = 10,
+                    uint8_t timeCode = 6, uint32_t breakUs = 896);
+
+    // Irradiance the simulated sensor "sees", in uW/cm^2
+    void setIrradiance(float uva, float uvb, float uvc);
+    // Overrides the conversion-derived ready rate (0 = derived)
+    void setReadyPeriodUs(uint32_t periodUs);
+    uint32_t readyPeriodUs() const;
+
+    // Conversions completed since the last range change, and results
+    // delivered in total
+    uint32_t conversions() const;
+    uint32_t delivered() const {
+        return _delivered;
+    }
+
+    bool readStatus(uint8_t* status) override;
+    bool readResults(AS7331Raw* raw) override;
+    bool setRange(uint8_t gainCode, uint8_t timeCode) override;
+    bool setBreakTime(uint8_t breakTime) override;
+    uint8_t gainCode() const override {
+        return _gainCode;
+    }
+    uint8_t timeCode() const override {
+        return _timeCode;
+    }
+    uint8_t breakTime() const override {
+        return (uint8_t)(_breakUs / 8);
+    }
+    uint32_t conversionPeriodUs() const override {
+        return readyPeriodUs();
+    }
+
+   private:
+    void restart();
+    uint16_t counts(float irradiance, float fsr) const;
+
+    ClockFn _clock;
+    uint8_t _gainCode;
+    uint8_t _timeCode;
+    uint32_t _breakUs;
+    uint32_t _periodOverrideUs;
+    uint64_t _startUs;
+    uint32_t _lastRead;  // Index of the last conversion read
+    uint32_t _delivered;
+    float _uva;
+    float _uvb;
+    float _uvc;
+};
+
+#endif
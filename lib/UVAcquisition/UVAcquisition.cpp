@@ -0,0 +1,105 @@
+#include "UVAcquisition.h"
+
+UVAcquisition::UVAcquisition(UVSensorPort* port)
+    : _port(port),
+      _autoRange(NULL),
+      _seq(0),
+      _haveLast(false),
+      _lastReadyUs(0),
+      _nextPollUs(0),
+      _lastRaw(),
+      _stats() {
+}
+
+bool UVAcquisition::setRange(uint8_t gainCode, uint8_t timeCode) {
+    if (!_port->setRange(gainCode, timeCode)) {
+        _stats.errors++;
+        return false;
+    }
+    restarted();
+    return true;
+}
+
+bool UVAcquisition::setBreakTime(uint8_t breakTime) {
+    if (!_port->setBreakTime(breakTime)) {
+        _stats.errors++;
+        return false;
+    }
+    restarted();
+    return true;
+}
+
+void UVAcquisition::restarted() {
+    // The conversion in flight was restarted; do not count it as missed
+    _haveLast   = false;
+    _nextPollUs = 0;
+}
+
+bool UVAcquisition::poll(uint64_t nowUs, UVSample* sample) {
+    uint32_t periodUs = _port->conversionPeriodUs();
+
+    uint8_t status;
+    if (!_port->readStatus(&status)) {
+        _stats.errors++;
+        _nextPollUs = nowUs + pollIntervalUs(periodUs);
+        return false;
+    }
+    if (!(status & AS7331_STATUS_NDATA)) {
+        _stats.idlePolls++;
+        _nextPollUs = nowUs + pollIntervalUs(periodUs);
+        return false;
+    }
+
+    AS7331Raw raw;
+    if (!_port->readResults(&raw)) {
+        _stats.errors++;
+        _nextPollUs = nowUs + pollIntervalUs(periodUs);
+        return false;
+    }
+
+    // LDATA: at least one result was overwritten. The time since the last
+    // read tells how many.
+    uint32_t missed = 0;
+    if ((status | raw.status) & AS7331_STATUS_LDATA) {
+        missed = 1;
+        if (_haveLast) {
+            uint32_t periods = (uint32_t)((nowUs - _lastReadyUs + periodUs / 2) /
+                                          periodUs);
+            if (periods > 1) missed = periods - 1;
+        }
+    }
+    _stats.missed += missed;
+    _seq += missed;
+    _stats.samples++;
+
+    _haveLast    = true;
+    _lastReadyUs = nowUs;
+    _lastRaw     = raw;
+    // Sleep through most of the next conversion, then poll in short steps
+    _nextPollUs = nowUs + periodUs - periodUs / 8;
+
+    uint8_t gain = _port->gainCode();
+    uint8_t time = _port->timeCode();
+    sample->seq         = _seq++;
+    sample->timestampUs = nowUs;
+    sample->uva  = as7331Irradiance(raw.uva, AS7331_FSR_UVA, gain, time);
+    sample->uvb  = as7331Irradiance(raw.uvb, AS7331_FSR_UVB, gain, time);
+    sample->uvc  = as7331Irradiance(raw.uvc, AS7331_FSR_UVC, gain, time);
+    sample->temp = as7331Temperature(raw.temp);
+
+    // The sample above already uses the range it was measured at, so a
+    // change here does not cause a step in the reported values
+    if (_autoRange && _autoRange->update(raw, &gain, &time)) {
+        if (setRange(gain, time)) _stats.rangeChanges++;
+    }
+    return true;
+}
+
+uint32_t UVAcquisition::nextPollDelayUs(uint64_t nowUs) const {
+    return _nextPollUs > nowUs ? (uint32_t)(_nextPollUs - nowUs) : 0;
+}
+
+uint32_t UVAcquisition::pollIntervalUs(uint32_t periodUs) {
+    uint32_t interval = periodUs / 16;
+    return interval < 250 ? 250 : interval;
+}
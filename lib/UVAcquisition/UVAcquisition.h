@@ -0,0 +1,68 @@
+#ifndef _UV_ACQUISITION_H_
+#define _UV_ACQUISITION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "AutoRange.h"
+#include "UVSample.h"
+#include "UVSensorPort.h"
+
+typedef struct {
+    uint32_t samples;    // Conversions read
+    uint32_t missed;     // Conversions overwritten before they were read
+    uint32_t idlePolls;  // Status reads that found nothing new
+    uint32_t errors;     // Failed bus transactions
+    uint32_t rangeChanges;  // Gain/time changes made by the auto ranger
+} UVAcquisitionStats;
+
+// Data-ready driven AS7331 reader.
+//
+// Instead of reading on a fixed period, poll() checks the STATUS register
+// and reads the results only when NDATA says a new conversion finished, so
+// every conversion is read exactly once. Missed conversions (LDATA) are
+// counted and reflected as gaps in UVSample::seq. nextPollDelayUs() tells
+// the caller how long it can sleep: close to a full conversion period right
+// after a result, then short intervals until the next one is ready.
+//
+// With an AutoRange attached, each result is checked against its headroom
+// band and the range is changed before the next conversion starts.
+class UVAcquisition {
+   public:
+    explicit UVAcquisition(UVSensorPort* port);
+
+    // Changes the sensor range; conversions restart on the sensor
+    bool setRange(uint8_t gainCode, uint8_t timeCode);
+    bool setBreakTime(uint8_t breakTime);
+    // Automatic ranging after every result; NULL keeps the range fixed
+    void setAutoRange(const AutoRange* autoRange) {
+        _autoRange = autoRange;
+    }
+
+    // Returns true and fills sample when a new conversion was read.
+    bool poll(uint64_t nowUs, UVSample* sample);
+    uint32_t nextPollDelayUs(uint64_t nowUs) const;
+
+    const AS7331Raw& lastRaw() const {
+        return _lastRaw;
+    }
+    const UVAcquisitionStats& stats() const {
+        return _stats;
+    }
+
+   private:
+    void restarted();
+    static uint32_t pollIntervalUs(uint32_t periodUs);
+
+    UVSensorPort* _port;
+    const AutoRange* _autoRange;
+
+    uint32_t _seq;
+    bool _haveLast;
+    uint64_t _lastReadyUs;
+    uint64_t _nextPollUs;
+    AS7331Raw _lastRaw;
+    UVAcquisitionStats _stats;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _UV_SAMPLE_H_
+#define _UV_SAMPLE_H_
+
+#include <stdint.h>
+
+// One AS7331 reading as published by the acquisition task.
+typedef struct {
+    uint32_t seq;          // Monotonic sample number, starts at 0
+    uint64_t timestampUs;  // esp_timer time when the reading was taken
+    float uva;             // uW/cm^2
+    float uvb;             // uW/cm^2
+    float uvc;             // uW/cm^2
+    float temp;            // degrees C
+} UVSample;
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef _UV_SENSOR_PORT_H_
+#define _UV_SENSOR_PORT_H_
+
+#include <stdint.h>
+
+// AS7331 register map (configuration state unless noted)
+#define AS7331_I2C_ADDR   0x74
+#define AS7331_REG_OSR    0x00  // Both states; reads OSR + STATUS in meas.
+#define AS7331_REG_TEMP   0x01  // Measurement state, 16 bit
+#define AS7331_REG_MRES1  0x02  // Measurement state, UVA, 16 bit
+#define AS7331_REG_AGEN   0x02  // Configuration state, device ID
+#define AS7331_REG_CREG1  0x06  // GAIN[7:4] TIME[3:0]
+#define AS7331_REG_CREG2  0x07
+#define AS7331_REG_CREG3  0x08  // MMODE[7:6] SB[4] RDYOD[3] CCLK[1:0]
+#define AS7331_REG_BREAK  0x09  // Pause between conversions, 8 us steps
+
+#define AS7331_OSR_SS        0x80
+#define AS7331_OSR_PD        0x40
+#define AS7331_OSR_SW_RES    0x08
+#define AS7331_OSR_DOS_CFG   0x02
+#define AS7331_OSR_DOS_MEAS  0x03
+#define AS7331_AGEN_DEVID    0x20
+#define AS7331_CREG3_CONT    0x00
+
+#define AS7331_STATUS_OUTCONVOF 0x80
+#define AS7331_STATUS_MRESOF    0x40
+#define AS7331_STATUS_ADCOF     0x20
+#define AS7331_STATUS_LDATA     0x10  // Unread results were overwritten
+#define AS7331_STATUS_NDATA     0x08  // New results since the last read
+#define AS7331_STATUS_NOTREADY  0x04
+
+// Gain code 0 = 2048x ... 11 = 1x, time code 0 = 1 ms ... 14 = 16384 ms
+#define AS7331_GAIN_CODE_MAX 11
+#define AS7331_TIME_CODE_MAX 14
+
+// Full scale irradiance at 1x gain in uW/cm^2 (datasheet, CCLK 1.024 MHz)
+#define AS7331_FSR_UVA 348160.0f
+#define AS7331_FSR_UVB 387072.0f
+#define AS7331_FSR_UVC 169984.0f
+
+typedef struct {
+    uint8_t status;  // STATUS byte read together with the results
+    uint16_t temp;   // Raw 12 bit temperature
+    uint16_t uva;    // Raw counts, MRES1..3
+    uint16_t uvb;
+    uint16_t uvc;
+} AS7331Raw;
+
+static inline uint16_t as7331GainValue(uint8_t gainCode) {
+    return (uint16_t)(2048 >> gainCode);
+}
+
+// Clock cycles (= full scale counts before the 16 bit result clips) of one
+// conversion at CCLK 1.024 MHz
+static inline uint32_t as7331ConversionClocks(uint8_t timeCode) {
+    return 1024UL << timeCode;
+}
+
+static inline float as7331Irradiance(uint16_t counts, float fsr,
+                                     uint8_t gainCode, uint8_t timeCode) {
+    return (float)counts * fsr /
+           ((float)as7331GainValue(gainCode) *
+            (float)as7331ConversionClocks(timeCode));
+}
+
+static inline float as7331Temperature(uint16_t raw) {
+    return (float)raw * 0.05f - 66.9f;
+}
+
+// Register level access to an AS7331 running in continuous mode.
+//
+// Implemented by AS7331Port on a real I2C bus and by SimulatedAS7331 on a
+// Linux host, so UVAcquisition can be exercised without hardware.
+class UVSensorPort {
+   public:
+    virtual ~UVSensorPort() {
+    }
+
+    // STATUS byte only (short read used while waiting for a conversion)
+    virtual bool readStatus(uint8_t* status) = 0;
+    // STATUS, temperature and the three channels in one burst
+    virtual bool readResults(AS7331Raw* raw) = 0;
+    // Changes gain and conversion time; conversions restart
+    virtual bool setRange(uint8_t gainCode, uint8_t timeCode) = 0;
+    // Pause between conversions in 8 us steps; conversions restart
+    virtual bool setBreakTime(uint8_t breakTime) = 0;
+    virtual uint8_t gainCode() const = 0;
+    virtual uint8_t timeCode() const = 0;
+    virtual uint8_t breakTime() const = 0;
+    // Time between two consecutive results (conversion + break)
+    virtual uint32_t conversionPeriodUs() const = 0;
+};
+
+#endif
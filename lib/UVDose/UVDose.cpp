@@ -0,0 +1,86 @@
+#include "UVDose.h"
+
+#define PJ_PER_MJ 1000000000ULL
+// uW/m^2 for one second, in pJ/m^2
+#define PJ_PER_UW_SECOND 1000000ULL
+
+UVDose::UVDose(uint32_t limitMj, uint64_t maxGapUs)
+    : _limitMj(limitMj),
+      _maxGapUs(maxGapUs),
+      _dayEndUs(UVDOSE_DAY_US),
+      _haveLast(false),
+      _lastUs(0),
+      _lastIrradiance(0),
+      _sessionPj(0),
+      _dailyPj(0),
+      _skippedGaps(0) {
+}
+
+void UVDose::setLimitMj(uint32_t limitMj) {
+    _limitMj = limitMj;
+}
+
+void UVDose::setTimeOfDay(uint64_t nowUs, uint32_t secondsSinceMidnight) {
+    uint64_t sinceMidnightUs = (uint64_t)(secondsSinceMidnight % 86400) * 1000000;
+    _dayEndUs                = nowUs + UVDOSE_DAY_US - sinceMidnightUs;
+}
+
+void UVDose::accumulate(uint32_t from, uint32_t to, uint64_t dtUs) {
+    uint64_t pj = (((uint64_t)from + to) * dtUs) >> 1;
+    _sessionPj += pj;
+    _dailyPj += pj;
+}
+
+void UVDose::addSample(uint64_t timestampUs, uint32_t irradiance) {
+    if (_haveLast && timestampUs > _lastUs) {
+        uint64_t dtUs = timestampUs - _lastUs;
+        if (dtUs > _maxGapUs) {
+            _skippedGaps++;
+        } else if (timestampUs >= _dayEndUs && _lastUs < _dayEndUs) {
+            // Split at midnight, interpolating the irradiance there
+            uint64_t beforeUs = _dayEndUs - _lastUs;
+            int64_t delta     = (int64_t)irradiance - (int64_t)_lastIrradiance;
+            uint32_t midnight = (uint32_t)((int64_t)_lastIrradiance +
+                                           delta * (int64_t)beforeUs /
+                                               (int64_t)dtUs);
+            accumulate(_lastIrradiance, midnight, beforeUs);
+            _dailyPj = 0;
+            _dayEndUs += UVDOSE_DAY_US;
+            accumulate(midnight, irradiance, dtUs - beforeUs);
+        } else {
+            accumulate(_lastIrradiance, irradiance, dtUs);
+        }
+    }
+
+    // Days passed without integrating (first sample, skipped gap)
+    while (timestampUs >= _dayEndUs) {
+        _dailyPj = 0;
+        _dayEndUs += UVDOSE_DAY_US;
+    }
+
+    _haveLast       = true;
+    _lastUs         = timestampUs;
+    _lastIrradiance = irradiance;
+}
+
+void UVDose::resetSession() {
+    _sessionPj = 0;
+}
+
+uint32_t UVDose::secondsToLimit() const {
+    uint64_t limitPj = (uint64_t)_limitMj * PJ_PER_MJ;
+    if (_dailyPj >= limitPj) return 0;
+    if (_lastIrradiance == 0) return UVDOSE_NO_LIMIT;
+    uint64_t seconds =
+        (limitPj - _dailyPj) / ((uint64_t)_lastIrradiance * PJ_PER_UW_SECOND);
+    return seconds >= UVDOSE_NO_LIMIT ? UVDOSE_NO_LIMIT - 1 : (uint32_t)seconds;
+}
+
+UVDoseTotals UVDose::totals() const {
+    UVDoseTotals totals;
+    totals.irradiance     = _lastIrradiance;
+    totals.sessionMj      = (uint32_t)(_sessionPj / PJ_PER_MJ);
+    totals.dailyMj        = (uint32_t)(_dailyPj / PJ_PER_MJ);
+    totals.secondsToLimit = secondsToLimit();
+    return totals;
+}
@@ -0,0 +1,74 @@
+#ifndef _UV_DOSE_H_
+#define _UV_DOSE_H_
+
+#include <stdint.h>
+
+// Gaps longer than this (sensor stopped, burst reconfiguration) are not
+// integrated; the exposure during them is unknown
+#define UVDOSE_MAX_GAP_US 10000000ULL
+#define UVDOSE_DAY_US     86400000000ULL
+// Daily limit, 1 SED = 100 J/m^2
+#define UVDOSE_LIMIT_MJ   100000
+
+#define UVDOSE_NO_LIMIT 0xFFFFFFFFUL
+
+typedef struct {
+    uint32_t irradiance;      // Latest weighted irradiance, uW/m^2
+    uint32_t sessionMj;       // Dose since boot or resetSession(), mJ/m^2
+    uint32_t dailyMj;         // Dose since the start of the day, mJ/m^2
+    uint32_t secondsToLimit;  // At the latest irradiance, UVDOSE_NO_LIMIT
+                              // when it is zero, 0 when already reached
+} UVDoseTotals;
+
+// Incremental weighted UV dose.
+//
+// Each sample adds the trapezoid between it and the previous sample, using
+// the exact timestamps, so irregular intervals (auto-ranging, bursts, missed
+// conversions) integrate correctly. Everything is integer: irradiance in
+// uW/m^2 times microseconds gives pJ/m^2 in 64 bit accumulators, good for
+// years of full sunlight.
+class UVDose {
+   public:
+    explicit UVDose(uint32_t limitMj = UVDOSE_LIMIT_MJ,
+                    uint64_t maxGapUs = UVDOSE_MAX_GAP_US);
+
+    void setLimitMj(uint32_t limitMj);
+    // Local time of day at nowUs, so the daily total restarts at midnight;
+    // without it a day starts at boot
+    void setTimeOfDay(uint64_t nowUs, uint32_t secondsSinceMidnight);
+
+    // Adds one weighted irradiance sample, uW/m^2 (see uvWeighted())
+    void addSample(uint64_t timestampUs, uint32_t irradiance);
+    void resetSession();
+
+    uint64_t sessionPj() const {
+        return _sessionPj;
+    }
+    uint64_t dailyPj() const {
+        return _dailyPj;
+    }
+    uint32_t secondsToLimit() const;
+    UVDoseTotals totals() const;
+
+    // Intervals left out because they exceeded the max gap
+    uint32_t skippedGaps() const {
+        return _skippedGaps;
+    }
+
+   private:
+    void accumulate(uint32_t from, uint32_t to, uint64_t dtUs);
+
+    uint32_t _limitMj;
+    uint64_t _maxGapUs;
+    uint64_t _dayEndUs;
+
+    bool _haveLast;
+    uint64_t _lastUs;
+    uint32_t _lastIrradiance;
+
+    uint64_t _sessionPj;
+    uint64_t _dailyPj;
+    uint32_t _skippedGaps;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "UVRollup.h"
+
+static_assert(sizeof(UVRollup) <= ROLLUP_BUDGET_BYTES,
+              "UVRollup slots exceed ROLLUP_BUDGET_BYTES");
+
+UVRollup::UVRollup() {
+    _rings[ROLLUP_SECONDS].slots = _seconds;
+    _rings[ROLLUP_MINUTES].slots = _minutes;
+    _rings[ROLLUP_HOURS].slots   = _hours;
+    reset();
+}
+
+uint64_t UVRollup::periodUs(RollupLevel level) {
+    switch (level) {
+        case ROLLUP_SECONDS:
+            return 1000000ULL;
+        case ROLLUP_MINUTES:
+            return 60 * 1000000ULL;
+        default:
+            return 3600 * 1000000ULL;
+    }
+}
+
+size_t UVRollup::slots(RollupLevel level) {
+    switch (level) {
+        case ROLLUP_SECONDS:
+            return ROLLUP_SECOND_SLOTS;
+        case ROLLUP_MINUTES:
+            return ROLLUP_MINUTE_SLOTS;
+        default:
+            return ROLLUP_HOUR_SLOTS;
+    }
+}
+
+void UVRollup::reset() {
+    std::lock_guard<std::mutex> lock(_lock);
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        _rings[level].newest  = 0;
+        _rings[level].started = false;
+    }
+}
+
+void UVRollup::add(const LogSample& sample) {
+    std::lock_guard<std::mutex> lock(_lock);
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        addTo((RollupLevel)level, sample);
+    }
+}
+
+void UVRollup::addTo(RollupLevel level, const LogSample& sample) {
+    Ring& ring    = _rings[level];
+    size_t size   = slots(level);
+    uint64_t slot = sample.timestampUs / periodUs(level);
+
+    // Slots the ring moves past are cleared once, so this stays O(1) per
+    // sample on average and is bounded by the ring size after a gap
+    if (!ring.started || slot >= ring.newest + size) {
+        for (size_t i = 0; i < size; i++) ring.slots[i] = Slot();
+        ring.newest  = slot;
+        ring.started = true;
+    } else if (slot > ring.newest) {
+        while (ring.newest < slot) ring.slots[++ring.newest % size] = Slot();
+    } else if (ring.newest - slot >= size) {
+        return;  // Older than the ring
+    }
+
+    const uint32_t values[SAMPLESUMMARY_CHANNELS] = {sample.uva, sample.uvb,
+                                                     sample.uvc};
+    Slot& target = ring.slots[slot % size];
+    bool first   = target.count == 0;
+    for (int i = 0; i < SAMPLESUMMARY_CHANNELS; i++) {
+        if (first || values[i] < target.min[i]) target.min[i] = values[i];
+        if (first || values[i] > target.max[i]) target.max[i] = values[i];
+        target.sum[i] += values[i];
+    }
+    target.count++;
+}
+
+size_t UVRollup::history(RollupLevel level, size_t count, SampleSummary* out) {
+    std::lock_guard<std::mutex> lock(_lock);
+    const Ring& ring = _rings[level];
+    size_t size      = slots(level);
+    uint64_t period  = periodUs(level);
+    if (!ring.started) return 0;
+    if (count > size) count = size;
+    if (count > ring.newest + 1) count = (size_t)ring.newest + 1;
+
+    uint64_t slot = ring.newest + 1 - count;
+    for (size_t i = 0; i < count; i++, slot++) {
+        const Slot& source     = ring.slots[slot % size];
+        SampleSummary& summary = out[i];
+        summary.startUs        = slot * period;
+        summary.endUs          = summary.startUs + period - 1;
+        summary.count          = source.count;
+        for (int c = 0; c < SAMPLESUMMARY_CHANNELS; c++) {
+            summary.min[c] = source.min[c];
+            summary.max[c] = source.max[c];
+            summary.sum[c] = source.sum[c];
+        }
+    }
+    return count;
+}
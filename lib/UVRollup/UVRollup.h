@@ -0,0 +1,88 @@
+#ifndef _UV_ROLLUP_H_
+#define _UV_ROLLUP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+
+#include "SampleCodec.h"
+#include "SampleSummary.h"
+
+// Slots kept per resolution; the defaults cover 2 minutes of seconds,
+// 2 hours of minutes and 2 days of hours in about 16 KB
+#ifndef ROLLUP_SECOND_SLOTS
+#define ROLLUP_SECOND_SLOTS 120
+#endif
+#ifndef ROLLUP_MINUTE_SLOTS
+#define ROLLUP_MINUTE_SLOTS 120
+#endif
+#ifndef ROLLUP_HOUR_SLOTS
+#define ROLLUP_HOUR_SLOTS 48
+#endif
+#define ROLLUP_MAX_SLOTS                                                  \
+    (ROLLUP_SECOND_SLOTS > ROLLUP_MINUTE_SLOTS                            \
+         ? (ROLLUP_SECOND_SLOTS > ROLLUP_HOUR_SLOTS ? ROLLUP_SECOND_SLOTS \
+                                                    : ROLLUP_HOUR_SLOTS)  \
+         : (ROLLUP_MINUTE_SLOTS > ROLLUP_HOUR_SLOTS ? ROLLUP_MINUTE_SLOTS \
+                                                    : ROLLUP_HOUR_SLOTS))
+// Upper bound on sizeof(UVRollup), checked at compile time
+#ifndef ROLLUP_BUDGET_BYTES
+#define ROLLUP_BUDGET_BYTES 16384
+#endif
+
+typedef enum {
+    ROLLUP_SECONDS = 0,
+    ROLLUP_MINUTES,
+    ROLLUP_HOURS,
+    ROLLUP_LEVELS
+} RollupLevel;
+
+// Rolling min/max/mean history of the UV channels at 1 s, 1 min and 1 h.
+//
+// Every level is a ring of fixed slots indexed by timestamp / period, so
+// add() costs one slot update per level and memory never grows. A slot
+// is cleared when the ring wraps onto it; samples older than a ring are
+// ignored by that ring only. One writer (processing task) and any number
+// of readers, serialised by a mutex.
+class UVRollup {
+   public:
+    UVRollup();
+
+    void reset();
+    void add(const LogSample& sample);
+
+    // Copies the newest count slots of level, oldest first, into out; the
+    // newest is the slot of the last sample added. startUs and endUs are
+    // the slot bounds, and empty slots are included with count 0 so the
+    // spacing stays even. Returns the slots copied, at most slots(level).
+    size_t history(RollupLevel level, size_t count, SampleSummary* out);
+
+    static uint64_t periodUs(RollupLevel level);
+    static size_t slots(RollupLevel level);
+
+   private:
+    // Slot without its time span, which follows from its position
+    typedef struct {
+        uint32_t count;
+        uint32_t min[SAMPLESUMMARY_CHANNELS];
+        uint32_t max[SAMPLESUMMARY_CHANNELS];
+        uint64_t sum[SAMPLESUMMARY_CHANNELS];
+    } Slot;
+
+    typedef struct {
+        Slot* slots;
+        uint64_t newest;  // Period number of the newest slot
+        bool started;
+    } Ring;
+
+    void addTo(RollupLevel level, const LogSample& sample);
+
+    Slot _seconds[ROLLUP_SECOND_SLOTS];
+    Slot _minutes[ROLLUP_MINUTE_SLOTS];
+    Slot _hours[ROLLUP_HOUR_SLOTS];
+    Ring _rings[ROLLUP_LEVELS];
+    std::mutex _lock;
+};
+
+#endif
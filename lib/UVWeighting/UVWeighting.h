@@ -0,0 +1,137 @@
+#ifndef _UV_WEIGHTING_H_
+#define _UV_WEIGHTING_H_
+
+#include <stdint.h>
+
+// Channel irradiance in uW/m^2, the fixed-point input of the kernel
+typedef struct {
+    uint32_t uva;
+    uint32_t uvb;
+    uint32_t uvc;
+} UVIrradiance;
+
+// Severity bands of the scale, in the order of the profile thresholds
+typedef enum {
+    UV_BAND_SAFE,     // Below safe(), no protection needed
+    UV_BAND_CAUTION,  // Below caution(), protection recommended
+    UV_BAND_HIGH
+} UVBand;
+
+typedef struct {
+    uint32_t weighted;     // Weighted irradiance, uW/m^2
+    uint32_t centiIndex;   // Index * 100
+    uint32_t scaleQ16;     // Position on the scale, 0..65536
+    uint8_t band;          // UVBand
+} UVRating;
+
+// Weight as a Q16 constant, evaluated by the compiler
+constexpr uint32_t uvQ16(double weight) {
+    return (uint32_t)(weight * 65536.0 + 0.5);
+}
+
+// Profiles describe the channel weights, how much weighted irradiance
+// makes one index unit and the scale thresholds (index * 100). Everything
+// is a constexpr function so the kernel folds it into immediates.
+
+// The eye-sensitivity weighting this device was built around: UVB
+// dominant, thresholds lowered for Stargardt disease.
+struct StargardtProfile {
+    static constexpr uint32_t weightUva() {
+        return uvQ16(0.1);
+    }
+    static constexpr uint32_t weightUvb() {
+        return uvQ16(0.7);
+    }
+    static constexpr uint32_t weightUvc() {
+        return uvQ16(0.05);
+    }
+    // Index = weighted uW/cm^2 / 25
+    static constexpr uint32_t weightedPerCentiIndex() {
+        return 2500;
+    }
+    static constexpr uint32_t safe() {
+        return 200;
+    }
+    static constexpr uint32_t caution() {
+        return 300;
+    }
+    static constexpr uint32_t scaleMax() {
+        return 600;
+    }
+};
+
+// WHO UV index, UVI = 40 m^2/W * erythemal irradiance. The broadband
+// channel weights approximate the CIE erythema action spectrum and should
+// be calibrated against a reference radiometer.
+struct StandardUVIProfile {
+    static constexpr uint32_t weightUva() {
+        return uvQ16(0.001);
+    }
+    static constexpr uint32_t weightUvb() {
+        return uvQ16(0.1);
+    }
+    static constexpr uint32_t weightUvc() {
+        return 0;
+    }
+    // 40 m^2/W = 0.004 per uW/m^2 = 1 centi-index per 250 uW/m^2
+    static constexpr uint32_t weightedPerCentiIndex() {
+        return 250;
+    }
+    static constexpr uint32_t safe() {
+        return 300;
+    }
+    static constexpr uint32_t caution() {
+        return 600;
+    }
+    static constexpr uint32_t scaleMax() {
+        return 1100;
+    }
+};
+
+// uW/cm^2 as reported by the sensor -> uW/m^2, clamped to 32 bits
+static inline uint32_t uvToFixed(float uwPerCm2) {
+    float value = uwPerCm2 * 10000.0f;
+    if (value <= 0.0f) return 0;
+    if (value >= 4294967040.0f) return 0xFFFFFFFFUL;
+    return (uint32_t)value;
+}
+
+static inline UVIrradiance uvIrradiance(float uva, float uvb, float uvc) {
+    UVIrradiance irradiance;
+    irradiance.uva = uvToFixed(uva);
+    irradiance.uvb = uvToFixed(uvb);
+    irradiance.uvc = uvToFixed(uvc);
+    return irradiance;
+}
+
+template <typename Profile>
+inline uint32_t uvWeighted(const UVIrradiance& in) {
+    uint64_t sum = (uint64_t)in.uva * Profile::weightUva() +
+                   (uint64_t)in.uvb * Profile::weightUvb() +
+                   (uint64_t)in.uvc * Profile::weightUvc();
+    sum >>= 16;
+    return sum > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)sum;
+}
+
+// Weighted irradiance, index, scale position and band in one pass. The
+// divisions are by constants and the band is a sum of comparisons.
+template <typename Profile>
+inline UVRating uvRate(const UVIrradiance& in) {
+    static_assert(Profile::safe() < Profile::caution() &&
+                      Profile::caution() <= Profile::scaleMax(),
+                  "UV profile thresholds must be increasing");
+
+    UVRating rating;
+    rating.weighted   = uvWeighted<Profile>(in);
+    rating.centiIndex = rating.weighted / Profile::weightedPerCentiIndex();
+
+    uint32_t clipped = rating.centiIndex < Profile::scaleMax()
+                           ? rating.centiIndex
+                           : Profile::scaleMax();
+    rating.scaleQ16 = (clipped << 16) / Profile::scaleMax();
+    rating.band     = (uint8_t)((rating.centiIndex >= Profile::safe()) +
+                            (rating.centiIndex >= Profile::caution()));
+    return rating;
+}
+
+#endif
@@ -9,53 +9,239 @@
 
 #include <Arduino.h>
 #include <Wire.h>
-#include <SparkFun_AS7331.h>
+#include <esp_timer.h>
+#include <atomic>
+#include <time.h>
 #include "M5StickCPlus2.h"
 #include "M5GFX.h"
+#include "BatteryMonitor.h"
+#include "BurstCapture.h"
+#include "ButtonEvents.h"
+#include "CommandLine.h"
+#include "FrameGovernor.h"
+#include "I2C_Class.h"
+#include "MeasurementState.h"
+#include "RetainedCanvas.h"
+#include "EspPartitionFlash.h"
+#include "SampleLog.h"
+#include "SampleRing.h"
+#include "SparklineChart.h"
+#include "Telemetry.h"
+#include "UVAcquisition.h"
+#include "UVDose.h"
+#include "UVRollup.h"
+#include "UVSample.h"
+#include "UVWeighting.h"
 
-SfeAS7331ArdI2C myUVSensor;
+#ifdef UV_SIMULATED_SENSOR
+#include "SimulatedAS7331.h"
+#else
+#include "AS7331Port.h"
+#endif
 
+// I2C on GPIO32/33 (Grove port) with the AS7331
+::I2C_Class uvBus;
+
+#ifdef UV_SIMULATED_SENSOR
+uint64_t simulatedClock()
+{
+    return (uint64_t)esp_timer_get_time();
+}
+SimulatedAS7331 uvSensor(simulatedClock);
+#else
+AS7331Port uvSensor;
+#endif
+
+// Reads each AS7331 conversion once, as soon as it is ready
+UVAcquisition uvAcq(&uvSensor);
+// Keeps the peak channel within 20..80 % of full scale between conversions
+AutoRange uvRange;
+TaskHandle_t acquisitionTaskHandle = NULL;
+
+// Samples flow from acquisitionTask (producer) to processingTask (consumer)
+SampleRing<UVSample, 32> uvSamples;
+TaskHandle_t processingTaskHandle = NULL;
+
+// Raw high rate captures in PSRAM, dumped over serial afterwards
+BurstCapture burst;
+
+// Serial commands, polled by commandTask
+CommandLine commands;
+
+// Weighting and thresholds for the index, scale and dose, chosen at build
+// time (-DUV_PROFILE_STANDARD for the WHO UV index)
+#ifdef UV_PROFILE_STANDARD
+typedef StandardUVIProfile UVProfile;
+#else
+typedef StargardtProfile UVProfile;
+#endif
+
+// Weighted dose, integrated by processingTask only
+UVDose dose;
+std::atomic<bool> doseResetRequested(false);
+
+// Persistent sample log on the "uvlog" flash partition. processingTask
+// queues samples, storageTask batches them into flash so a slow write or
+// erase never holds up processing.
+EspPartitionFlash logFlash;
+SampleLog sampleLog(&logFlash);
+SampleRing<LogSample, 64> logQueue;
+bool logReady = false;
+// Added to esp_timer time to get us since 1970 (0 without an RTC)
+uint64_t wallClockOffsetUs = 0;
+
+// 1 s / 1 min / 1 h min/max/mean history, fed by processingTask
+UVRollup rollup;
+
+// Binary sample stream, enabled with the "telemetry on" command
+Telemetry telemetry;
+
+// Current sample, maxima and display settings; read lock-free by the UI
+MeasurementState state;
+
+// Fed by batteryTask, read with snapshot() from the UI
+BatteryMonitor battery;
+
+// GPIO interrupts -> queue -> onButtonEvent()
+ButtonEvents buttons;
+
+// Sprite colour depth: 4 or 8 bit paletted, or 16 bit RGB565. The UI only
+// uses the few UI_* colours below, so 4 bit sprites (16 KB each instead of
+// 64 KB) look the same; the palette is expanded to RGB565 while pushing.
+#ifndef UI_COLOR_DEPTH
+#define UI_COLOR_DEPTH 4
+#endif
+
+#if UI_COLOR_DEPTH == 16
+#define UI_BLACK  BLACK
+#define UI_WHITE  WHITE
+#define UI_GREEN  GREEN
+#define UI_YELLOW YELLOW
+#define UI_RED    RED
+#define UI_GREY   DARKGREY
+#elif UI_COLOR_DEPTH == 4 || UI_COLOR_DEPTH == 8
+// Palette indices, RGB values in uiPalette
+#define UI_BLACK  0
+#define UI_WHITE  1
+#define UI_GREEN  2
+#define UI_YELLOW 3
+#define UI_RED    4
+#define UI_GREY   5
+
+static const uint8_t uiPalette[][3] = {
+    {0, 0, 0},       // UI_BLACK
+    {255, 255, 255}, // UI_WHITE
+    {0, 255, 0},     // UI_GREEN
+    {255, 255, 0},   // UI_YELLOW
+    {255, 0, 0},     // UI_RED
+    {128, 128, 128}, // UI_GREY
+};
+#else
+#error "UI_COLOR_DEPTH must be 4, 8 or 16"
+#endif
+
+// Whether a second sprite is drawn while the first goes out by DMA. At 4
+// and 8 bit LovyanGFX expands the rows to RGB565 on the CPU before the
+// transfer, so drawing cannot overlap it and the second sprite only costs
+// memory; by default only 16 bit sprites are double buffered.
+#ifndef UI_DOUBLE_BUFFER
+#define UI_DOUBLE_BUFFER (UI_COLOR_DEPTH == 16)
+#endif
+
+// Full-screen sprites; canvasBack is only allocated with UI_DOUBLE_BUFFER
 M5Canvas canvas(&StickCP2.Display);
+M5Canvas canvasBack(&StickCP2.Display);
+
+// Only widgets whose text changed are redrawn and pushed
+RetainedCanvas ui(&canvas, UI_BLACK);
+
+// UV index history, one column per CHART_COLUMN_MS; shown instead of the
+// readings while chartView is set (double-click A)
+SparklineChart uvChart(UI_YELLOW, UI_GREY, 2.0f);
+std::atomic<bool> chartView(false);
 
-float maxuva = 0;
-float maxuvb = 0;
-float maxuvc = 0;
+// Set by the "ui reset" command, applied by loop(), the owner of the
+// canvas, chart and governor counters
+std::atomic<bool> uiStatsResetRequested(false);
+
+// Widget ids, assigned in setupUi()
+struct
+{
+    int batVolt;
+    int batPct;
+    int scaleBar;
+    int advice;
+    int uvIndex;
+    int uva;
+    int uvb;
+    int uvc;
+    int temp;
+    int maxLabel;
+    int maxUva;
+    int maxUvb;
+    int maxUvc;
+    int dose;
+    int chartLabel;
+    int chart;
+} widgets;
 
 #define BUTTON_A GPIO_NUM_37
 #define BUTTON_B GPIO_NUM_39
 
+// Index of each button in the ButtonEvents pin list
+#define BUTTON_INDEX_A 0
+#define BUTTON_INDEX_B 1
+
 #define TAG "UV"
 
-void buttonTask(void *pvParameters);
+#define UV_GAIN_CODE       10  // 2x
+#define UV_TIME_CODE       6   // 64 ms conversions
+#define UV_BREAK_TIME      112 // 8 us steps between conversions
+#define UI_POLL_MS         50  // How often the loop checks for display changes
+#define UI_MIN_FRAME_MS    100 // Frame rate cap while values change
+#define UI_HEARTBEAT_MS    2000 // Frame period while nothing changes
+#define BATTERY_PERIOD_MS  1000 // Battery voltage sampling period
+#define BURST_CAPACITY     65536 // Records (12 B each) in PSRAM
+#define COMMAND_POLL_MS    20   // Serial command polling period
+#define SERIAL_BAUD        1500000 // Same rate as upload_speed
+#define STORAGE_PERIOD_MS  100  // Log queue draining period
+#define LOG_FLUSH_MS       10000 // Longest a partial batch stays in RAM
+#define SERIAL_TX_BUFFER   4096 // Absorbs telemetry bursts without blocking
+#define TELEMETRY_FLUSH_MS 25   // Age check of a packed block without samples
+#define CHART_COLUMN_MS    1000 // 240 columns = 4 minutes of history
 
-// Function to convert voltage (in mV) to percentage
-int voltageToPercentage(int voltage_mV)
-{
-    // Map 3700 mV -> 0% and 4200 mV -> 100%
-    float pct = ((float)voltage_mV - 3700.0f) / (4200.0f - 3700.0f) * 100.0f;
-    if (pct < 0.0f)
-        pct = 0.0f;
-    if (pct > 100.0f)
-        pct = 100.0f;
-    return (int)(pct + 0.5f); // round to nearest int
-}
+// Where the two display sprites live. The ESP32 SPI DMA cannot read
+// PSRAM, so there LovyanGFX copies every frame through small internal
+// buffers and the transfer no longer runs on its own; use it only when
+// internal RAM is short.
+#ifndef UI_BUFFERS_IN_PSRAM
+#define UI_BUFFERS_IN_PSRAM 0
+#endif
 
-int getStableBatteryPercentage()
-{
-    const int numReadings = 10;
-    int total_mV = 0;
+// Draws a frame only when a shown value changes at its display precision
+FrameGovernor governor(UI_MIN_FRAME_MS, UI_HEARTBEAT_MS);
 
-    for (int i = 0; i < numReadings; i++)
-    {
-        total_mV += (int)StickCP2.Power.getBatteryVoltage(); // mV per M5Unified
-        delay(10);
-    }
-
-    int average_mV = total_mV / numReadings;
-    return voltageToPercentage(average_mV);
-}
-
-bool displayPaused = false;
+bool createUiSprite(M5Canvas *sprite);
+void setupUi();
+void drawFrame(const MeasurementSnapshot &snap, const BatterySnapshot &bat, const UVRating &rating,
+               bool shownChart);
+void onButtonEvent(const ButtonEvent &event, void *context);
+void acquisitionTask(void *pvParameters);
+#ifdef UV_READY_PIN
+void onUVReady();
+#endif
+void processingTask(void *pvParameters);
+void batteryTask(void *pvParameters);
+void commandTask(void *pvParameters);
+void storageTask(void *pvParameters);
+void onLogCommand(int argc, char *argv[], Print *out, void *context);
+void onBurstCommand(int argc, char *argv[], Print *out, void *context);
+void onDoseCommand(int argc, char *argv[], Print *out, void *context);
+void onTelemetryCommand(int argc, char *argv[], Print *out, void *context);
+void onTrendCommand(int argc, char *argv[], Print *out, void *context);
+void onStatsCommand(int argc, char *argv[], Print *out, void *context);
+void onI2cCommand(int argc, char *argv[], Print *out, void *context);
+void onUiCommand(int argc, char *argv[], Print *out, void *context);
 
 void setup()
 {
@@ -63,27 +249,50 @@ void setup()
     // cfg.board = board_M5StickCPlus2;
     StickCP2.begin(cfg);
 
-    Serial.begin(115200);
+    Serial.setTxBufferSize(SERIAL_TX_BUFFER);
+    Serial.begin(SERIAL_BAUD);
     delay(2500);
     Serial.println("M5StickCPlus2 initialized");
 
-    StickCP2.Display.setBrightness(100);
+    StickCP2.Display.setBrightness(BRIGHTNESS_DEFAULT);
     StickCP2.Display.setRotation(1);
-    canvas.setTextColor(WHITE, BLACK);
-    canvas.setTextDatum(middle_center);
-    canvas.setFont(&fonts::FreeSans12pt7b);
-    canvas.setTextSize(3);
+    M5Canvas *sprites[] = {&canvas, &canvasBack};
+    for (M5Canvas *sprite : sprites)
+    {
+        sprite->setPsram(UI_BUFFERS_IN_PSRAM);
+        sprite->setColorDepth(UI_COLOR_DEPTH);
+        sprite->setTextColor(UI_WHITE, UI_BLACK);
+        sprite->setTextDatum(middle_center);
+        sprite->setFont(&fonts::FreeSans12pt7b);
+        sprite->setTextSize(3);
+    }
 
-    canvas.createSprite(StickCP2.Display.width(), StickCP2.Display.height());
-    canvas.fillScreen(BLACK);
+    createUiSprite(&canvas);
+    setupUi();
+#if UI_DOUBLE_BUFFER
+    // Without room for the second sprite the UI pushes synchronously
+    if (createUiSprite(&canvasBack))
+    {
+        StickCP2.Display.initDMA();
+        ui.setSecondBuffer(&canvasBack);
+    }
+    else
+    {
+        Serial.println("Display double buffering unavailable, low memory");
+    }
+#endif
 
     // pinMode(32, INPUT_PULLUP); // Enable internal pull-down resistor for pin 32.
     // pinMode(33, INPUT_PULLDOWN);
     pinMode(19, OUTPUT); // Set pin 19 as an output.
 
-    Wire.begin(32, 33);
+    uvBus.begin(&Wire, 32, 33, 400000);
+    // UV sampling goes ahead of slower devices sharing GPIO32/33
+    uvBus.setPriority(AS7331_I2C_ADDR, I2C_PRIORITY_HIGH);
 
-    if (myUVSensor.begin() == false)
+#ifndef UV_SIMULATED_SENSOR
+    if (uvSensor.begin(&uvBus, AS7331_I2C_ADDR,
+                       UV_GAIN_CODE, UV_TIME_CODE, UV_BREAK_TIME) == false)
     {
         Serial.println("Sensor failed to begin. Please check your wiring!");
         Serial.println("Halting...");
@@ -91,160 +300,436 @@ void setup()
             ;
     }
 
-    if (ksfTkErrOk != myUVSensor.setBreakTime(112))
-    {
-        Serial.println("Sensor did not set break time properly.");
-        Serial.println("Halting...");
-        while (1)
-            ;
-    }
+    Serial.println("Set mode to continuous. Starting measurement...");
 
-    // Set measurement mode and change device operating mode to measure.
-    if (myUVSensor.prepareMeasurement(MEAS_MODE_CONT) == false)
+    // Begin measurement.
+    if (uvSensor.start() == false)
+        Serial.println("Error starting reading!");
+#else
+    uvSensor.setIrradiance(120.0f, 40.0f, 2.0f);
+    Serial.println("Using simulated AS7331");
+#endif
+    uvAcq.setAutoRange(&uvRange);
+
+    // The daily dose restarts at local midnight and logged samples get wall
+    // clock timestamps when the RTC has the time
+    if (StickCP2.Rtc.isEnabled())
     {
-        Serial.println("Sensor did not get set properly.");
-        Serial.println("Spinning...");
-        while (1)
-            ;
+        auto now = StickCP2.Rtc.getDateTime();
+        uint64_t nowUs = (uint64_t)esp_timer_get_time();
+        dose.setTimeOfDay(nowUs, now.time.hours * 3600 + now.time.minutes * 60 + now.time.seconds);
+
+        struct tm local = {};
+        local.tm_year = now.date.year - 1900;
+        local.tm_mon = now.date.month - 1;
+        local.tm_mday = now.date.date;
+        local.tm_hour = now.time.hours;
+        local.tm_min = now.time.minutes;
+        local.tm_sec = now.time.seconds;
+        wallClockOffsetUs = (uint64_t)mktime(&local) * 1000000ULL - nowUs;
     }
 
-    Serial.println("Set mode to continuous. Starting measurement...");
+    logReady = logFlash.begin("uvlog") && sampleLog.begin();
+    if (!logReady)
+        Serial.println("Sample log unavailable, check the partition table!");
 
-    // Begin measurement.
-    if (ksfTkErrOk != myUVSensor.setStartState(true))
-        Serial.println("Error starting reading!");
+    xTaskCreatePinnedToCore(
+        storageTask,    // Function that should be called
+        "Storage Task", // Name of the task (for debugging)
+        4096,           // Stack size (in words, not bytes)
+        NULL,           // Parameter to pass to the function
+        1,              // Task priority
+        NULL,           // Task handle
+        1               // Core
+    );
+
+    xTaskCreatePinnedToCore(
+        processingTask,        // Function that should be called
+        "Processing Task",     // Name of the task (for debugging)
+        4096,                  // Stack size (in words, not bytes)
+        NULL,                  // Parameter to pass to the function
+        2,                     // Task priority
+        &processingTaskHandle, // Task handle
+        0                      // Core
+    );
+
+    // Acquisition runs on core 0 so the display push on core 1 (loop) never
+    // delays a sensor read
+    xTaskCreatePinnedToCore(
+        acquisitionTask,        // Function that should be called
+        "Acquisition Task",     // Name of the task (for debugging)
+        4096,                   // Stack size (in words, not bytes)
+        NULL,                   // Parameter to pass to the function
+        3,                      // Task priority
+        &acquisitionTaskHandle, // Task handle
+        0                       // Core
+    );
+
+#ifdef UV_READY_PIN
+    // The READY line signals finished conversions; without it the status
+    // register is polled
+    pinMode(UV_READY_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(UV_READY_PIN), onUVReady, RISING);
+#endif
 
     xTaskCreate(
-        buttonTask,    // Function that should be called
-        "Button Task", // Name of the task (for debugging)
-        4096,          // Stack size (in words, not bytes)
-        NULL,          // Parameter to pass to the function
-        1,             // Task priority
-        NULL           // Task handle
+        batteryTask,    // Function that should be called
+        "Battery Task", // Name of the task (for debugging)
+        2048,           // Stack size (in words, not bytes)
+        NULL,           // Parameter to pass to the function
+        1,              // Task priority
+        NULL            // Task handle
+    );
+
+    if (!burst.begin(BURST_CAPACITY))
+        Serial.println("Burst buffer allocation failed!");
+
+    commands.begin(&Serial);
+    commands.addCommand("burst", "start [samples] | stop | status | dump",
+                        onBurstCommand);
+    commands.addCommand("dose", "[reset]", onDoseCommand);
+    commands.addCommand("telemetry", "on [raw] | off | stats", onTelemetryCommand);
+    commands.addCommand("log", "status | flush | format | range <from> [to] [bucket]", onLogCommand);
+    commands.addCommand("trend", "[s | m | h] [slots]", onTrendCommand);
+    commands.addCommand("stats", "[reset]", onStatsCommand);
+    commands.addCommand("i2c", "[reset]", onI2cCommand);
+    commands.addCommand("ui", "[reset]", onUiCommand);
+    telemetry.begin(&Serial);
+
+    xTaskCreatePinnedToCore(
+        commandTask,    // Function that should be called
+        "Command Task", // Name of the task (for debugging)
+        4096,           // Stack size (in words, not bytes)
+        NULL,           // Parameter to pass to the function
+        1,              // Task priority
+        NULL,           // Task handle
+        1               // Core
     );
+
+    const uint8_t buttonPins[] = {BUTTON_A, BUTTON_B};
+    if (!buttons.begin(buttonPins, 2, onButtonEvent, NULL))
+        Serial.println("Button setup failed!");
+}
+
+// Allocates a full-screen sprite and loads the UI palette into it
+bool createUiSprite(M5Canvas *sprite)
+{
+    if (!sprite->createSprite(StickCP2.Display.width(), StickCP2.Display.height()))
+        return false;
+#if UI_COLOR_DEPTH != 16
+    for (size_t i = 0; i < sizeof(uiPalette) / sizeof(uiPalette[0]); i++)
+        sprite->setPaletteColor(i, uiPalette[i][0], uiPalette[i][1], uiPalette[i][2]);
+#endif
+    return true;
+}
+
+void setupUi()
+{
+    const int16_t y = 75;
+    const int16_t line = 16;
+
+    widgets.batVolt = ui.addTextWidget(11, 10, 80, 14, 0.5, UI_WHITE);
+    widgets.batPct = ui.addTextWidget(200, 10, 40, 14, 0.5, UI_WHITE);
+    widgets.scaleBar = ui.addWidget(10, 18, 220, 10);
+    widgets.advice = ui.addTextWidget(10, 35, 98, 14, 0.5, UI_WHITE);
+    widgets.uvIndex = ui.addTextWidget(110, 35, 125, 14, 0.5, UI_WHITE);
+
+    widgets.uva = ui.addTextWidget(10, y, 128, line, 0.7, UI_WHITE);
+    widgets.uvb = ui.addTextWidget(10, y + line, 128, line, 0.7, UI_WHITE);
+    widgets.uvc = ui.addTextWidget(10, y + 2 * line, 128, line, 0.7, UI_WHITE);
+    widgets.temp = ui.addTextWidget(10, y + 3 * line, 128, line, 0.7, UI_WHITE);
+
+    widgets.maxLabel = ui.addTextWidget(140, y - line, 100, line, 0.7, UI_WHITE);
+    widgets.maxUva = ui.addTextWidget(140, y, 100, line, 0.7, UI_WHITE);
+    widgets.maxUvb = ui.addTextWidget(140, y + line, 100, line, 0.7, UI_WHITE);
+    widgets.maxUvc = ui.addTextWidget(140, y + 2 * line, 100, line, 0.7, UI_WHITE);
+    widgets.dose = ui.addTextWidget(140, y + 3 * line, 100, line, 0.7, UI_WHITE);
+
+    // Chart view, over the same area as the readings
+    widgets.chartLabel = ui.addTextWidget(10, 55, 220, 14, 0.5, UI_WHITE);
+    widgets.chart = ui.addWidget(0, 64, 240, 71);
+    uvChart.begin(&ui, widgets.chart);
+
+    ui.invalidateAll();
+}
+
+// Runs on the ButtonEvents task, never in the ISR
+void onButtonEvent(const ButtonEvent &event, void *context)
+{
+    // A click, not a press, resets so that a double-click does not
+    if (event.button == BUTTON_INDEX_A && event.type == BUTTON_CLICK)
+    {
+        StickCP2.Speaker.tone(8000, 20);
+        state.resetMaxima();
+    }
+    else if (event.button == BUTTON_INDEX_A && event.type == BUTTON_DOUBLE_CLICK)
+    {
+        chartView = !chartView; // Applied by loop(), the display owner
+    }
+    else if (event.button == BUTTON_INDEX_A && event.type == BUTTON_LONG_PRESS)
+    {
+        state.togglePaused(); // Freeze the last frame on screen
+    }
+    else if (event.button == BUTTON_INDEX_B && event.type == BUTTON_PRESS)
+    {
+        StickCP2.Speaker.tone(5000, 20);
+        state.cycleBrightness(); // Applied by loop(), the display owner
+    }
+    else if (event.button == BUTTON_INDEX_B && event.type == BUTTON_LONG_PRESS)
+    {
+        // Start a capture that fills the buffer, or end the running one
+        if (!burst.requestStop() && burst.requestStart(burst.capacity()))
+            StickCP2.Speaker.tone(2000, 100);
+    }
+
+    if (event.type == BUTTON_PRESS)
+    {
+        ESP_LOGD(TAG, "button %u latency %u us (max %u us)", event.button,
+                 (unsigned)buttons.lastLatencyUs(), (unsigned)buttons.maxLatencyUs());
+    }
+}
+
+#ifdef UV_READY_PIN
+void IRAM_ATTR onUVReady()
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(acquisitionTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
 }
+#endif
 
-void buttonTask(void *pvParameters)
+// Puts back the sensor setting beginBurst() replaced
+void restoreRange(uint8_t savedGain, uint8_t savedTime, uint8_t savedBreak)
 {
-    // Configure GPIO37 for the button
-    pinMode(BUTTON_A, INPUT_PULLUP); // Button is active LOW
-    pinMode(BUTTON_B, INPUT_PULLUP); // Button is active LOW
+    uvAcq.setBreakTime(savedBreak);
+    uvAcq.setRange(savedGain, savedTime);
+    uvAcq.setAutoRange(&uvRange);
+}
+
+// Switches the sensor to its fastest setting for a burst and back; false if
+// the request was withdrawn meanwhile, with the setting already put back
+bool beginBurst(uint8_t *savedGain, uint8_t *savedTime, uint8_t *savedBreak)
+{
+    *savedGain = uvSensor.gainCode();
+    *savedTime = uvSensor.timeCode();
+    *savedBreak = uvSensor.breakTime();
+
+    uvAcq.setAutoRange(NULL); // One range for the whole capture
+    uvAcq.setBreakTime(BURST_BREAK_TIME);
+    uvAcq.setRange(BurstCapture::matchGainCode(*savedGain, *savedTime),
+                   BURST_TIME_CODE);
+    if (!burst.start(uvSensor.gainCode(), uvSensor.timeCode(),
+                     uvSensor.conversionPeriodUs()))
+    {
+        restoreRange(*savedGain, *savedTime, *savedBreak);
+        ESP_LOGI(TAG, "Burst withdrawn before it started");
+        return false;
+    }
+    ESP_LOGI(TAG, "Burst started, %u us per conversion",
+             (unsigned)uvSensor.conversionPeriodUs());
+    return true;
+}
 
-    bool buttonAPressed = false;
-    bool buttonBPressed = false;
+void endBurst(uint8_t savedGain, uint8_t savedTime, uint8_t savedBreak)
+{
+    burst.finish();
+    restoreRange(savedGain, savedTime, savedBreak);
+    ESP_LOGI(TAG, "Burst finished, %u records", (unsigned)burst.info().count);
+}
+
+void acquisitionTask(void *pvParameters)
+{
+    uint32_t reportedMissed = 0;
+    uint32_t reportedRanges = 0;
+    bool bursting = false;
+    uint8_t savedGain = 0, savedTime = 0, savedBreak = 0;
 
     for (;;)
     {
-        if (digitalRead(BUTTON_A) == LOW && !buttonAPressed) // GPIO37 is active LOW
+        BurstState burstState = burst.state();
+        if (!bursting && burstState == BURST_ARMED)
         {
-            StickCP2.Speaker.tone(8000, 20);
-            maxuva = 0;
-            maxuvb = 0;
-            maxuvc = 0;
-            buttonAPressed = true;
+            bursting = beginBurst(&savedGain, &savedTime, &savedBreak);
         }
-        if (digitalRead(BUTTON_A) == HIGH && buttonAPressed)
+        else if (bursting && burstState == BURST_STOPPING)
         {
-            buttonAPressed = false;
+            endBurst(savedGain, savedTime, savedBreak);
+            bursting = false;
         }
 
-        if (digitalRead(BUTTON_B) == LOW && !buttonBPressed) // GPIO39 is active LOW
+        UVSample sample;
+        if (uvAcq.poll((uint64_t)esp_timer_get_time(), &sample))
         {
-            StickCP2.Speaker.tone(5000, 20);
-
-            static int brightness = 25;
-            brightness += 25;
-            if (brightness > 100)
+            if (bursting && !burst.record(uvAcq.lastRaw(), sample.seq, sample.timestampUs))
             {
-                brightness = 25;
+                endBurst(savedGain, savedTime, savedBreak);
+                bursting = false;
             }
-            StickCP2.Display.setBrightness(brightness);
-            buttonBPressed = true;
+            uvSamples.push(sample); // A full ring counts the sample as dropped
+            xTaskNotifyGive(processingTaskHandle);
         }
-        if (digitalRead(BUTTON_B) == HIGH && buttonBPressed)
+
+        const UVAcquisitionStats &stats = uvAcq.stats();
+        if (stats.missed != reportedMissed)
         {
-            buttonBPressed = false;
+            ESP_LOGW(TAG, "AS7331 missed %u conversions",
+                     (unsigned)(stats.missed - reportedMissed));
+            reportedMissed = stats.missed;
+        }
+        if (stats.rangeChanges != reportedRanges)
+        {
+            ESP_LOGD(TAG, "AS7331 range: gain code %u, time code %u",
+                     uvSensor.gainCode(), uvSensor.timeCode());
+            reportedRanges = stats.rangeChanges;
         }
 
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+#ifdef UV_READY_PIN
+        // Woken by the READY interrupt; the timeout covers a lost edge
+        ulTaskNotifyTake(pdTRUE, 2 * uvSensor.conversionPeriodUs() / 1000 / portTICK_PERIOD_MS + 1);
+#else
+        const uint32_t tickUs = portTICK_PERIOD_MS * 1000;
+        uint32_t waitUs = uvAcq.nextPollDelayUs((uint64_t)esp_timer_get_time());
+        if (waitUs >= tickUs)
+            vTaskDelay(waitUs / tickUs);
+        else if (waitUs > tickUs / 2)
+            vTaskDelay(1); // Wakes on the next tick, before the result is due
+        else if (waitUs > 0)
+            delayMicroseconds(waitUs); // Shorter than a tick
+#endif
     }
 }
 
-float calculateUVIndex(float uva, float uvb, float uvc)
+// Consumes every sample as soon as it is produced, independent of the frame
+// rate, and folds it into the shared state
+void processingTask(void *pvParameters)
 {
-    float k1 = 0.1;  // Váha pro UVA
-    float k2 = 0.7;  // Váha pro UVB (hlavní složka)
-    float k3 = 0.05; // Váha pro UVC (minimální vliv)
-
-    float uv_index = (k1 * uva) + (k2 * uvb) + (k3 * uvc);
-    return uv_index;
-}
+    uint32_t reportedDrops = 0;
 
-void drawUVScale(M5Canvas &canvas, float uvIndex)
-{
-    // Definice pozice a velikosti stupnice
-    const int x = 10;
-    const int y = 18;
-    const int width = 220;
-    const int height = 10;
+    for (;;)
+    {
+        // Wakes up without samples too, to send a packed block on time
+        ulTaskNotifyTake(pdTRUE, TELEMETRY_FLUSH_MS / portTICK_PERIOD_MS);
 
-    // Prahové hodnoty (vzhledem k citlivosti při Stargardtově chorobě)
-    const float safeThreshold = 2.0;    // Pod touto hodnotou je riziko minimální
-    const float cautionThreshold = 3.0; // Meziprodukt - doporučená ochrana
-    const float maxThreshold = 6.0;     // Maximální hodnota stupnice
+        UVSample sample;
+        while (uvSamples.pop(sample))
+        {
+            if (doseResetRequested.exchange(false))
+                dose.resetSession();
+            dose.addSample(sample.timestampUs,
+                           uvWeighted<UVProfile>(uvIrradiance(sample.uva, sample.uvb, sample.uvc)));
+            state.publishSample(sample, dose.totals());
 
-    // Nakreslíme obrys stupnice
-    canvas.drawRect(x, y, width, height, WHITE);
+            LogSample logged;
+            logged.timestampUs = wallClockOffsetUs + sample.timestampUs;
+            logged.uva = uvToFixed(sample.uva);
+            logged.uvb = uvToFixed(sample.uvb);
+            logged.uvc = uvToFixed(sample.uvc);
+            logged.tempCenti = (int16_t)(sample.temp * 100.0f);
+            logQueue.push(logged); // A full queue counts the sample as dropped
+            rollup.add(logged);
 
-    // Omezíme aktuální UV index pro výpočet vyplnění (aby nepřekročil maxThreshold)
-    float displayValue = (uvIndex > maxThreshold) ? maxThreshold : uvIndex;
+            if (telemetry.packed())
+                telemetry.sendPacked(logged);
+            else
+                telemetry.sendUV(sample);
+        }
+        telemetry.flushIfDue(wallClockOffsetUs + (uint64_t)esp_timer_get_time());
 
-    // Vypočítáme šířku vyplněné části stupnice
-    int fillWidth = (int)((displayValue / maxThreshold) * width);
+        uint32_t drops = uvSamples.dropped();
+        if (drops != reportedDrops)
+        {
+            ESP_LOGW(TAG, "UV sample ring dropped %u samples",
+                     (unsigned)(drops - reportedDrops));
+            reportedDrops = drops;
+        }
+    }
+}
 
-    // Vybereme barvu podle hodnoty UV indexu:
-    // - Pod safeThreshold = zelená (bez nutnosti ochrany)
-    // - Mezi safeThreshold a cautionThreshold = žlutá (varování)
-    // - Nad cautionThreshold = červená (vysoké riziko)
+void batteryTask(void *pvParameters)
+{
+    TickType_t lastWake = xTaskGetTickCount();
 
-    uint16_t fillColor;
-    if (uvIndex < safeThreshold)
-    {
-        fillColor = GREEN;
-    }
-    else if (uvIndex < cautionThreshold)
+    for (;;)
     {
-        fillColor = YELLOW;
+        battery.addSample(millis(), (uint16_t)StickCP2.Power.getBatteryVoltage()); // mV per M5Unified
+        telemetry.sendBattery(battery.snapshot());
+        vTaskDelayUntil(&lastWake, BATTERY_PERIOD_MS / portTICK_PERIOD_MS);
     }
-    else
+}
+
+void drawUVScale(RetainedCanvas &ui, const UVRating &rating)
+{
+    // Definice pozice a velikosti stupnice
+    const UiRect &bar = ui.widgetRect(widgets.scaleBar);
+    const int x = bar.x;
+    const int y = bar.y;
+    const int width = bar.w;
+    const int height = bar.h;
+
+    // Barva a text podle pásma z profilu (UVBand):
+    // - bezpečné = zelená (bez nutnosti ochrany)
+    // - varování = žlutá (doporučená ochrana)
+    // - vysoké riziko = červená
+    static const uint16_t bandColors[] = {UI_GREEN, UI_YELLOW, UI_RED};
+    static const char *const bandAdvice[] = {"Bez ochrany", "vezmi Bryle", "vezmi Bryle"};
+
+    // Šířka vyplněné části stupnice (pozice je už omezena na maximum)
+    int fillWidth = (int)((rating.scaleQ16 * (uint32_t)width) >> 16);
+    uint16_t fillColor = bandColors[rating.band];
+
+    // Stupnici překreslíme jen při změně šířky nebo barvy výplně
+    if (ui.beginWidget(widgets.scaleBar, ((uint32_t)fillColor << 16) | (uint32_t)fillWidth))
     {
-        fillColor = RED;
-    }
+        M5Canvas &canvas = *ui.canvas();
 
-    // Vyplníme část stupnice
-    canvas.fillRect(x + 1, y + 1, fillWidth - 2, height - 2, fillColor);
+        // Nakreslíme obrys stupnice
+        canvas.drawRect(x, y, width, height, UI_WHITE);
+
+        // Vyplníme část stupnice
+        if (fillWidth > 2)
+            canvas.fillRect(x + 1, y + 1, fillWidth - 2, height - 2, fillColor);
+    }
 
     // Vykreslíme text s aktuálním UV indexem
-    canvas.setTextSize(0.5);
-    canvas.setCursor(x + 100, y + height + 7);
-    canvas.printf("UV index: %.1f", uvIndex);
+    ui.printf(widgets.uvIndex, "UV index: %.1f", rating.centiIndex / 100.0f);
 
     // Přidáme textovou informaci o nutnosti ochrany
-    canvas.setCursor(x, y + height + 7);
-    if (uvIndex >= safeThreshold)
-    {
-        canvas.print("vezmi Bryle");
-    }
-    else
-    {
-        canvas.print("Bez ochrany");
-    }
+    ui.printf(widgets.advice, "%s", bandAdvice[rating.band]);
 }
 
 void loop()
 {
+    static uint8_t appliedBrightness = BRIGHTNESS_DEFAULT;
+    static bool shownChart = false;
+    static TickType_t lastColumn = xTaskGetTickCount();
+    TickType_t pollStart = xTaskGetTickCount();
+
     StickCP2.update(); // Update button states
 
+    if (uiStatsResetRequested.exchange(false))
+    {
+        ui.resetStats();
+        uvChart.resetStats();
+        governor.resetStats();
+    }
+
+    // One consistent copy of everything shown this frame
+    MeasurementSnapshot snap = state.snapshot();
+    const UVSample &latest = snap.current;
+
+    if (snap.brightness != appliedBrightness)
+    {
+        StickCP2.Display.setBrightness(snap.brightness);
+        appliedBrightness = snap.brightness;
+    }
+
+    if (chartView != shownChart)
+    {
+        shownChart = chartView;
+        ui.invalidateAll(); // The other view's widgets draw from scratch
+        governor.request();
+    }
+
     // if (StickCP2.BtnB.wasClicked())
     // {
     //     StickCP2.Display.clear();
@@ -253,10 +738,8 @@ void loop()
 
     // if (StickCP2.BtnA.wasPressed())
     // {
-    //     displayPaused = !displayPaused; // Toggle display update state
-    //     maxuva = 0;
-    //     maxuvb = 0;
-    //     maxuvc = 0;
+    //     state.togglePaused(); // Toggle display update state
+    //     state.resetMaxima();
     // }
 
     // if (StickCP2.BtnB.wasReleased())
@@ -268,77 +751,537 @@ void loop()
     //                                 StickCP2.Display.height() / 2);
     // }
 
-    if (!displayPaused)
+    if (snap.paused)
+    {
+        governor.request(); // Draw as soon as the display resumes
+    }
+    else
+    {
+        BatterySnapshot bat = battery.snapshot();
+        float uva = latest.uva;
+        float uvb = latest.uvb;
+        float uvc = latest.uvc;
+
+        UVRating rating = uvRate<UVProfile>(uvIrradiance(uva, uvb, uvc));
+
+        // The history runs in both views and also between frames
+        uvChart.add(rating.centiIndex / 100.0f);
+        if (pollStart - lastColumn >= CHART_COLUMN_MS / portTICK_PERIOD_MS)
+        {
+            uvChart.nextColumn();
+            lastColumn = pollStart; // No catching up after a pause
+            if (shownChart)
+                governor.request();
+        }
+
+        // Everything the frame shows, rounded the way it is printed
+        FrameKey key;
+        key.add(shownChart).add(bat.percent).add((bat.millivolts + 5) / 10);
+        key.add(rating.band).add(rating.scaleQ16 >> 8); // Finer than the bar's 240 px
+        key.add((rating.centiIndex + 5) / 10); // The bar clips at scaleMax, the text does not
+        if (!shownChart)
+        {
+            key.add(lroundf(uva)).add(lroundf(uvb)).add(lroundf(uvc)).add(lroundf(latest.temp * 10));
+            key.add(lroundf(snap.maxUva)).add(lroundf(snap.maxUvb)).add(lroundf(snap.maxUvc));
+            key.add(lroundf(snap.dose.dailyMj / 1000.0f));
+        }
+        if (governor.shouldDraw(key.value(), pollStart * portTICK_PERIOD_MS))
+            drawFrame(snap, bat, rating, shownChart);
+    }
+
+    vTaskDelayUntil(&pollStart, UI_POLL_MS / portTICK_PERIOD_MS);
+}
+
+// Prints the snapshot into the widgets and pushes what changed
+void drawFrame(const MeasurementSnapshot &snap, const BatterySnapshot &bat, const UVRating &rating,
+               bool shownChart)
+{
+    const UVSample &latest = snap.current;
+
+    ui.beginFrame();
+    ui.printf(widgets.batPct, "%d%%", bat.percent);
+    ui.printf(widgets.batVolt, "%.2f V", bat.millivolts / 1000.0f);
+    // ui.printf(widgets.batVolt, "%d mV/h", bat.rateMvPerHour); // uncomment to see discharge rate
+
+    // While telemetry streams, the port is binary and the log lines would
+    // corrupt frames; skip them, formatting included
+    bool logFrame = !telemetry.enabled();
+    if (logFrame)
+        ESP_LOGI(TAG, "uvIndex: %.2f", rating.centiIndex / 100.0f);
+
+    if (shownChart)
+    {
+        ui.printf(widgets.chartLabel, "UV index, 4 min, top %g", uvChart.scale());
+        uvChart.render();
+        const SparklineStats &chart = uvChart.stats();
+        if (logFrame)
+            ESP_LOGD(TAG, "chart %u us, avg scroll %u us, avg full %u us", (unsigned)chart.lastUs,
+                     (unsigned)(chart.scrollRenders ? chart.scrollUs / chart.scrollRenders : 0),
+                     (unsigned)(chart.fullRenders ? chart.fullUs / chart.fullRenders : 0));
+    }
+    else
+    {
+        ui.printf(widgets.uva, "UV-A: %.0f", latest.uva);
+        ui.printf(widgets.uvb, "UV-B: %.0f", latest.uvb);
+        ui.printf(widgets.uvc, "UV-C: %.0f", latest.uvc);
+        ui.printf(widgets.temp, "Temp: %.1f C", latest.temp);
+
+        ui.printf(widgets.maxLabel, "Max:");
+        ui.printf(widgets.maxUva, "%.0f", snap.maxUva);
+        ui.printf(widgets.maxUvb, "%.0f", snap.maxUvb);
+        ui.printf(widgets.maxUvc, "%.0f", snap.maxUvc);
+        ui.printf(widgets.dose, "%.2f SED", snap.dose.dailyMj / 100000.0f);
+    }
+
+    drawUVScale(ui, rating);
+
+    uint32_t pixels = ui.flush(&StickCP2.Display);
+    if (!logFrame)
+        return;
+    ESP_LOGD(TAG, "pushed %u px (%u px avg)", (unsigned)pixels,
+             (unsigned)(ui.totalPixelsPushed() / ui.framesFlushed()));
+    // With DMA, sync near 0 means the transfer overlapped the drawing
+    const FrameTimes &times = ui.frameTimes();
+    ESP_LOGD(TAG, "frame %u us: render %u us, transfer %u us, sync %u us (%s)",
+             (unsigned)times.frameUs, (unsigned)times.renderUs, (unsigned)times.transferUs,
+             (unsigned)times.syncUs, ui.doubleBuffered() ? "dma" : "blocking");
+    const GovernorStats &gov = governor.stats();
+    ESP_LOGD(TAG, "governor: %u polls, %u change frames, %u heartbeats, %u deferred",
+             (unsigned)gov.polls, (unsigned)gov.changeFrames, (unsigned)gov.heartbeatFrames,
+             (unsigned)gov.deferred);
+}
+
+// Moves queued samples into the flash log. Flash writes and erases stall
+// code running from flash on both cores, so they happen in batches here.
+void storageTask(void *pvParameters)
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    TickType_t lastFlush = lastWake;
+
+    for (;;)
+    {
+        vTaskDelayUntil(&lastWake, STORAGE_PERIOD_MS / portTICK_PERIOD_MS);
+        if (!logReady)
+            continue;
+
+        LogSample sample;
+        while (logQueue.pop(sample))
+            sampleLog.append(sample);
+
+        if (xTaskGetTickCount() - lastFlush >= LOG_FLUSH_MS / portTICK_PERIOD_MS)
+        {
+            sampleLog.flush();
+            lastFlush = xTaskGetTickCount();
+        }
+    }
+}
+
+// Serial commands; slow output (dumps) only blocks this task
+void commandTask(void *pvParameters)
+{
+    for (;;)
     {
+        commands.poll();
+        vTaskDelay(COMMAND_POLL_MS / portTICK_PERIOD_MS);
+    }
+}
 
-        canvas.fillScreen(BLACK);
-        canvas.setTextSize(0.5);
-        // canvas.fillRect(0, 0, 240, 135, BLACK);
-        int percentage = getStableBatteryPercentage();
-        canvas.setCursor(200, 10);
-        canvas.printf("%d%%\n", percentage);
-        canvas.setCursor(11, 10);
-        canvas.setTextSize(0.5);
-        int vbat_mV = StickCP2.Power.getBatteryVoltage(); // mV
-        canvas.printf("%.2f V\n", vbat_mV / 1000.0f);
-        // canvas.printf("%d mV\n", vbat_mV); // uncomment to see raw
+const char *burstStateName(BurstState state)
+{
+    switch (state)
+    {
+    case BURST_IDLE:
+        return "idle";
+    case BURST_ARMING:
+        return "arming";
+    case BURST_ARMED:
+        return "armed";
+    case BURST_RUNNING:
+        return "running";
+    case BURST_STOPPING:
+        return "stopping";
+    case BURST_DONE:
+        return "done";
+    case BURST_READING:
+        return "reading";
+    }
+    return "?";
+}
 
-        if (ksfTkErrOk != myUVSensor.readAllUV())
+void onBurstCommand(int argc, char *argv[], Print *out, void *context)
+{
+    const char *action = argc > 1 ? argv[1] : "status";
+
+    if (strcmp(action, "start") == 0)
+    {
+        uint32_t samples = argc > 2 ? strtoul(argv[2], NULL, 10) : burst.capacity();
+        if (burst.requestStart(samples))
+            out->printf("Burst armed, %u samples\n", (unsigned)samples);
+        else
+            out->println("Burst busy or buffer missing");
+    }
+    else if (strcmp(action, "stop") == 0)
+    {
+        out->println(burst.requestStop() ? "Burst stopping" : "No burst running");
+    }
+    else if (strcmp(action, "status") == 0)
+    {
+        const BurstInfo &info = burst.info();
+        out->printf("state %s, %u/%u records, %u us period, gain code %u, time code %u\n",
+                    burstStateName(burst.state()), (unsigned)info.count,
+                    (unsigned)burst.capacity(), (unsigned)info.periodUs,
+                    info.gainCode, info.timeCode);
+    }
+    else if (strcmp(action, "dump") == 0)
+    {
+        if (!burst.beginRead())
         {
-            Serial.println("Error reading UV.");
+            out->println("No finished burst to dump");
+            return;
         }
+        // Irradiance in uW/cm^2; seq gaps are missed conversions
+        const BurstInfo &info = burst.info();
+        out->printf("# start_us %llu, period_us %u, gain_code %u, time_code %u\n",
+                    (unsigned long long)info.startUs, (unsigned)info.periodUs,
+                    info.gainCode, info.timeCode);
+        out->println("time_us,seq,uva,uvb,uvc");
+        for (uint32_t i = 0; i < info.count; i++)
+        {
+            const BurstRecord &r = burst.at(i);
+            out->printf("%u,%u,%.3f,%.3f,%.3f\n", (unsigned)r.timeUs, r.seq,
+                        as7331Irradiance(r.uva, AS7331_FSR_UVA, info.gainCode, info.timeCode),
+                        as7331Irradiance(r.uvb, AS7331_FSR_UVB, info.gainCode, info.timeCode),
+                        as7331Irradiance(r.uvc, AS7331_FSR_UVC, info.gainCode, info.timeCode));
+        }
+        burst.endRead();
+    }
+    else
+    {
+        out->println("Usage: burst start [samples] | stop | status | dump");
+    }
+}
+
+void onDoseCommand(int argc, char *argv[], Print *out, void *context)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        doseResetRequested = true; // Applied with the next sample
+        out->println("Session dose reset");
+        return;
+    }
+
+    UVDoseTotals totals = state.snapshot().dose;
+    out->printf("irradiance %u uW/m2, session %u mJ/m2, today %u mJ/m2\n",
+                (unsigned)totals.irradiance, (unsigned)totals.sessionMj,
+                (unsigned)totals.dailyMj);
+    if (totals.secondsToLimit == UVDOSE_NO_LIMIT)
+        out->println("limit not approaching");
+    else
+        out->printf("limit in %u s\n", (unsigned)totals.secondsToLimit);
+}
+
+// Statistics since the last reset, in the display units (uW/cm^2)
+void onStatsCommand(int argc, char *argv[], Print *out, void *context)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        state.resetMaxima(); // Same as button A
+        out->println("Maxima and statistics reset");
+        return;
+    }
+
+    MeasurementSnapshot snap = state.snapshot();
+    const char *names[] = {"UVA", "UVB", "UVC"};
+    const ChannelStats *stats[] = {&snap.statsUva, &snap.statsUvb, &snap.statsUvc};
+    const float maxima[] = {snap.maxUva, snap.maxUvb, snap.maxUvc};
+    out->printf("%u samples\n", (unsigned)snap.statsUva.count);
+    for (int i = 0; i < 3; i++)
+        out->printf("%s mean %.3f sd %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n", names[i],
+                    stats[i]->mean, stats[i]->stddev, stats[i]->p50, stats[i]->p95,
+                    stats[i]->p99, maxima[i]);
+}
+
+void onTelemetryCommand(int argc, char *argv[], Print *out, void *context)
+{
+    const char *action = argc > 1 ? argv[1] : "stats";
+
+    if (strcmp(action, "on") == 0)
+    {
+        // From here on the port carries frames; decode with tools/telemetry_decode.py.
+        // Log output from any task would land between them, so it is muted.
+        Serial.setDebugOutput(false);
+        telemetry.setPacked(argc < 3 || strcmp(argv[2], "raw") != 0);
+        telemetry.setEnabled(true);
+    }
+    else if (strcmp(action, "off") == 0)
+    {
+        telemetry.setEnabled(false);
+        Serial.setDebugOutput(true);
+        out->println("Telemetry off");
+    }
+    else
+    {
+        TelemetryStats stats = telemetry.stats();
+        out->printf("telemetry %s%s, %u frames, %u dropped, %u bytes\n",
+                    telemetry.enabled() ? "on" : "off",
+                    telemetry.packed() ? " packed" : " raw", (unsigned)stats.frames,
+                    (unsigned)stats.dropped, (unsigned)stats.bytes);
+    }
+}
+
+// Parses a duration such as "90s", "15m", "2h" or "1d"
+bool parseLogDuration(const char *text, const char **end, uint64_t *us)
+{
+    char *unit;
+    unsigned long value = strtoul(text, &unit, 10);
+    if (unit == text)
+        return false;
+
+    uint64_t scale;
+    switch (*unit)
+    {
+    case 's': scale = 1000000ULL; break;
+    case 'm': scale = 60 * 1000000ULL; break;
+    case 'h': scale = 3600 * 1000000ULL; break;
+    case 'd': scale = 86400 * 1000000ULL; break;
+    default: return false;
+    }
+    *us = value * scale;
+    *end = unit + 1;
+    return true;
+}
 
-        float uva = myUVSensor.getUVA();
-        float uvb = myUVSensor.getUVB();
-        float uvc = myUVSensor.getUVC();
+// Parses a log time: "now", "-90m" before now, "@12:00" today or
+// "-1d@12:00" a day earlier. Times of day need the RTC to have been set.
+bool parseLogTime(const char *text, uint64_t nowUs, uint64_t *timeUs)
+{
+    uint64_t back = 0;
+    uint64_t base = nowUs;
+    if (strcmp(text, "now") == 0)
+    {
+        *timeUs = nowUs;
+        return true;
+    }
+    if (*text == '-' && !parseLogDuration(text + 1, &text, &back))
+        return false;
+    if (*text == '@')
+    {
+        unsigned hours, minutes;
+        char tail;
+        if (sscanf(text + 1, "%u:%u%c", &hours, &minutes, &tail) != 2 || hours > 23 || minutes > 59)
+            return false;
+        base = nowUs - nowUs % (86400 * 1000000ULL) + (hours * 3600ULL + minutes * 60ULL) * 1000000ULL;
+    }
+    else if (*text != '\0')
+    {
+        return false;
+    }
+    if (back > base)
+        return false;
+    *timeUs = base - back;
+    return true;
+}
 
-        float spektralni_faktor = 0.15;
-        float uv_index = (uvb * spektralni_faktor) / 25.0;
-        float uvi_total = ((uva + uvb) * spektralni_faktor) / 25.0;
+bool printLogSample(const LogSample &sample, void *context)
+{
+    ((Print *)context)->printf("%llu,%u,%u,%u,%d\n", (unsigned long long)sample.timestampUs,
+                               (unsigned)sample.uva, (unsigned)sample.uvb, (unsigned)sample.uvc,
+                               sample.tempCenti);
+    return true;
+}
 
-        if (uva > maxuva)
-            maxuva = uva;
-        if (uvb > maxuvb)
-            maxuvb = uvb;
-        if (uvc > maxuvc)
-            maxuvc = uvc;
+bool printLogBucket(uint64_t startUs, const SampleSummary &summary, void *context)
+{
+    Print *out = (Print *)context;
+    out->printf("%llu,%u", (unsigned long long)startUs, (unsigned)summary.count);
+    for (int i = 0; i < SAMPLESUMMARY_CHANNELS && summary.count > 0; i++)
+        out->printf(",%u,%u,%u", (unsigned)summary.min[i], (unsigned)summary.max[i],
+                    (unsigned)(summary.sum[i] / summary.count));
+    out->println();
+    return true;
+}
+
+// Prints samples, or min/max/mean buckets, of a time range; only the
+// sectors overlapping the range are read
+void printLogRange(int argc, char *argv[], Print *out)
+{
+    uint64_t nowUs = wallClockOffsetUs + (uint64_t)esp_timer_get_time();
+    uint64_t fromUs, toUs = nowUs, bucketUs = 0;
+    const char *end;
+    if (argc < 3 || !parseLogTime(argv[2], nowUs, &fromUs) ||
+        (argc > 3 && !parseLogTime(argv[3], nowUs, &toUs)) ||
+        (argc > 4 && (!parseLogDuration(argv[4], &end, &bucketUs) || *end != '\0' || bucketUs == 0)))
+    {
+        out->println("Usage: log range <from> [to] [bucket]");
+        out->println("  e.g. log range -1h");
+        out->println("       log range -1d@12:00 -1d@14:00 5m");
+        return;
+    }
+
+    // Irradiance in uW/m^2, temperature in centi-degrees C
+    SampleLogStats before = sampleLog.stats();
+    uint32_t rows;
+    if (bucketUs == 0)
+    {
+        out->println("time_us,uva,uvb,uvc,temp_centi_c");
+        rows = sampleLog.query(fromUs, toUs, printLogSample, out);
+    }
+    else
+    {
+        out->println("start_us,count,uva_min,uva_max,uva_mean,uvb_min,uvb_max,uvb_mean,uvc_min,uvc_max,uvc_mean");
+        rows = sampleLog.aggregate(fromUs, toUs, bucketUs, printLogBucket, out);
+    }
+    SampleLogStats after = sampleLog.stats();
+    out->printf("# %u rows, %u batches read, %u sectors from the index\n", (unsigned)rows,
+                (unsigned)(after.queryBatches - before.queryBatches),
+                (unsigned)(after.querySectors - before.querySectors));
+}
 
-        float uvIndex = calculateUVIndex(uva, uvb, uvc) / 25;
+void onLogCommand(int argc, char *argv[], Print *out, void *context)
+{
+    const char *action = argc > 1 ? argv[1] : "status";
 
-        ESP_LOGI(TAG, "uvIndex: %.2f", uvIndex);
+    if (!logReady)
+    {
+        out->println("Sample log unavailable");
+    }
+    else if (strcmp(action, "flush") == 0)
+    {
+        out->println(sampleLog.flush() ? "Log flushed" : "Log flush failed");
+    }
+    else if (strcmp(action, "format") == 0)
+    {
+        out->println(sampleLog.format() ? "Log erased" : "Log erase failed");
+    }
+    else if (strcmp(action, "range") == 0)
+    {
+        printLogRange(argc, argv, out);
+    }
+    else
+    {
+        SampleLogStats stats = sampleLog.stats();
+        out->printf("%u/%u sectors, %u samples, %u batches, %u erases, %u errors, %u torn\n",
+                    (unsigned)sampleLog.usedSectors(), (unsigned)sampleLog.sectorCount(),
+                    (unsigned)stats.samples, (unsigned)stats.batches, (unsigned)stats.erases,
+                    (unsigned)stats.errors, (unsigned)stats.tornBatches);
+        out->printf("%.2f flash bytes/sample, write amplification %.3f, %u queue drops\n",
+                    sampleLog.bytesPerSample(), sampleLog.writeAmplification(),
+                    (unsigned)logQueue.dropped());
+    }
+}
 
-        uint8_t y = 75;
-        uint8_t line = 16;
+// Prints the rollup history of one resolution, oldest slot first
+void onTrendCommand(int argc, char *argv[], Print *out, void *context)
+{
+    RollupLevel level = ROLLUP_MINUTES;
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "s") == 0)
+            level = ROLLUP_SECONDS;
+        else if (strcmp(argv[1], "h") == 0)
+            level = ROLLUP_HOURS;
+        else if (strcmp(argv[1], "m") != 0)
+        {
+            out->println("Usage: trend [s | m | h] [slots]");
+            return;
+        }
+    }
+    size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : UVRollup::slots(level);
 
-        // canvas.setTextSize(1);
-        // canvas.setCursor(10, 35);
-        // canvas.printf("UV-I: %.0f\n", uv_index);
-        // canvas.setCursor(100, 25);
-        // canvas.printf("UV-T: %.0f\n", uvi_total);
+    // Copied out first so printing does not hold the rollup lock; static
+    // to keep it off the command task stack
+    static SampleSummary slots[ROLLUP_MAX_SLOTS];
+    count = rollup.history(level, count, slots);
+    out->println("start_us,count,uva_min,uva_max,uva_mean,uvb_min,uvb_max,uvb_mean,uvc_min,uvc_max,uvc_mean");
+    for (size_t i = 0; i < count; i++)
+        printLogBucket(slots[i].startUs, slots[i], out);
+}
 
-        canvas.setTextSize(0.7);
-        canvas.setCursor(10, y);
-        canvas.printf("UV-A: %.0f\n", uva);
-        canvas.setCursor(10, y + line);
-        canvas.printf("UV-B: %.0f\n", uvb);
-        canvas.setCursor(10, y + 2 * line);
-        canvas.printf("UV-C: %.0f\n", uvc);
-        canvas.setCursor(10, y + 3 * line);
-        canvas.printf("Temp: %.1f C", myUVSensor.getTemp());
+// Per-device transaction counters and latency histograms of the UV bus,
+// then the time tasks waited for the bus at each priority
+void onI2cCommand(int argc, char *argv[], Print *out, void *context)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        uvBus.resetDeviceStats();
+        uvBus.resetBusStats();
+        out->println("I2C statistics reset");
+        return;
+    }
 
-        canvas.setCursor(140, y - line);
-        canvas.print("Max:");
-        canvas.setCursor(140, y);
-        canvas.printf("%.0f", maxuva);
-        canvas.setCursor(140, y + line);
-        canvas.printf("%.0f", maxuvb);
-        canvas.setCursor(140, y + 2 * line);
-        canvas.printf("%.0f", maxuvc);
+    out->println("hist: transactions taking 0, <2, <4 ... <16384, more us");
+    I2CDeviceStats dev;
+    for (uint8_t i = 0; uvBus.deviceStats(i, &dev); i++)
+    {
+        out->printf("0x%02x tx %u wr %u rd %u nack %u tmo %u err %u crc %u max %u us hist",
+                    dev.addr, (unsigned)dev.transactions, (unsigned)dev.bytesWritten,
+                    (unsigned)dev.bytesRead, (unsigned)dev.nacks, (unsigned)dev.timeouts,
+                    (unsigned)dev.errors, (unsigned)dev.crcErrors, (unsigned)dev.maxLatencyUs);
+        // Trailing empty buckets are left out
+        int last = I2C_LATENCY_BUCKETS - 1;
+        while (last > 0 && dev.latency[last] == 0)
+            last--;
+        for (int b = 0; b <= last; b++)
+            out->printf("%c%u", b == 0 ? ' ' : ',', (unsigned)dev.latency[b]);
+        out->println();
+    }
 
-        drawUVScale(canvas, uvIndex);
+    const char *priorities[] = {"low", "normal", "high"};
+    for (uint8_t p = 0; p < I2C_PRIORITY_LEVELS; p++)
+    {
+        I2CBusStats bus = uvBus.busStats(p);
+        if (bus.transactions == 0)
+            continue;
+        out->printf("wait %s: %u tx, %u waited, avg %u us, max %u us\n", priorities[p],
+                    (unsigned)bus.transactions, (unsigned)bus.contended,
+                    (unsigned)(bus.contended ? bus.waitUs / bus.contended : 0),
+                    (unsigned)bus.maxWaitUs);
+    }
+}
 
-        canvas.pushSprite(0, 0);
+// Display pipeline counters: pixels and times per frame, chart renders,
+// governor decisions and button latency. loop() updates them while this
+// runs, so the figures of one report can be a frame apart.
+void onUiCommand(int argc, char *argv[], Print *out, void *context)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        uiStatsResetRequested = true; // Applied with the next poll
+        buttons.resetLatency();
+        out->println("UI statistics reset");
+        return;
     }
 
-    delay(500);
-}
\ No newline at end of file
+    uint32_t frames = ui.framesFlushed();
+    out->printf("%u frames, %u px pushed (%u px avg, last %u px)\n", (unsigned)frames,
+                (unsigned)ui.totalPixelsPushed(),
+                (unsigned)(frames ? ui.totalPixelsPushed() / frames : 0),
+                (unsigned)ui.lastPixelsPushed());
+    // With DMA, sync near 0 means the transfer overlapped the drawing
+    FrameTimes times = ui.frameTimes();
+    out->printf("frame %u us: render %u us, transfer %u us, sync %u us (%s)\n",
+                (unsigned)times.frameUs, (unsigned)times.renderUs,
+                (unsigned)times.transferUs, (unsigned)times.syncUs,
+                ui.doubleBuffered() ? "dma" : "blocking");
+    if (frames)
+        out->printf("avg render %u us, transfer %u us, sync %u us\n",
+                    (unsigned)(times.renderTotalUs / frames),
+                    (unsigned)(times.transferTotalUs / frames),
+                    (unsigned)(times.syncTotalUs / frames));
+
+    SparklineStats chart = uvChart.stats();
+    out->printf("chart last %u us, %u scrolls avg %u us, %u full avg %u us\n",
+                (unsigned)chart.lastUs, (unsigned)chart.scrollRenders,
+                (unsigned)(chart.scrollRenders ? chart.scrollUs / chart.scrollRenders : 0),
+                (unsigned)chart.fullRenders,
+                (unsigned)(chart.fullRenders ? chart.fullUs / chart.fullRenders : 0));
+
+    GovernorStats gov = governor.stats();
+    out->printf("governor: %u polls, %u change frames, %u heartbeats, %u deferred\n",
+                (unsigned)gov.polls, (unsigned)gov.changeFrames,
+                (unsigned)gov.heartbeatFrames, (unsigned)gov.deferred);
+
+    out->printf("buttons: %u events, latency last %u us, max %u us, %u overflows\n",
+                (unsigned)buttons.eventCount(), (unsigned)buttons.lastLatencyUs(),
+                (unsigned)buttons.maxLatencyUs(), (unsigned)buttons.queueOverflows());
+}
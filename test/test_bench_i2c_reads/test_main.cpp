@@ -0,0 +1,189 @@
+// Bus transactions and bytes per logical register read: I2C_Class with a
+// repeated START against the former register write, STOP, read sequence,
+// both on SimulatedI2CBus at 400 kHz. Also checks the data read and the
+// host cost of a call through I2C_Class.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include <unity.h>
+
+#include "I2C_Class.h"
+#include "SimulatedI2CBus.h"
+
+#define DEVICE_ADDR 0x50
+#define CMD_ADDR    0x62  // 16-bit commands, like the SCD4x
+// The former path read through the Wire buffer in one go
+#define OLD_MAX_READ I2C_BUFFER_LENGTH
+
+static SimulatedI2CBus* sim;
+static I2C_Class* bus;
+
+void setUp(void) {
+    SimulatedI2CBus::resetClock();
+    sim = new SimulatedI2CBus();
+    sim->addDevice(DEVICE_ADDR);
+    sim->addDevice(CMD_ADDR, 2);
+    for (int i = 0; i < 256; i++) {
+        sim->registers(DEVICE_ADDR)[i] = (uint8_t)(i * 7 + 1);
+        sim->registers(CMD_ADDR)[i]    = (uint8_t)(i * 3 + 5);
+    }
+    bus = new I2C_Class();
+    bus->begin(sim, SimulatedI2CBus::clockUs);
+}
+
+void tearDown(void) {
+    delete bus;
+    delete sim;
+}
+
+typedef struct {
+    bool ok;
+    uint32_t transactions;
+    uint32_t bytes;
+    double busUs;
+} ReadCost;
+
+static ReadCost costSince(bool ok) {
+    SimulatedI2CStats stats = sim->stats();
+    ReadCost cost = {ok, stats.transactions, stats.bytes, stats.busNs / 1e3};
+    sim->resetStats();
+    return cost;
+}
+
+// The sequence register reads used before: the register address in a
+// transaction of its own, then the data in a second one
+static ReadCost oldRead(uint8_t addr, uint16_t reg, uint8_t regBytes,
+                        uint8_t* buffer, size_t length) {
+    sim->resetStats();
+    if (length > OLD_MAX_READ) return costSince(false);
+    uint8_t header[2] = {(uint8_t)(reg >> 8), (uint8_t)reg};
+    bool ok = sim->write(addr, header + 2 - regBytes, regBytes, true) ==
+              I2C_BUS_OK;
+    ok = ok && sim->read(addr, buffer, length) == length;
+    return costSince(ok);
+}
+
+static void checkData(uint8_t addr, uint16_t reg, const uint8_t* buffer,
+                      size_t length) {
+    const uint8_t* registers = sim->registers(addr);
+    for (size_t i = 0; i < length; i++) {
+        TEST_ASSERT_EQUAL_HEX8(registers[(uint8_t)(reg + i)], buffer[i]);
+    }
+}
+
+static void printRow(const char* name, const ReadCost& before,
+                     const ReadCost& after) {
+    char old[48];
+    if (before.ok) {
+        snprintf(old, sizeof(old), "%u tr, %3u B, %6.1f us",
+                 (unsigned)before.transactions, (unsigned)before.bytes,
+                 before.busUs);
+    } else {
+        snprintf(old, sizeof(old), "failed");
+    }
+    printf("%-16s before %-26s after %u tr, %3u B, %6.1f us\n", name, old,
+           (unsigned)after.transactions, (unsigned)after.bytes,
+           after.busUs);
+}
+
+static void test_register_reads(void) {
+    uint8_t buffer[300];
+    uint8_t reference[300];
+    ReadCost before, after;
+
+    sim->resetStats();
+    bus->readByte(DEVICE_ADDR, 0x10);
+    after  = costSince(true);
+    before = oldRead(DEVICE_ADDR, 0x10, 1, reference, 1);
+    printRow("readByte", before, after);
+    TEST_ASSERT_EQUAL_UINT32(1, after.transactions);
+    TEST_ASSERT_EQUAL_UINT32(2, before.transactions);
+    TEST_ASSERT_EQUAL_UINT32(before.bytes, after.bytes);
+    TEST_ASSERT_TRUE(after.busUs < before.busUs);
+
+    uint16_t value;
+    TEST_ASSERT_TRUE(bus->readU16(DEVICE_ADDR, 0x20, &value));
+    after  = costSince(true);
+    before = oldRead(DEVICE_ADDR, 0x20, 1, reference, 2);
+    printRow("readU16", before, after);
+    TEST_ASSERT_EQUAL_HEX16((reference[0] << 8) | reference[1], value);
+    TEST_ASSERT_EQUAL_UINT32(1, after.transactions);
+
+    const size_t lengths[] = {8, 200, 300};
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        size_t length = lengths[i];
+        memset(buffer, 0, sizeof(buffer));
+        TEST_ASSERT_TRUE(bus->readBytes(DEVICE_ADDR, 0x00, buffer, length));
+        after = costSince(true);
+        checkData(DEVICE_ADDR, 0x00, buffer, length);
+        before = oldRead(DEVICE_ADDR, 0x00, 1, reference, length);
+        char name[24];
+        snprintf(name, sizeof(name), "readBytes %u", (unsigned)length);
+        printRow(name, before, after);
+
+        // One transaction per chunk, each with a register byte
+        uint32_t chunks =
+            (uint32_t)((length + I2C_CLASS_CHUNK - 1) / I2C_CLASS_CHUNK);
+        TEST_ASSERT_EQUAL_UINT32(chunks, after.transactions);
+        TEST_ASSERT_EQUAL_UINT32(3 * chunks + length, after.bytes);
+        TEST_ASSERT_EQUAL(length <= OLD_MAX_READ, before.ok);
+    }
+
+    // A 16-bit command and 9 bytes back, like an SCD4x measurement
+    TEST_ASSERT_TRUE(bus->readBytes16(CMD_ADDR, 0xEC05, buffer, 9));
+    after = costSince(true);
+    checkData(CMD_ADDR, 0x05, buffer, 9);
+    before = oldRead(CMD_ADDR, 0xEC05, 2, reference, 9);
+    printRow("readBytes16 9", before, after);
+    TEST_ASSERT_EQUAL_UINT32(1, after.transactions);
+    TEST_ASSERT_EQUAL_UINT32(4 + 9, after.bytes);
+    TEST_ASSERT_EQUAL_UINT32(0, sim->stats().interleaved);
+}
+
+// Host time of a readByte through I2C_Class (lock, statistics, chunking)
+// against the two bus calls alone; the simulated bus costs the same in both
+static void test_call_overhead(void) {
+    const int calls = 200000;
+    uint8_t value   = 0;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        uint8_t reg = (uint8_t)i;
+        sim->write(DEVICE_ADDR, &reg, 1, false);
+        sim->read(DEVICE_ADDR, &value, 1);
+    }
+    double rawNs = std::chrono::duration<double, std::nano>(
+                       std::chrono::steady_clock::now() - start)
+                       .count() /
+                   calls;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        TEST_ASSERT_TRUE(bus->readByte(DEVICE_ADDR, (uint8_t)i, &value));
+    }
+    double classNs = std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - start)
+                         .count() /
+                     calls;
+    printf("readByte on the host: bus calls %.0f ns, through I2C_Class "
+           "%.0f ns\n",
+           rawNs, classNs);
+
+    I2CDeviceStats stats;
+    TEST_ASSERT_TRUE(bus->deviceStats(0, &stats));
+    TEST_ASSERT_EQUAL_UINT32(calls, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(calls, stats.bytesWritten);
+    TEST_ASSERT_EQUAL_UINT32(calls, stats.bytesRead);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_register_reads);
+    RUN_TEST(test_call_overhead);
+    return UNITY_END();
+}
@@ -0,0 +1,214 @@
+// SampleEncoder on the sun and indoor traces in test/data: exact round
+// trip, bytes per sample for flash batches and telemetry blocks, and the
+// encode cost per sample.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include <unity.h>
+
+#include "SampleCodec.h"
+
+#define FLASH_BLOCK      32  // SAMPLELOG_BATCH_SAMPLES
+#define TELEMETRY_BLOCK  16  // TELEMETRY_BLOCK_SAMPLES
+#define RAW_SAMPLE_BYTES 22  // Timestamp, three channels, temperature
+
+static std::vector<LogSample> sunTrace;
+static std::vector<LogSample> indoorTrace;
+
+// Reads a *_uv_packed.csv as written by tools/telemetry_decode.py. Tried
+// next to this file first, then relative to the project directory.
+static bool loadTrace(const char* name, std::vector<LogSample>* trace) {
+    char path[512];
+    const char* file = __FILE__;
+    const char* dir  = strstr(file, "test_bench_sample_codec");
+    snprintf(path, sizeof(path), "%.*sdata/%s",
+             dir ? (int)(dir - file) : 0, file, name);
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        snprintf(path, sizeof(path), "test/data/%s", name);
+        in = fopen(path, "r");
+    }
+    if (in == NULL) return false;
+
+    char line[160];
+    if (fgets(line, sizeof(line), in) == NULL) {  // Column names
+        fclose(in);
+        return false;
+    }
+    unsigned frame;
+    unsigned long long timestampUs;
+    unsigned long uva, uvb, uvc;
+    int temp;
+    while (fscanf(in, "%u,%llu,%lu,%lu,%lu,%d", &frame, &timestampUs, &uva,
+                  &uvb, &uvc, &temp) == 6) {
+        LogSample sample;
+        sample.timestampUs = timestampUs;
+        sample.uva         = (uint32_t)uva;
+        sample.uvb         = (uint32_t)uvb;
+        sample.uvc         = (uint32_t)uvc;
+        sample.tempCenti   = (int16_t)temp;
+        trace->push_back(sample);
+    }
+    fclose(in);
+    return !trace->empty();
+}
+
+static bool sameSample(const LogSample& a, const LogSample& b) {
+    return a.timestampUs == b.timestampUs && a.uva == b.uva &&
+           a.uvb == b.uvb && a.uvc == b.uvc && a.tempCenti == b.tempCenti;
+}
+
+// Encodes the trace in blocks of blockSamples, decodes every block on its
+// own and compares; returns the encoded bytes
+static size_t roundTrip(const std::vector<LogSample>& trace,
+                        size_t blockSamples) {
+    std::vector<uint8_t> block(blockSamples * SAMPLECODEC_MAX_SAMPLE);
+    size_t total = 0;
+    for (size_t start = 0; start < trace.size(); start += blockSamples) {
+        size_t count = trace.size() - start;
+        if (count > blockSamples) count = blockSamples;
+
+        SampleEncoder encoder;
+        size_t length = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t bytes = encoder.encode(trace[start + i], &block[length]);
+            TEST_ASSERT_LESS_OR_EQUAL(SAMPLECODEC_MAX_SAMPLE, bytes);
+            length += bytes;
+        }
+
+        SampleDecoder decoder;
+        size_t offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            LogSample decoded;
+            size_t used =
+                decoder.decode(&block[offset], length - offset, &decoded);
+            TEST_ASSERT_TRUE(used > 0);
+            TEST_ASSERT_TRUE(sameSample(trace[start + i], decoded));
+            offset += used;
+        }
+        TEST_ASSERT_EQUAL_size_t(length, offset);
+        total += length;
+    }
+    return total;
+}
+
+// Encode cost per sample, best of five passes over the trace
+static void encodeCost(const std::vector<LogSample>& trace, double* ns,
+                       double* cycles) {
+    std::vector<uint8_t> out(FLASH_BLOCK * SAMPLECODEC_MAX_SAMPLE);
+    *ns     = 1e9;
+    *cycles = 1e9;
+    for (int pass = 0; pass < 5; pass++) {
+        SampleEncoder encoder;
+        size_t length = 0;
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+#ifdef HAVE_TSC
+        uint64_t startTsc = __rdtsc();
+#endif
+        for (size_t i = 0; i < trace.size(); i++) {
+            if (i % FLASH_BLOCK == 0) {
+                encoder.reset();
+                length = 0;
+            }
+            length += encoder.encode(trace[i], &out[length]);
+        }
+#ifdef HAVE_TSC
+        double passCycles = (double)(__rdtsc() - startTsc) / trace.size();
+        if (passCycles < *cycles) *cycles = passCycles;
+#endif
+        double passNs = std::chrono::duration<double, std::nano>(
+                            std::chrono::steady_clock::now() - start)
+                            .count() /
+                        trace.size();
+        if (passNs < *ns) *ns = passNs;
+        TEST_ASSERT_TRUE(length > 0);
+    }
+}
+
+static void report(const char* name, const std::vector<LogSample>& trace,
+                   double maxFlashBytes) {
+    double flash     = (double)roundTrip(trace, FLASH_BLOCK) / trace.size();
+    double telemetry = (double)roundTrip(trace, TELEMETRY_BLOCK) / trace.size();
+    double ns, cycles;
+    encodeCost(trace, &ns, &cycles);
+#ifdef HAVE_TSC
+    printf("%-6s %zu samples: %.2f B/sample in %d-sample batches, %.2f in "
+           "%d-sample frames (raw %d), encode %.1f ns = %.0f TSC cycles\n",
+           name, trace.size(), flash, FLASH_BLOCK, telemetry,
+           TELEMETRY_BLOCK, RAW_SAMPLE_BYTES, ns, cycles);
+#else
+    printf("%-6s %zu samples: %.2f B/sample in %d-sample batches, %.2f in "
+           "%d-sample frames (raw %d), encode %.1f ns\n",
+           name, trace.size(), flash, FLASH_BLOCK, telemetry,
+           TELEMETRY_BLOCK, RAW_SAMPLE_BYTES, ns);
+#endif
+    TEST_ASSERT_TRUE(flash <= maxFlashBytes);
+    TEST_ASSERT_TRUE(telemetry >= flash);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static void test_sun_trace(void) {
+    TEST_ASSERT_TRUE_MESSAGE(loadTrace("sun_uv_packed.csv", &sunTrace),
+                             "test/data/sun_uv_packed.csv not found");
+    report("sun", sunTrace, RAW_SAMPLE_BYTES / 2);
+}
+
+static void test_indoor_trace(void) {
+    TEST_ASSERT_TRUE_MESSAGE(
+        loadTrace("indoor_uv_packed.csv", &indoorTrace),
+        "test/data/indoor_uv_packed.csv not found");
+    report("indoor", indoorTrace, RAW_SAMPLE_BYTES / 2);
+}
+
+static void test_worst_case_fits(void) {
+    // Largest jumps in every field, both directions
+    LogSample low  = {0, 0, 0, 0, -32768};
+    LogSample high = {~0ULL, 0xFFFFFFFFUL, 0xFFFFFFFFUL, 0xFFFFFFFFUL, 32767};
+    const LogSample* order[] = {&high, &low, &high, &low};
+    SampleEncoder encoder;
+    SampleDecoder decoder;
+    uint8_t out[SAMPLECODEC_MAX_SAMPLE];
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        size_t length = encoder.encode(*order[i], out);
+        TEST_ASSERT_LESS_OR_EQUAL(SAMPLECODEC_MAX_SAMPLE, length);
+        LogSample decoded;
+        TEST_ASSERT_EQUAL_size_t(length, decoder.decode(out, length, &decoded));
+        TEST_ASSERT_TRUE(sameSample(*order[i], decoded));
+    }
+}
+
+static void test_truncated_block_is_rejected(void) {
+    SampleEncoder encoder;
+    uint8_t out[SAMPLECODEC_MAX_SAMPLE];
+    LogSample sample = {1760000000000000ULL, 51790840, 1697080, 660, 3121};
+    size_t length    = encoder.encode(sample, out);
+    SampleDecoder decoder;
+    LogSample decoded;
+    TEST_ASSERT_EQUAL_size_t(0, decoder.decode(out, length - 1, &decoded));
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_sun_trace);
+    RUN_TEST(test_indoor_trace);
+    RUN_TEST(test_worst_case_fits);
+    RUN_TEST(test_truncated_block_is_rejected);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+// Fixed-point UV rating against the float path it replaced.
+//
+// floatRating() is the former calculateUVIndex() / 25 and drawUVScale()
+// logic, kept here as the reference. The test checks that both agree on
+// the band and the scale fill away from rounding boundaries and prints the
+// time per sample of each path.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include <unity.h>
+
+#include "UVWeighting.h"
+
+#define SAMPLES     (1 << 20)
+#define SCALE_WIDTH 220  // Scale bar width in pixels
+
+typedef struct {
+    int fill;  // Filled pixels of the scale bar
+    int band;  // 0 green, 1 yellow, 2 red
+} ScaleState;
+
+static float inputs[3 * SAMPLES];
+static UVIrradiance fixedInputs[SAMPLES];
+static volatile int sink;
+
+__attribute__((noinline)) static ScaleState floatRating(float uva, float uvb,
+                                                         float uvc) {
+    const float safeThreshold    = 2.0;
+    const float cautionThreshold = 3.0;
+    const float maxThreshold     = 6.0;
+
+    float uvIndex      = (0.1f * uva + 0.7f * uvb + 0.05f * uvc) / 25;
+    float displayValue = (uvIndex > maxThreshold) ? maxThreshold : uvIndex;
+
+    ScaleState state;
+    state.fill = (int)((displayValue / maxThreshold) * SCALE_WIDTH);
+    if (uvIndex < safeThreshold) {
+        state.band = 0;
+    } else if (uvIndex < cautionThreshold) {
+        state.band = 1;
+    } else {
+        state.band = 2;
+    }
+    return state;
+}
+
+static ScaleState fromRating(const UVRating& rating) {
+    ScaleState state;
+    state.fill = (int)((rating.scaleQ16 * (uint32_t)SCALE_WIDTH) >> 16);
+    state.band = rating.band;
+    return state;
+}
+
+// Sensor floats in, as the display loop does it
+__attribute__((noinline)) static ScaleState fixedRating(float uva, float uvb,
+                                                         float uvc) {
+    return fromRating(uvRate<StargardtProfile>(uvIrradiance(uva, uvb, uvc)));
+}
+
+// Irradiance already in fixed point, as the dose integrator sees it
+__attribute__((noinline)) static ScaleState fixedKernel(
+    const UVIrradiance& in) {
+    return fromRating(uvRate<StargardtProfile>(in));
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static void fillInputs(void) {
+    // 0..200 uW/cm^2 per channel puts the index across the whole scale
+    srand(1);
+    for (int i = 0; i < 3 * SAMPLES; i++) {
+        inputs[i] = (float)(rand() % 20000) / 100.0f;
+    }
+    for (int i = 0; i < SAMPLES; i++) {
+        fixedInputs[i] =
+            uvIrradiance(inputs[3 * i], inputs[3 * i + 1], inputs[3 * i + 2]);
+    }
+}
+
+static void test_fixed_matches_float(void) {
+    int differing = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        const float* in  = &inputs[3 * i];
+        ScaleState ref   = floatRating(in[0], in[1], in[2]);
+        ScaleState fixed = fixedRating(in[0], in[1], in[2]);
+        if (ref.band == fixed.band && abs(ref.fill - fixed.fill) <= 1) {
+            continue;
+        }
+        differing++;
+        // Only at a threshold: the float index is within rounding of it
+        float index = (0.1f * in[0] + 0.7f * in[1] + 0.05f * in[2]) / 25;
+        float nearest =
+            index < 2.5f ? 2.0f : (index < 4.5f ? 3.0f : 6.0f);
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, nearest, index);
+    }
+    printf("%d of %d samples differ, all at a threshold\n", differing,
+           SAMPLES);
+    TEST_ASSERT_LESS_OR_EQUAL(SAMPLES / 10000, differing);
+}
+
+template <typename Fn>
+static double nsPerSample(Fn fn) {
+    double best = 1e9;
+    for (int rep = 0; rep < 5; rep++) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        int sum = 0;
+        for (int i = 0; i < SAMPLES; i++) {
+            ScaleState state = fn(i);
+            sum += state.fill + state.band;
+        }
+        sink = sum;
+        double ns = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start)
+                        .count() /
+                    SAMPLES;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+static ScaleState runFloat(int i) {
+    return floatRating(inputs[3 * i], inputs[3 * i + 1], inputs[3 * i + 2]);
+}
+
+static ScaleState runFixed(int i) {
+    return fixedRating(inputs[3 * i], inputs[3 * i + 1], inputs[3 * i + 2]);
+}
+
+static ScaleState runKernel(int i) {
+    return fixedKernel(fixedInputs[i]);
+}
+
+static void test_benchmark(void) {
+    double floatNs  = nsPerSample(runFloat);
+    double fixedNs  = nsPerSample(runFixed);
+    double kernelNs = nsPerSample(runKernel);
+    printf("float path         %6.2f ns/sample\n", floatNs);
+    printf("fixed with convert %6.2f ns/sample\n", fixedNs);
+    printf("fixed kernel       %6.2f ns/sample\n", kernelNs);
+    TEST_ASSERT_TRUE(kernelNs > 0.0);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    fillInputs();
+    UNITY_BEGIN();
+    RUN_TEST(test_fixed_matches_float);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
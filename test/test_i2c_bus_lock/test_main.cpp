@@ -0,0 +1,168 @@
+// I2CBusLock and I2C_Class under contention: the highest bus priority
+// waiter gets the bus first, and a UV reader at high priority keeps its
+// latency while three tasks hammer the bus at low priority. Threads and a
+// real-time SimulatedI2CBus at 400 kHz; host threads have no priority
+// inheritance, so this measures the arbitration alone.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <unity.h>
+
+#include "I2CBusLock.h"
+#include "I2C_Class.h"
+#include "SimulatedI2CBus.h"
+
+#define UV_ADDR  0x74
+#define CO2_ADDR 0x62
+
+static uint64_t fakeUs;
+
+static uint64_t fakeClock(void) {
+    return fakeUs;
+}
+
+void setUp(void) {
+    fakeUs = 0;
+}
+
+void tearDown(void) {
+}
+
+static void waitForAcquire(I2CBusLock& lock, uint8_t priority) {
+    // transactions is counted under the lock together with the waiter
+    while (lock.stats(priority).transactions == 0) {
+        std::this_thread::yield();
+    }
+}
+
+static void test_highest_priority_first(void) {
+    I2CBusLock lock;
+    lock.setClock(fakeClock);
+    std::atomic<int> turn(0);
+    int lowTurn  = -1;
+    int highTurn = -1;
+
+    lock.acquire(I2C_PRIORITY_NORMAL);
+    std::thread low([&] {
+        I2CBusGuard guard(lock, I2C_PRIORITY_LOW);
+        lowTurn = turn++;
+    });
+    waitForAcquire(lock, I2C_PRIORITY_LOW);
+    std::thread high([&] {
+        I2CBusGuard guard(lock, I2C_PRIORITY_HIGH);
+        highTurn = turn++;
+    });
+    waitForAcquire(lock, I2C_PRIORITY_HIGH);
+    fakeUs = 250;
+    lock.release();
+    low.join();
+    high.join();
+
+    TEST_ASSERT_EQUAL_INT(0, highTurn);
+    TEST_ASSERT_EQUAL_INT(1, lowTurn);
+    I2CBusStats highStats = lock.stats(I2C_PRIORITY_HIGH);
+    I2CBusStats lowStats  = lock.stats(I2C_PRIORITY_LOW);
+    TEST_ASSERT_EQUAL_UINT32(1, highStats.contended);
+    TEST_ASSERT_EQUAL_UINT32(1, lowStats.contended);
+    TEST_ASSERT_EQUAL_UINT32(250, highStats.maxWaitUs);
+    TEST_ASSERT_EQUAL_UINT32(250, lowStats.maxWaitUs);
+    TEST_ASSERT_EQUAL_UINT32(1, lock.stats(I2C_PRIORITY_NORMAL).transactions);
+    TEST_ASSERT_EQUAL_UINT32(0, lock.stats(I2C_PRIORITY_NORMAL).contended);
+}
+
+typedef struct {
+    size_t reads;
+    double avgUs;
+    uint32_t p99Us;
+    uint32_t maxUs;
+} Latency;
+
+// Three tasks read 9 B from the CO2 address back to back, a UV task reads
+// 10 B every 2 ms; returns the UV read latency, wait for the bus included
+static Latency contention(bool uvHigh, uint32_t seconds) {
+    SimulatedI2CBus sim;
+    sim.addDevice(UV_ADDR);
+    sim.addDevice(CO2_ADDR, 2);
+    sim.setRealTime(true);
+    I2C_Class bus;
+    bus.begin(&sim);
+    if (uvHigh) bus.setPriority(UV_ADDR, I2C_PRIORITY_HIGH);
+    bus.setPriority(CO2_ADDR,
+                    uvHigh ? I2C_PRIORITY_LOW : I2C_PRIORITY_NORMAL);
+
+    std::atomic<bool> running(true);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; i++) {
+        threads.push_back(std::thread([&] {
+            uint8_t buffer[9];
+            while (running) bus.readBytes16(CO2_ADDR, 0xEC05, buffer, 9);
+        }));
+    }
+    std::vector<uint32_t> uv;
+    threads.push_back(std::thread([&] {
+        uint8_t buffer[10];
+        uint64_t next = i2cClockUs();
+        while (running) {
+            next += 2000;
+            uint64_t now = i2cClockUs();
+            if (next > now) {
+                std::this_thread::sleep_for(
+                    std::chrono::microseconds(next - now));
+            }
+            uint64_t start = i2cClockUs();
+            bus.readBytes(UV_ADDR, 0x02, buffer, sizeof(buffer));
+            uv.push_back((uint32_t)(i2cClockUs() - start));
+        }
+    }));
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+
+    std::sort(uv.begin(), uv.end());
+    double sum = 0;
+    for (size_t i = 0; i < uv.size(); i++) sum += uv[i];
+    Latency latency = {uv.size(), sum / uv.size(), uv[uv.size() * 99 / 100],
+                       uv.back()};
+    printf("%s: UV read %u x, avg %.0f us, p99 %u us, max %u us\n",
+           uvHigh ? "UV high, CO2 low" : "all same priority",
+           (unsigned)latency.reads, latency.avgUs, (unsigned)latency.p99Us,
+           (unsigned)latency.maxUs);
+    for (int p = 0; p < I2C_PRIORITY_LEVELS; p++) {
+        I2CBusStats stats = bus.busStats(p);
+        if (stats.transactions == 0) continue;
+        printf("  priority %d: %u transactions, %u waited, avg wait %.0f us, "
+               "max %u us\n",
+               p, (unsigned)stats.transactions, (unsigned)stats.contended,
+               stats.contended ? (double)stats.waitUs / stats.contended : 0.0,
+               (unsigned)stats.maxWaitUs);
+    }
+
+    SimulatedI2CStats simStats = sim.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, simStats.overlaps);
+    TEST_ASSERT_EQUAL_UINT32(0, simStats.interleaved);
+    TEST_ASSERT_TRUE(latency.reads > 0);
+    return latency;
+}
+
+static void test_uv_latency_under_contention(void) {
+    Latency same = contention(false, 1);
+    Latency high = contention(true, 1);
+    // A high priority reader waits for at most the transaction in progress
+    TEST_ASSERT_TRUE(high.avgUs < same.avgUs);
+    TEST_ASSERT_TRUE(high.p99Us < same.p99Us);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_highest_priority_first);
+    RUN_TEST(test_uv_latency_under_contention);
+    return UNITY_END();
+}
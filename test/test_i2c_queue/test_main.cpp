@@ -0,0 +1,338 @@
+// I2CQueue on I2C_Class over SimulatedI2CBus: requests finish in order
+// with their callbacks, a full queue rejects, failures are reported, and
+// tasks share the bus through the queue and directly. Also measures the
+// queue under a sensor load on simulated time.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <unity.h>
+
+#include "I2CQueue.h"
+#include "I2C_Class.h"
+#include "SimulatedI2CBus.h"
+
+#define UV_ADDR  0x74  // AS7331, 10 result bytes
+#define RH_ADDR  0x44  // SHT4x, 6 bytes without a register
+#define LOG_ADDR 0x50  // EEPROM-like, 200 byte blocks
+
+static SimulatedI2CBus* sim;
+static I2C_Class* bus;
+static I2CQueue* queue;
+
+void setUp(void) {
+    SimulatedI2CBus::resetClock();
+    sim = new SimulatedI2CBus();
+    sim->addDevice(UV_ADDR);
+    sim->addDevice(RH_ADDR);
+    sim->addDevice(LOG_ADDR);
+    bus = new I2C_Class();
+    bus->begin(sim, SimulatedI2CBus::clockUs);
+    queue = new I2CQueue();
+    TEST_ASSERT_TRUE(queue->begin(bus, false));
+}
+
+void tearDown(void) {
+    delete queue;
+    delete bus;
+    delete sim;
+}
+
+static void setRequest(I2CRequest* request, uint8_t op, uint8_t addr,
+                       uint8_t reg, uint8_t* buffer, size_t length) {
+    request->op       = op;
+    request->addr     = addr;
+    request->regBytes = 1;
+    request->reg      = reg;
+    request->buffer   = buffer;
+    request->length   = length;
+}
+
+static int order[8];
+static int orderCount;
+
+static void remember(I2CRequest* request, bool ok, void* context) {
+    // Runs before the request counts as finished
+    TEST_ASSERT_FALSE(request->finished());
+    if (ok) order[orderCount++] = *(int*)context;
+}
+
+static void test_requests_finish_in_order(void) {
+    uint8_t written[4] = {0x11, 0x22, 0x33, 0x44};
+    uint8_t readBack[4];
+    uint8_t plain[2];
+    int ids[3] = {0, 1, 2};
+    sim->registers(UV_ADDR)[0x0a] = 0x55;
+    sim->registers(UV_ADDR)[0x0b] = 0x66;
+
+    I2CRequest requests[3];
+    setRequest(&requests[0], I2C_WRITE, UV_ADDR, 0x06, written, 4);
+    setRequest(&requests[1], I2C_WRITE_READ, UV_ADDR, 0x06, readBack, 4);
+    setRequest(&requests[2], I2C_READ, UV_ADDR, 0, plain, 2);
+    orderCount = 0;
+    for (int i = 0; i < 3; i++) {
+        requests[i].callback = remember;
+        requests[i].context  = &ids[i];
+        TEST_ASSERT_TRUE(queue->submit(&requests[i]));
+        TEST_ASSERT_FALSE(requests[i].finished());
+    }
+    TEST_ASSERT_EQUAL_size_t(3, queue->depth());
+
+    for (int i = 0; i < 3; i++) TEST_ASSERT_TRUE(queue->process(0));
+    TEST_ASSERT_FALSE(queue->process(0));
+
+    TEST_ASSERT_EQUAL_INT(3, orderCount);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT(i, order[i]);
+        TEST_ASSERT_TRUE(queue->wait(&requests[i], 0));
+        TEST_ASSERT_TRUE(requests[i].busUs > 0);
+    }
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(written, readBack, 4);
+    // The plain read carries on after the last register read
+    TEST_ASSERT_EQUAL_HEX8(0x55, plain[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x66, plain[1]);
+    // The later requests waited for the earlier ones on the bus
+    TEST_ASSERT_TRUE(requests[2].queuedUs >=
+                     requests[0].busUs + requests[1].busUs);
+
+    I2CQueueStats stats = queue->stats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.submitted);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.completed);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.failed);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.maxDepth);
+}
+
+static void test_full_queue_rejects(void) {
+    uint8_t data[I2CQUEUE_DEPTH + 1];
+    I2CRequest requests[I2CQUEUE_DEPTH + 1];
+    for (int i = 0; i < I2CQUEUE_DEPTH + 1; i++) {
+        setRequest(&requests[i], I2C_WRITE_READ, UV_ADDR, (uint8_t)i,
+                   &data[i], 1);
+    }
+    for (int i = 0; i < I2CQUEUE_DEPTH; i++) {
+        TEST_ASSERT_TRUE(queue->submit(&requests[i]));
+    }
+    TEST_ASSERT_FALSE(queue->submit(&requests[I2CQUEUE_DEPTH]));
+    TEST_ASSERT_EQUAL_UINT32(1, queue->stats().rejected);
+
+    // Room again once the owner has taken one
+    TEST_ASSERT_TRUE(queue->process(0));
+    TEST_ASSERT_TRUE(queue->submit(&requests[I2CQUEUE_DEPTH]));
+    while (queue->process(0)) {
+    }
+    TEST_ASSERT_EQUAL_UINT32(I2CQUEUE_DEPTH + 1, queue->stats().completed);
+}
+
+static void test_failed_request(void) {
+    uint8_t data[10];
+    I2CRequest request;
+    setRequest(&request, I2C_WRITE_READ, UV_ADDR, 0x00, data, 10);
+    sim->failNext(1, I2C_BUS_ADDR_NACK);
+    TEST_ASSERT_TRUE(queue->submit(&request));
+    TEST_ASSERT_TRUE(queue->process(0));
+    TEST_ASSERT_FALSE(queue->wait(&request, 0));
+    TEST_ASSERT_TRUE(request.finished());
+    TEST_ASSERT_EQUAL_UINT32(1, queue->stats().failed);
+
+    // Counted for the device by the I2C_Class
+    I2CDeviceStats stats;
+    TEST_ASSERT_TRUE(bus->deviceStats(0, &stats));
+    TEST_ASSERT_EQUAL_HEX8(UV_ADDR, stats.addr);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.nacks);
+
+    // Unknown device
+    setRequest(&request, I2C_WRITE, 0x20, 0x00, data, 1);
+    TEST_ASSERT_TRUE(queue->submit(&request));
+    TEST_ASSERT_TRUE(queue->process(0));
+    TEST_ASSERT_FALSE(queue->wait(&request, 0));
+}
+
+// Producers on several threads submit and wait while another thread talks
+// to the bus directly; the bus lock keeps every transaction whole
+static void test_shared_bus_from_threads(void) {
+    const int perProducer = 300;
+    sim->setRealTime(true);
+    bus->begin(sim);
+    std::atomic<bool> stop(false);
+    std::thread owner([&stop] {
+        while (!stop) queue->process(5);
+    });
+
+    std::atomic<int> failures(0);
+    std::thread producers[3];
+    for (int p = 0; p < 3; p++) {
+        producers[p] = std::thread([p, &failures] {
+            uint8_t value[2];
+            I2CRequest request;
+            for (int i = 0; i < perProducer; i++) {
+                // Each producer writes its own register pair and reads it
+                // back in the same request order
+                value[0] = (uint8_t)i;
+                value[1] = (uint8_t)p;
+                setRequest(&request, I2C_WRITE, LOG_ADDR,
+                           (uint8_t)(0x10 * p), value, 2);
+                if (!queue->transfer(&request, 1000)) failures++;
+                uint8_t check[2];
+                setRequest(&request, I2C_WRITE_READ, LOG_ADDR,
+                           (uint8_t)(0x10 * p), check, 2);
+                if (!queue->transfer(&request, 1000) ||
+                    check[0] != (uint8_t)i || check[1] != (uint8_t)p) {
+                    failures++;
+                }
+            }
+        });
+    }
+    std::thread direct([&failures] {
+        for (int i = 0; i < perProducer; i++) {
+            uint8_t raw[10];
+            if (!bus->readBytes(UV_ADDR, 0x02, raw, sizeof(raw))) failures++;
+        }
+    });
+    for (int p = 0; p < 3; p++) producers[p].join();
+    direct.join();
+    stop = true;
+    owner.join();
+
+    SimulatedI2CStats simStats = sim->stats();
+    printf("%u transactions from 3 producers and a direct reader, "
+           "%u overlapping calls, %u interleaved\n",
+           (unsigned)simStats.transactions, (unsigned)simStats.overlaps,
+           (unsigned)simStats.interleaved);
+    TEST_ASSERT_EQUAL_INT(0, failures.load());
+    TEST_ASSERT_EQUAL_UINT32(0, simStats.overlaps);
+    TEST_ASSERT_EQUAL_UINT32(0, simStats.interleaved);
+    TEST_ASSERT_EQUAL_UINT32(6 * perProducer, queue->stats().completed);
+}
+
+typedef struct {
+    uint8_t addr;
+    uint8_t op;
+    uint8_t length;
+    uint32_t periodUs;
+    uint64_t dueUs;
+    uint32_t overruns;  // Periods skipped, the last request still pending
+    uint32_t maxQueuedUs;
+    uint64_t queuedUs;
+    uint32_t done;
+    uint8_t buffer[200];
+    I2CRequest request;
+} Producer;
+
+static void setProducer(Producer* producer, uint8_t addr, uint8_t op,
+                        uint8_t length, uint32_t periodUs) {
+    producer->addr        = addr;
+    producer->op          = op;
+    producer->length      = length;
+    producer->periodUs    = periodUs;
+    producer->dueUs       = periodUs;
+    producer->overruns    = 0;
+    producer->maxQueuedUs = 0;
+    producer->queuedUs    = 0;
+    producer->done        = 0;
+    setRequest(&producer->request, op, addr, 0x00, producer->buffer, length);
+}
+
+// UV at 1 kHz, humidity at 500 Hz and a 200 byte block every 20 ms on a
+// 400 kHz bus, for 2 s of simulated time. Deterministic: the owner runs
+// whenever a request is queued and the bus time advances the clock.
+static void test_three_producer_load(void) {
+    Producer producers[3];
+    setProducer(&producers[0], UV_ADDR, I2C_WRITE_READ, 10, 1000);
+    setProducer(&producers[1], RH_ADDR, I2C_READ, 6, 2000);
+    setProducer(&producers[2], LOG_ADDR, I2C_WRITE_READ, 200, 20000);
+    const uint64_t endUs = 2000000;
+    uint64_t submitNs    = 0;
+    uint32_t submits     = 0;
+
+    for (;;) {
+        uint64_t now = SimulatedI2CBus::clockUs();
+        for (int p = 0; p < 3; p++) {
+            Producer& producer = producers[p];
+            if (producer.dueUs > now || producer.dueUs >= endUs) continue;
+            producer.dueUs += producer.periodUs;
+            if (!producer.request.finished()) {
+                producer.overruns++;
+                continue;
+            }
+            std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+            TEST_ASSERT_TRUE(queue->submit(&producer.request));
+            submitNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+            submits++;
+        }
+        if (queue->depth() > 0) {
+            queue->process(0);
+            for (int p = 0; p < 3; p++) {
+                Producer& producer = producers[p];
+                if (producer.request.finished() &&
+                    producer.request.busUs != 0) {
+                    producer.done++;
+                    producer.queuedUs += producer.request.queuedUs;
+                    if (producer.request.queuedUs > producer.maxQueuedUs) {
+                        producer.maxQueuedUs = producer.request.queuedUs;
+                    }
+                    producer.request.busUs = 0;
+                }
+            }
+            continue;
+        }
+        uint64_t next = endUs;
+        for (int p = 0; p < 3; p++) {
+            if (producers[p].dueUs < next) next = producers[p].dueUs;
+        }
+        if (next >= endUs) break;
+        SimulatedI2CBus::advanceUs(next - now);
+    }
+
+    I2CQueueStats stats        = queue->stats();
+    SimulatedI2CStats simStats = sim->stats();
+    uint64_t elapsedUs         = SimulatedI2CBus::clockUs();
+    printf("%u requests in %.2f s: max depth %u, bus busy %.1f %%, "
+           "%.1f kB/s on the wire, submit %.0f ns (host)\n",
+           (unsigned)stats.completed, elapsedUs / 1e6,
+           (unsigned)stats.maxDepth,
+           100.0 * simStats.busNs / 1000 / elapsedUs,
+           simStats.bytes * 1000.0 / elapsedUs,
+           (double)submitNs / submits);
+    for (int p = 0; p < 3; p++) {
+        Producer& producer = producers[p];
+        printf("  0x%02x %3u B every %5u us: %4u done, queued avg %.0f us, "
+               "max %u us, %u overruns\n",
+               producer.addr, producer.length, (unsigned)producer.periodUs,
+               (unsigned)producer.done,
+               (double)producer.queuedUs / producer.done,
+               (unsigned)producer.maxQueuedUs, (unsigned)producer.overruns);
+        TEST_ASSERT_EQUAL_UINT32(endUs / producer.periodUs - 1,
+                                 producer.done + producer.overruns);
+    }
+    // The queue does not preempt: a 200 byte block holds the bus for
+    // longer than the UV and humidity periods, which costs each of them at
+    // most one period per block, the rest catches up
+    TEST_ASSERT_EQUAL_UINT32(0, producers[2].overruns);
+    TEST_ASSERT_LESS_OR_EQUAL(producers[2].done, producers[0].overruns);
+    TEST_ASSERT_LESS_OR_EQUAL(producers[2].done, producers[1].overruns);
+    TEST_ASSERT_EQUAL_UINT32(stats.submitted, stats.completed);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.failed);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.rejected);
+    TEST_ASSERT_LESS_OR_EQUAL(3, stats.maxDepth);
+    // A UV read never waits longer than the longest transfer ahead of it
+    TEST_ASSERT_LESS_THAN(6000, producers[0].maxQueuedUs);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_requests_finish_in_order);
+    RUN_TEST(test_full_queue_rejects);
+    RUN_TEST(test_failed_request);
+    RUN_TEST(test_shared_bus_from_threads);
+    RUN_TEST(test_three_producer_load);
+    return UNITY_END();
+}
@@ -0,0 +1,119 @@
+// writeBitOn/Off with and without an I2CRegisterShadow on SimulatedI2CBus:
+// the shadow saves the reads and ends with the same registers, and a
+// failed read never turns into a write.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include "I2CRegisterShadow.h"
+#include "I2C_Class.h"
+#include "SimulatedI2CBus.h"
+
+#define DEVICE_ADDR 0x74
+#define FIRST_REG   0x06  // Configuration registers of the AS7331
+#define LAST_REG    0x09
+
+static SimulatedI2CBus* sim;
+static I2C_Class* bus;
+
+void setUp(void) {
+    SimulatedI2CBus::resetClock();
+    sim = new SimulatedI2CBus();
+    sim->addDevice(DEVICE_ADDR);
+    bus = new I2C_Class();
+    bus->begin(sim, SimulatedI2CBus::clockUs);
+    srand(7);
+}
+
+void tearDown(void) {
+    delete bus;
+    delete sim;
+}
+
+static void randomBitOps(int count) {
+    for (int i = 0; i < count; i++) {
+        uint8_t reg =
+            (uint8_t)(FIRST_REG + rand() % (LAST_REG - FIRST_REG + 1));
+        uint8_t bit = (uint8_t)(1 << (rand() % 8));
+        if (rand() & 1) {
+            TEST_ASSERT_TRUE(bus->writeBitOn(DEVICE_ADDR, reg, bit));
+        } else {
+            TEST_ASSERT_TRUE(bus->writeBitOff(DEVICE_ADDR, reg, bit));
+        }
+    }
+}
+
+static void test_shadow_saves_reads(void) {
+    const int ops = 1000;
+    randomBitOps(ops);
+    uint8_t plain[LAST_REG - FIRST_REG + 1];
+    memcpy(plain, sim->registers(DEVICE_ADDR) + FIRST_REG, sizeof(plain));
+    uint32_t plainTransactions = sim->stats().transactions;
+
+    // Same operations again from the same start, now with a shadow
+    memset(sim->registers(DEVICE_ADDR), 0, 256);
+    sim->resetStats();
+    srand(7);
+    I2CRegisterShadow shadow(DEVICE_ADDR);
+    shadow.setCached(FIRST_REG, LAST_REG);
+    TEST_ASSERT_TRUE(bus->attachShadow(&shadow));
+    TEST_ASSERT_TRUE(bus->refreshShadow(DEVICE_ADDR));
+    randomBitOps(ops);
+    uint32_t shadowTransactions = sim->stats().transactions;
+
+    printf("%d bit operations: %u transactions without shadow, %u with, "
+           "%u reads saved\n",
+           ops, (unsigned)plainTransactions, (unsigned)shadowTransactions,
+           (unsigned)shadow.readsSaved());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(plain,
+                                  sim->registers(DEVICE_ADDR) + FIRST_REG,
+                                  sizeof(plain));
+    TEST_ASSERT_EQUAL_UINT32(2 * ops, plainTransactions);
+    TEST_ASSERT_EQUAL_UINT32(ops, shadow.readsSaved());
+    TEST_ASSERT_EQUAL_UINT32(ops + 1, shadowTransactions);
+
+    uint16_t mismatches;
+    TEST_ASSERT_TRUE(bus->verifyShadow(DEVICE_ADDR, &mismatches));
+    // A change behind the driver's back is found and corrected
+    sim->registers(DEVICE_ADDR)[0x07] ^= 0x10;
+    TEST_ASSERT_FALSE(bus->verifyShadow(DEVICE_ADDR, &mismatches));
+    TEST_ASSERT_EQUAL_UINT16(1, mismatches);
+    TEST_ASSERT_TRUE(bus->verifyShadow(DEVICE_ADDR, &mismatches));
+}
+
+static void test_failed_read_does_not_write(void) {
+    sim->registers(DEVICE_ADDR)[0x06] = 0xA5;
+    sim->resetStats();
+
+    // The register read is not acknowledged: writing (0 | bit) would clear
+    // every other bit of the register
+    sim->failNext(1, I2C_BUS_ADDR_NACK);
+    TEST_ASSERT_FALSE(bus->writeBitOn(DEVICE_ADDR, 0x06, 0x02));
+    sim->failNext(1, I2C_BUS_ADDR_NACK);
+    TEST_ASSERT_FALSE(bus->writeBitOff(DEVICE_ADDR, 0x06, 0x01));
+
+    TEST_ASSERT_EQUAL_HEX8(0xA5, sim->registers(DEVICE_ADDR)[0x06]);
+    // Only the two failed reads reached the bus, no write followed
+    TEST_ASSERT_EQUAL_UINT32(2, sim->stats().transactions);
+    I2CDeviceStats stats;
+    TEST_ASSERT_TRUE(bus->deviceStats(0, &stats));
+    TEST_ASSERT_EQUAL_UINT32(2, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.nacks);
+
+    // Once the device answers again the bit operations go through
+    TEST_ASSERT_TRUE(bus->writeBitOn(DEVICE_ADDR, 0x06, 0x02));
+    TEST_ASSERT_TRUE(bus->writeBitOff(DEVICE_ADDR, 0x06, 0x01));
+    TEST_ASSERT_EQUAL_HEX8(0xA6, sim->registers(DEVICE_ADDR)[0x06]);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_shadow_saves_reads);
+    RUN_TEST(test_failed_read_does_not_write);
+    return UNITY_END();
+}
@@ -0,0 +1,212 @@
+// SampleLog on FileFlash with power cut at random points of programming
+// and erasing. After every cut the log is reopened and must hold every
+// committed batch, in order and intact. Also reports write amplification
+// and sustained samples per second against the file-backed flash.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include <unity.h>
+
+#include "FileFlash.h"
+#include "SampleLog.h"
+
+#define IMAGE_PATH  "test_sample_log.img"
+#define SECTOR_SIZE 4096
+#define BASE_US     1700000000000000ULL
+#define STEP_US     16000
+
+// Sample number i of a deterministic stream, so any stored sample can be
+// checked on its own
+static LogSample sampleAt(uint64_t i) {
+    LogSample sample;
+    sample.timestampUs = BASE_US + i * STEP_US;
+    sample.uva         = (uint32_t)(40000 + (i * 37) % 5000);
+    sample.uvb         = (uint32_t)(9000 + (i * 11) % 700);
+    sample.uvc         = (uint32_t)(i % 13);
+    sample.tempCenti   = (int16_t)(2500 + i % 100);
+    return sample;
+}
+
+typedef struct {
+    uint64_t first;  // Oldest stored sample number
+    uint64_t last;   // Newest stored sample number
+    uint32_t count;
+    bool contiguous;
+    bool intact;
+} Contents;
+
+static bool visitSample(const LogSample& sample, void* context) {
+    Contents* contents = (Contents*)context;
+    uint64_t i         = (sample.timestampUs - BASE_US) / STEP_US;
+    LogSample expected = sampleAt(i);
+    if (sample.timestampUs != expected.timestampUs ||
+        sample.uva != expected.uva || sample.uvb != expected.uvb ||
+        sample.uvc != expected.uvc ||
+        sample.tempCenti != expected.tempCenti) {
+        contents->intact = false;
+    }
+    if (contents->count == 0) {
+        contents->first = i;
+    } else if (i != contents->last + 1) {
+        contents->contiguous = false;
+    }
+    contents->last = i;
+    contents->count++;
+    return true;
+}
+
+static Contents readBack(SampleLog* log) {
+    Contents contents = {0, 0, 0, true, true};
+    log->forEach(visitSample, &contents);
+    return contents;
+}
+
+void setUp(void) {
+    remove(IMAGE_PATH);
+    srand(7);
+}
+
+void tearDown(void) {
+    remove(IMAGE_PATH);
+}
+
+typedef struct {
+    uint32_t cycles;
+    uint32_t tornBatches;
+    uint32_t minUsedSectors;  // After the region has wrapped once
+    bool wrapped;
+} PowerLossResult;
+
+// Appends the stream until the injected power loss, then reopens and
+// checks. A sample is committed once the batch holding it was written.
+static PowerLossResult powerLossCycles(uint32_t sectors, uint32_t cycles,
+                                       uint32_t maxBytesPerCycle) {
+    PowerLossResult result = {0, 0, sectors, false};
+    FileFlash flash;
+    TEST_ASSERT_TRUE(flash.open(IMAGE_PATH, SECTOR_SIZE, sectors));
+    SampleLog* log = new SampleLog(&flash);
+    TEST_ASSERT_TRUE(log->format());
+    TEST_ASSERT_TRUE(log->begin());
+
+    uint64_t next      = 0;
+    uint64_t committed = 0;  // Samples before this are durable
+    for (uint32_t cycle = 0; cycle < cycles; cycle++) {
+        // One in four cuts hits an erase (half a sector keeps old data),
+        // the rest stop programming after a random number of bytes
+        if (rand() % 4 == 0) {
+            flash.powerLossAtErase(1 + rand() % 3);
+        } else {
+            flash.powerLossAfterBytes(1 + rand() % maxBytesPerCycle);
+        }
+        while (!flash.powerLost()) {
+            uint32_t batches = log->stats().batches;
+            log->append(sampleAt(next++));
+            if (rand() % 64 == 0) log->flush();
+            if (log->stats().batches != batches && !flash.powerLost()) {
+                committed = next;
+            }
+        }
+
+        flash.powerCycle();
+        delete log;
+        log = new SampleLog(&flash);
+        TEST_ASSERT_TRUE(log->begin());
+        result.tornBatches += log->stats().tornBatches;
+
+        Contents contents = readBack(log);
+        TEST_ASSERT_TRUE(contents.intact);
+        TEST_ASSERT_TRUE(contents.contiguous);
+        TEST_ASSERT_TRUE(contents.count > 0 || committed == 0);
+        // Every committed sample survived, nothing past the cut appeared
+        TEST_ASSERT_TRUE(contents.last + 1 >= committed);
+        TEST_ASSERT_TRUE(contents.last < next);
+        // Samples missing at the old end mean sectors were recycled, which
+        // must not happen before the region is full
+        if (contents.first != 0) result.wrapped = true;
+        if (result.wrapped && log->usedSectors() < result.minUsedSectors) {
+            result.minUsedSectors = log->usedSectors();
+        }
+
+        // The device carries on with new samples after a reboot; the test
+        // continues the stream after the last stored one to keep checking
+        // continuity
+        next      = contents.count > 0 ? contents.last + 1 : 0;
+        committed = next;
+        result.cycles++;
+    }
+    delete log;
+    return result;
+}
+
+static void test_power_loss_without_wrap(void) {
+    // 2 MB region, never full: recovery must keep everything committed
+    PowerLossResult result = powerLossCycles(512, 200, 8000);
+    printf("%u power cuts, %u torn batches closed\n",
+           (unsigned)result.cycles, (unsigned)result.tornBatches);
+    TEST_ASSERT_EQUAL_UINT32(200, result.cycles);
+    TEST_ASSERT_FALSE(result.wrapped);
+    TEST_ASSERT_TRUE(result.tornBatches > 0);
+}
+
+static void test_power_loss_with_wrap(void) {
+    // 128 KB region written over many times: the oldest sectors go, the
+    // rest stays; at most the sector being recycled is lost to a torn
+    // erase
+    PowerLossResult result = powerLossCycles(32, 300, 20000);
+    printf("%u power cuts with wrap-around, %u torn batches, "
+           "at least %u of 32 sectors in use\n",
+           (unsigned)result.cycles, (unsigned)result.tornBatches,
+           (unsigned)result.minUsedSectors);
+    TEST_ASSERT_TRUE(result.wrapped);
+    TEST_ASSERT_GREATER_OR_EQUAL(32 - 2, result.minUsedSectors);
+}
+
+static void test_sustained_rate(void) {
+    const uint32_t samples = 500000;
+    FileFlash flash;
+    TEST_ASSERT_TRUE(flash.open(IMAGE_PATH, SECTOR_SIZE, 256));
+    SampleLog log(&flash);
+    TEST_ASSERT_TRUE(log.format());
+    TEST_ASSERT_TRUE(log.begin());
+    uint64_t formatBytes = flash.bytesWritten();
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < samples; i++) {
+        TEST_ASSERT_TRUE(log.append(sampleAt(i)));
+    }
+    TEST_ASSERT_TRUE(log.flush());
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    SampleLogStats stats = log.stats();
+    printf("%u samples: %.0f samples/s against the file-backed flash\n",
+           (unsigned)samples, samples / seconds);
+    printf("write amplification %.3f (flash bytes per coded byte), "
+           "%.2f flash B/sample vs %u B per LogSample, %u erases\n",
+           log.writeAmplification(), log.bytesPerSample(),
+           (unsigned)sizeof(LogSample), (unsigned)stats.erases);
+    TEST_ASSERT_EQUAL_UINT64(stats.flashBytes,
+                             flash.bytesWritten() - formatBytes);
+    TEST_ASSERT_TRUE(log.writeAmplification() < 1.05f);
+
+    // The newest sectors hold an unbroken tail of the stream
+    Contents contents = readBack(&log);
+    TEST_ASSERT_TRUE(contents.intact);
+    TEST_ASSERT_TRUE(contents.contiguous);
+    TEST_ASSERT_EQUAL_UINT64(samples - 1, contents.last);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_power_loss_without_wrap);
+    RUN_TEST(test_power_loss_with_wrap);
+    RUN_TEST(test_sustained_rate);
+    return UNITY_END();
+}
@@ -0,0 +1,308 @@
+// SampleLog::query() and aggregate() on a wrapped FileFlash region the size
+// of the uvlog partition (368 sectors), checked against forEach() plus the
+// samples still buffered in RAM. Also covers appends that recycle sectors
+// while a query walks them, and aggregate() taking whole sectors from the
+// RAM index instead of reading them.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <vector>
+
+#include <unity.h>
+
+#include "FileFlash.h"
+#include "SampleLog.h"
+
+#define IMAGE_PATH  "test_sample_log_query.img"
+#define SECTOR_SIZE 4096
+#define SECTORS     368  // 0x170000 bytes, the uvlog partition
+#define BASE_US     1780000000000000ULL
+#define STEP_US     16000
+#define BUFFERED    10   // Samples left in RAM, fewer than one batch
+
+// Sample number i; uvc carries i so every sample can be checked on its own.
+// Timestamps jitter within the step but always increase.
+static LogSample sampleAt(uint32_t i) {
+    LogSample sample;
+    sample.timestampUs = BASE_US + (uint64_t)i * STEP_US + (i * 7919) % 5000;
+    sample.uva         = 30000 + (i * 2654435761u >> 20) % 20000;
+    sample.uvb         = 8000 + (i * 40503u) % 900;
+    sample.uvc         = i;
+    sample.tempCenti   = (int16_t)(2500 + i % 300);
+    return sample;
+}
+
+static bool sameSample(const LogSample& a, const LogSample& b) {
+    return a.timestampUs == b.timestampUs && a.uva == b.uva &&
+           a.uvb == b.uvb && a.uvc == b.uvc && a.tempCenti == b.tempCenti;
+}
+
+static bool collect(const LogSample& sample, void* context) {
+    ((std::vector<LogSample>*)context)->push_back(sample);
+    return true;
+}
+
+typedef struct {
+    uint64_t startUs;
+    SampleSummary summary;
+} Bucket;
+
+static bool collectBucket(uint64_t startUs, const SampleSummary& summary,
+                          void* context) {
+    Bucket bucket = {startUs, summary};
+    ((std::vector<Bucket>*)context)->push_back(bucket);
+    return true;
+}
+
+static FileFlash* flash;
+static SampleLog* sampleLog;
+static uint32_t appended;  // Samples 0 .. appended - 1 went into the log
+// What the log holds, oldest first: forEach() and then the buffered ones
+static std::vector<LogSample> stored;
+
+static void append(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(sampleLog->append(sampleAt(appended++)));
+    }
+}
+
+// Fills the region one and a quarter times, then leaves BUFFERED samples
+// in RAM; stored is what forEach() returns plus those
+static void fillWrapped(void) {
+    while (sampleLog->stats().erases < SECTORS + SECTORS / 4) append(1000);
+    TEST_ASSERT_TRUE(sampleLog->flush());
+    append(BUFFERED);
+
+    stored.clear();
+    sampleLog->forEach(collect, &stored);
+    TEST_ASSERT_TRUE(stored.size() > 0);
+    TEST_ASSERT_EQUAL_UINT32(appended - BUFFERED, stored.back().uvc + 1);
+    for (uint32_t i = appended - BUFFERED; i < appended; i++) {
+        stored.push_back(sampleAt(i));
+    }
+    // Old samples were recycled, the rest is one unbroken run
+    TEST_ASSERT_TRUE(stored.front().uvc > 0);
+    for (size_t i = 0; i < stored.size(); i++) {
+        TEST_ASSERT_TRUE(sameSample(sampleAt(stored.front().uvc + i),
+                                    stored[i]));
+    }
+}
+
+void setUp(void) {
+    remove(IMAGE_PATH);
+    flash = new FileFlash();
+    TEST_ASSERT_TRUE(flash->open(IMAGE_PATH, SECTOR_SIZE, SECTORS));
+    sampleLog = new SampleLog(flash);
+    TEST_ASSERT_TRUE(sampleLog->format());
+    TEST_ASSERT_TRUE(sampleLog->begin());
+    appended = 0;
+}
+
+void tearDown(void) {
+    delete sampleLog;
+    delete flash;
+    remove(IMAGE_PATH);
+}
+
+static void checkQuery(uint64_t fromUs, uint64_t toUs) {
+    std::vector<LogSample> expected;
+    for (size_t i = 0; i < stored.size(); i++) {
+        uint64_t t = stored[i].timestampUs;
+        if (t >= fromUs && t < toUs) expected.push_back(stored[i]);
+    }
+    std::vector<LogSample> found;
+    uint32_t visited = sampleLog->query(fromUs, toUs, collect, &found);
+
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), visited);
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), found.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_TRUE(sameSample(expected[i], found[i]));
+    }
+}
+
+static void test_query_matches_for_each(void) {
+    fillWrapped();
+    uint64_t first = stored.front().timestampUs;
+    uint64_t last  = stored.back().timestampUs;
+    printf("%u samples appended, %u stored in %u of %u sectors\n",
+           (unsigned)appended, (unsigned)stored.size(),
+           (unsigned)sampleLog->usedSectors(), (unsigned)SECTORS);
+
+    checkQuery(0, UINT64_MAX);
+    checkQuery(first + 1, last);           // Cuts into both end sectors
+    checkQuery(first + 3600000000ULL, first + 3601000000ULL);  // 1 s
+    checkQuery(0, first);                  // Only recycled samples
+    checkQuery(last + 1, UINT64_MAX);      // After the newest
+    checkQuery(stored[stored.size() - BUFFERED].timestampUs, UINT64_MAX);
+}
+
+static void test_buffered_samples_included(void) {
+    fillWrapped();
+    // The buffered samples alone: none of them has reached the flash
+    uint64_t fromUs = stored[stored.size() - BUFFERED].timestampUs;
+    std::vector<LogSample> flashed;
+    sampleLog->forEach(collect, &flashed);
+    TEST_ASSERT_TRUE(flashed.back().timestampUs < fromUs);
+
+    std::vector<LogSample> found;
+    TEST_ASSERT_EQUAL_UINT32(
+        BUFFERED, sampleLog->query(fromUs, UINT64_MAX, collect, &found));
+    for (size_t i = 0; i < BUFFERED; i++) {
+        TEST_ASSERT_TRUE(
+            sameSample(sampleAt(appended - BUFFERED + i), found[i]));
+    }
+
+    // Flushed, the same samples come from the flash
+    TEST_ASSERT_TRUE(sampleLog->flush());
+    found.clear();
+    TEST_ASSERT_EQUAL_UINT32(
+        BUFFERED, sampleLog->query(fromUs, UINT64_MAX, collect, &found));
+}
+
+// Appends from inside the query, as the storage task does while the
+// command task exports
+typedef struct {
+    std::vector<LogSample> found;
+    uint32_t appendAt;  // Visit number at which to append
+    uint32_t count;     // Samples to append then
+} Interleave;
+
+static bool appendWhileVisiting(const LogSample& sample, void* context) {
+    Interleave* state = (Interleave*)context;
+    state->found.push_back(sample);
+    if (state->found.size() == state->appendAt) append(state->count);
+    return true;
+}
+
+static void test_sector_recycled_during_walk(void) {
+    fillWrapped();
+    uint64_t lastBefore = stored.back().timestampUs;
+    uint32_t oldest     = stored.front().uvc;
+
+    // About three sectors of new samples while the walk is in the oldest
+    // sector: it and the next ones are erased under the reader
+    Interleave state;
+    state.appendAt = 100;
+    state.count    = 3 * (uint32_t)(stored.size() / sampleLog->usedSectors());
+    sampleLog->query(0, lastBefore + 1, appendWhileVisiting, &state);
+
+    std::vector<LogSample> after;
+    sampleLog->forEach(collect, &after);
+    printf("walk with %u samples appended: %u visited, oldest stored went "
+           "from %u to %u\n",
+           (unsigned)state.count, (unsigned)state.found.size(),
+           (unsigned)oldest, (unsigned)after.front().uvc);
+    TEST_ASSERT_TRUE(after.front().uvc > oldest + state.appendAt);
+
+    // Every visited sample is intact, in order and visited once; nothing
+    // from a recycled sector was read with its old position
+    for (size_t i = 0; i < state.found.size(); i++) {
+        const LogSample& sample = state.found[i];
+        TEST_ASSERT_TRUE(sameSample(sampleAt(sample.uvc), sample));
+        TEST_ASSERT_TRUE(sample.timestampUs <= lastBefore);
+        if (i > 0) {
+            TEST_ASSERT_TRUE(sample.timestampUs >
+                             state.found[i - 1].timestampUs);
+        }
+    }
+    // Samples that were stored before and still are were all visited
+    uint32_t kept = 0;
+    std::map<uint32_t, bool> seen;
+    for (size_t i = 0; i < state.found.size(); i++) {
+        seen[state.found[i].uvc] = true;
+    }
+    for (size_t i = 0; i < after.size(); i++) {
+        if (after[i].timestampUs > lastBefore) break;
+        TEST_ASSERT_TRUE(seen.count(after[i].uvc) == 1);
+        kept++;
+    }
+    TEST_ASSERT_TRUE(kept > 0);
+}
+
+// Buckets computed from stored alone
+static std::vector<Bucket> bruteAggregate(uint64_t fromUs, uint64_t toUs,
+                                          uint64_t bucketUs) {
+    std::map<uint64_t, SampleSummary> buckets;
+    for (size_t i = 0; i < stored.size(); i++) {
+        uint64_t t = stored[i].timestampUs;
+        if (t < fromUs || t >= toUs) continue;
+        uint64_t bucket = (t - fromUs) / bucketUs;
+        if (buckets.count(bucket) == 0) summaryClear(&buckets[bucket]);
+        summaryAdd(&buckets[bucket], stored[i]);
+    }
+    std::vector<Bucket> result;
+    for (std::map<uint64_t, SampleSummary>::iterator it = buckets.begin();
+         it != buckets.end(); ++it) {
+        Bucket bucket = {fromUs + it->first * bucketUs, it->second};
+        result.push_back(bucket);
+    }
+    return result;
+}
+
+// Returns the sectors aggregate() took from the index
+static uint32_t checkAggregate(uint64_t fromUs, uint64_t toUs,
+                               uint64_t bucketUs) {
+    std::vector<Bucket> expected = bruteAggregate(fromUs, toUs, bucketUs);
+    std::vector<Bucket> found;
+    SampleLogStats before = sampleLog->stats();
+    uint32_t emitted =
+        sampleLog->aggregate(fromUs, toUs, bucketUs, collectBucket, &found);
+    SampleLogStats after = sampleLog->stats();
+    uint32_t sectors     = after.querySectors - before.querySectors;
+    printf("  %7.0f s buckets: %4u buckets, %5u batches read, %3u sectors "
+           "from the index\n",
+           bucketUs / 1e6, (unsigned)emitted,
+           (unsigned)(after.queryBatches - before.queryBatches),
+           (unsigned)sectors);
+
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), emitted);
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), found.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        const SampleSummary& want = expected[i].summary;
+        const SampleSummary& got  = found[i].summary;
+        TEST_ASSERT_EQUAL_UINT64(expected[i].startUs, found[i].startUs);
+        TEST_ASSERT_EQUAL_UINT32(want.count, got.count);
+        TEST_ASSERT_EQUAL_UINT64(want.startUs, got.startUs);
+        TEST_ASSERT_EQUAL_UINT64(want.endUs, got.endUs);
+        for (int c = 0; c < SAMPLESUMMARY_CHANNELS; c++) {
+            TEST_ASSERT_EQUAL_UINT32(want.min[c], got.min[c]);
+            TEST_ASSERT_EQUAL_UINT32(want.max[c], got.max[c]);
+            TEST_ASSERT_EQUAL_UINT64(want.sum[c], got.sum[c]);
+        }
+    }
+    return sectors;
+}
+
+static void test_aggregate_matches_for_each(void) {
+    fillWrapped();
+    uint64_t first = stored.front().timestampUs;
+    uint64_t last  = stored.back().timestampUs;
+    // Not aligned to any bucket, and cutting into the oldest sector
+    uint64_t fromUs = first + 1234567;
+    printf("Aggregate over %.1f h of samples:\n", (last - first) / 3600e6);
+
+    // Buckets shorter than a sector: every batch is read
+    TEST_ASSERT_EQUAL_UINT32(0, checkAggregate(fromUs, UINT64_MAX, 1000000));
+    checkAggregate(fromUs, UINT64_MAX, 60000000);
+    // An hour holds hundreds of sectors, which come from the index
+    uint32_t fromIndex = checkAggregate(fromUs, UINT64_MAX, 3600000000ULL);
+    TEST_ASSERT_TRUE(fromIndex > SECTORS / 2);
+    // One bucket over everything still reads the ends, which are partly
+    // outside the range or still growing
+    fromIndex = checkAggregate(fromUs, last, last - fromUs);
+    TEST_ASSERT_TRUE(fromIndex > SECTORS / 2);
+    checkAggregate(0, first, 3600000000ULL);  // Recycled only: nothing
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_query_matches_for_each);
+    RUN_TEST(test_buffered_samples_included);
+    RUN_TEST(test_sector_recycled_during_walk);
+    RUN_TEST(test_aggregate_matches_for_each);
+    return UNITY_END();
+}
@@ -0,0 +1,188 @@
+// QuantileEstimator against the exact quantiles of the same samples, its
+// exact order statistics below STREAMSTATS_MARKERS samples, and the channel
+// statistics of MeasurementState going back to zero with resetMaxima().
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <unity.h>
+
+#include "MeasurementState.h"
+#include "StreamStats.h"
+
+#define SAMPLES 20000
+
+void setUp(void) {
+    srand(3);
+}
+
+void tearDown(void) {
+}
+
+static float uniform01(void) {
+    return (rand() + 0.5f) / ((float)RAND_MAX + 1.0f);
+}
+
+typedef float (*Generator)(int i);
+
+static float uniformValue(int i) {
+    (void)i;
+    return 1000.0f * uniform01();
+}
+
+// Box-Muller, around 500 with a deviation of 50
+static float normalValue(int i) {
+    (void)i;
+    return 500.0f + 50.0f * sqrtf(-2.0f * logf(uniform01())) *
+                        cosf(6.2831853f * uniform01());
+}
+
+// Long right tail, like irradiance under passing clouds
+static float exponentialValue(int i) {
+    (void)i;
+    return -200.0f * logf(uniform01());
+}
+
+// Slowly rising values, a sunrise; every sample is a new maximum
+static float rampValue(int i) {
+    return i * 0.05f + 5.0f * uniform01();
+}
+
+static float exactQuantile(const std::vector<float>& sorted, float q) {
+    return sorted[(size_t)(q * (sorted.size() - 1) + 0.5f)];
+}
+
+// The estimate must lie between the exact quantiles at q - band and
+// q + band, a tolerance in rank that does not depend on the scale
+static void checkQuantile(const char* name, const std::vector<float>& sorted,
+                          float q, float band, float estimate) {
+    float low  = exactQuantile(sorted, q - band);
+    float high = exactQuantile(sorted, q + band > 1.0f ? 1.0f : q + band);
+    float rank = (float)(std::lower_bound(sorted.begin(), sorted.end(),
+                                          estimate) -
+                         sorted.begin()) /
+                 (sorted.size() - 1);
+    printf("  %-11s p%-4.1f exact %8.2f estimate %8.2f (rank %.4f)\n", name,
+           q * 100, exactQuantile(sorted, q), estimate, rank);
+    TEST_ASSERT_TRUE(estimate >= low);
+    TEST_ASSERT_TRUE(estimate <= high);
+}
+
+static void test_quantiles_match_exact(void) {
+    const struct {
+        const char* name;
+        Generator generator;
+    } cases[] = {
+        {"uniform", uniformValue},
+        {"normal", normalValue},
+        {"exponential", exponentialValue},
+        {"ramp", rampValue},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        QuantileEstimator estimator;
+        std::vector<float> values;
+        for (int i = 0; i < SAMPLES; i++) {
+            float value = cases[c].generator(i);
+            estimator.add(value);
+            values.push_back(value);
+        }
+        std::sort(values.begin(), values.end());
+
+        TEST_ASSERT_EQUAL_UINT32(SAMPLES, estimator.count());
+        checkQuantile(cases[c].name, values, 0.50f, 0.01f, estimator.p50());
+        checkQuantile(cases[c].name, values, 0.95f, 0.01f, estimator.p95());
+        checkQuantile(cases[c].name, values, 0.99f, 0.005f, estimator.p99());
+    }
+}
+
+static void test_few_samples_are_exact(void) {
+    QuantileEstimator estimator;
+    TEST_ASSERT_EQUAL_FLOAT(0, estimator.p50());
+
+    std::vector<float> values;
+    for (int n = 1; n < STREAMSTATS_MARKERS; n++) {
+        float value = uniformValue(n);
+        estimator.add(value);
+        values.push_back(value);
+        std::vector<float> sorted(values);
+        std::sort(sorted.begin(), sorted.end());
+
+        // Nearest rank among the samples so far, no interpolation
+        TEST_ASSERT_EQUAL_FLOAT(exactQuantile(sorted, 0.50f), estimator.p50());
+        TEST_ASSERT_EQUAL_FLOAT(exactQuantile(sorted, 0.95f), estimator.p95());
+        TEST_ASSERT_EQUAL_FLOAT(exactQuantile(sorted, 0.99f), estimator.p99());
+    }
+
+    // The ninth sample turns the sorted samples into the markers
+    estimator.add(500.0f);
+    values.push_back(500.0f);
+    std::sort(values.begin(), values.end());
+    TEST_ASSERT_EQUAL_UINT32(STREAMSTATS_MARKERS, estimator.count());
+    TEST_ASSERT_EQUAL_FLOAT(values[2], estimator.p50());
+
+    estimator.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, estimator.count());
+    estimator.add(42.0f);
+    TEST_ASSERT_EQUAL_FLOAT(42.0f, estimator.p50());
+    TEST_ASSERT_EQUAL_FLOAT(42.0f, estimator.p99());
+}
+
+static UVSample sampleOf(uint32_t seq, float uva, float uvb, float uvc) {
+    UVSample sample    = UVSample();
+    sample.seq         = seq;
+    sample.timestampUs = (uint64_t)seq * 64000;
+    sample.uva         = uva;
+    sample.uvb         = uvb;
+    sample.uvc         = uvc;
+    return sample;
+}
+
+static void test_reset_maxima_clears_statistics(void) {
+    MeasurementState state;
+    UVDoseTotals dose = UVDoseTotals();
+    for (uint32_t i = 0; i < 1000; i++) {
+        state.publishSample(sampleOf(i, 800.0f + i % 100, 50.0f, 2.0f), dose);
+    }
+    MeasurementSnapshot before = state.snapshot();
+    TEST_ASSERT_EQUAL_UINT32(1000, before.statsUva.count);
+    TEST_ASSERT_EQUAL_FLOAT(899.0f, before.maxUva);
+    TEST_ASSERT_TRUE(before.statsUva.p50 > 800.0f);
+    TEST_ASSERT_TRUE(before.statsUvb.mean > 0);
+
+    state.resetMaxima();
+    MeasurementSnapshot reset = state.snapshot();
+    TEST_ASSERT_EQUAL_UINT32(before.resetCount + 1, reset.resetCount);
+    TEST_ASSERT_EQUAL_FLOAT(0, reset.maxUva);
+    const ChannelStats* channels[] = {&reset.statsUva, &reset.statsUvb,
+                                      &reset.statsUvc};
+    for (size_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT32(0, channels[i]->count);
+        TEST_ASSERT_EQUAL_FLOAT(0, channels[i]->mean);
+        TEST_ASSERT_EQUAL_FLOAT(0, channels[i]->stddev);
+        TEST_ASSERT_EQUAL_FLOAT(0, channels[i]->p50);
+        TEST_ASSERT_EQUAL_FLOAT(0, channels[i]->p99);
+    }
+
+    // Nothing from before the reset leaks into the new statistics
+    state.publishSample(sampleOf(1000, 10.0f, 1.0f, 0.5f), dose);
+    MeasurementSnapshot after = state.snapshot();
+    TEST_ASSERT_EQUAL_UINT32(1, after.statsUva.count);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, after.statsUva.mean);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, after.statsUva.p50);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, after.statsUva.p99);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, after.maxUva);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_quantiles_match_exact);
+    RUN_TEST(test_few_samples_are_exact);
+    RUN_TEST(test_reset_maxima_clears_statistics);
+    return UNITY_END();
+}
@@ -0,0 +1,164 @@
+// UVAcquisition against SimulatedAS7331 on a virtual clock: every
+// conversion is read exactly once, sequence numbers have no gaps while the
+// caller keeps up, and stalls show up as missed conversions.
+
+#include <stdio.h>
+
+#include <unity.h>
+
+#include "SimulatedAS7331.h"
+#include "UVAcquisition.h"
+
+static uint64_t nowUs;
+
+static uint64_t clockUs(void) {
+    return nowUs;
+}
+
+void setUp(void) {
+    nowUs = 1000;
+}
+
+void tearDown(void) {
+}
+
+typedef struct {
+    uint32_t samples;
+    uint32_t polls;
+    uint32_t gaps;  // Sum of seq jumps beyond 1
+    uint32_t lastSeq;
+    bool ordered;   // seq and timestamps strictly increasing
+} RunResult;
+
+// Polls like the acquisition task does: sleep for nextPollDelayUs(), then
+// poll again. stallEvery/stallUs add a delay after every n-th sample.
+static RunResult run(UVAcquisition* acq, uint32_t samples,
+                     uint32_t stallEvery = 0, uint32_t stallUs = 0) {
+    RunResult result = {0, 0, 0, 0, true};
+    uint64_t lastTs  = 0;
+    while (result.samples < samples) {
+        UVSample sample;
+        result.polls++;
+        if (acq->poll(nowUs, &sample)) {
+            if (result.samples > 0) {
+                if (sample.seq <= result.lastSeq) result.ordered = false;
+                if (sample.timestampUs <= lastTs) result.ordered = false;
+                result.gaps += sample.seq - result.lastSeq - 1;
+            } else {
+                result.gaps += sample.seq;
+            }
+            result.lastSeq = sample.seq;
+            lastTs         = sample.timestampUs;
+            result.samples++;
+            if (stallEvery != 0 && result.samples % stallEvery == 0) {
+                nowUs += stallUs;
+            }
+        }
+        nowUs += acq->nextPollDelayUs(nowUs);
+    }
+    return result;
+}
+
+static void checkReadyRate(uint32_t periodUs) {
+    SimulatedAS7331 sim(clockUs);
+    sim.setIrradiance(120.0f, 25.0f, 0.5f);
+    sim.setReadyPeriodUs(periodUs);
+    UVAcquisition acq(&sim);
+
+    RunResult result = run(&acq, 2000);
+    const UVAcquisitionStats& stats = acq.stats();
+    printf("ready every %6u us: %u samples, %.2f polls/sample, "
+           "%u missed\n",
+           (unsigned)periodUs, (unsigned)result.samples,
+           (double)result.polls / result.samples, (unsigned)stats.missed);
+
+    TEST_ASSERT_TRUE(result.ordered);
+    TEST_ASSERT_EQUAL_UINT32(0, result.gaps);
+    TEST_ASSERT_EQUAL_UINT32(result.samples - 1, result.lastSeq);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.missed);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.errors);
+    // Exactly once: each delivered result was returned by poll() and every
+    // completed conversion but possibly the newest was delivered
+    TEST_ASSERT_EQUAL_UINT32(result.samples, sim.delivered());
+    TEST_ASSERT_EQUAL_UINT32(result.samples, stats.samples);
+    TEST_ASSERT_UINT32_WITHIN(1, sim.conversions(), sim.delivered());
+    // Waiting is paced by the conversion period, not a busy loop
+    TEST_ASSERT_LESS_OR_EQUAL(4 * result.samples, result.polls);
+}
+
+static void test_ready_1khz(void) {
+    checkReadyRate(1000);
+}
+
+static void test_ready_125hz(void) {
+    checkReadyRate(8000);
+}
+
+static void test_ready_default_range(void) {
+    // Gain code 10, time code 6 and a 896 us break
+    SimulatedAS7331 sim(clockUs);
+    checkReadyRate(sim.readyPeriodUs());
+}
+
+static void checkStall(uint32_t periodUs, uint32_t stalledPeriods) {
+    SimulatedAS7331 sim(clockUs);
+    sim.setIrradiance(120.0f, 25.0f, 0.5f);
+    sim.setReadyPeriodUs(periodUs);
+    UVAcquisition acq(&sim);
+
+    // Every 10th sample the caller is held up long enough for
+    // stalledPeriods results to be overwritten; the one after them is still
+    // there when the caller comes back
+    RunResult result = run(&acq, 501, 10, (stalledPeriods + 1) * periodUs);
+    const UVAcquisitionStats& stats = acq.stats();
+    uint32_t stalls = (result.samples - 1) / 10;
+    printf("ready every %6u us, %u periods lost x %u: %u missed, "
+           "seq gaps %u\n",
+           (unsigned)periodUs, (unsigned)stalledPeriods, (unsigned)stalls,
+           (unsigned)stats.missed, (unsigned)result.gaps);
+
+    TEST_ASSERT_TRUE(result.ordered);
+    TEST_ASSERT_EQUAL_UINT32(stalls * stalledPeriods, stats.missed);
+    TEST_ASSERT_EQUAL_UINT32(stats.missed, result.gaps);
+    TEST_ASSERT_EQUAL_UINT32(result.samples + stats.missed - 1,
+                             result.lastSeq);
+    TEST_ASSERT_EQUAL_UINT32(result.samples, sim.delivered());
+    TEST_ASSERT_UINT32_WITHIN(1, sim.conversions(),
+                              sim.delivered() + stats.missed);
+}
+
+static void test_missed_one_period(void) {
+    checkStall(1000, 1);
+}
+
+static void test_missed_several_periods(void) {
+    checkStall(8000, 3);
+}
+
+static void test_range_change_restarts_without_miss(void) {
+    SimulatedAS7331 sim(clockUs);
+    sim.setIrradiance(120.0f, 25.0f, 0.5f);
+    UVAcquisition acq(&sim);
+
+    run(&acq, 10);
+    // The conversion in flight is dropped by the sensor, not missed
+    nowUs += sim.readyPeriodUs() / 2;
+    TEST_ASSERT_TRUE(acq.setRange(8, 4));
+    RunResult result = run(&acq, 10);
+    TEST_ASSERT_TRUE(result.ordered);
+    TEST_ASSERT_EQUAL_UINT32(0, acq.stats().missed);
+    TEST_ASSERT_EQUAL_UINT32(19, result.lastSeq);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_ready_1khz);
+    RUN_TEST(test_ready_125hz);
+    RUN_TEST(test_ready_default_range);
+    RUN_TEST(test_missed_one_period);
+    RUN_TEST(test_missed_several_periods);
+    RUN_TEST(test_range_change_restarts_without_miss);
+    return UNITY_END();
+}
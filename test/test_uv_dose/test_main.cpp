@@ -0,0 +1,211 @@
+// UVDose on synthetic weighted irradiance profiles, checked against the
+// closed-form integrals.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <unity.h>
+
+#include "UVDose.h"
+
+#define US_PER_S   1000000ULL
+// uW/m^2 for one microsecond is one pJ/m^2
+#define PJ_PER_MJ  1000000000ULL
+
+void setUp(void) {
+    srand(1);
+}
+
+void tearDown(void) {
+}
+
+// 16 ms to 250 ms, the spread seen with auto-ranging and bursts
+static uint64_t jitteredStepUs(void) {
+    return 16000 + (uint64_t)(rand() % 234000);
+}
+
+static void test_constant_profile(void) {
+    // 2000 uW/m^2 (0.08 UV index) for one hour at 16 ms
+    UVDose dose;
+    const uint64_t endUs = 3600 * US_PER_S;
+    for (uint64_t t = 0; t <= endUs; t += 16000) dose.addSample(t, 2000);
+
+    TEST_ASSERT_EQUAL_UINT64(2000ULL * endUs, dose.sessionPj());
+    TEST_ASSERT_EQUAL_UINT64(dose.sessionPj(), dose.dailyPj());
+    TEST_ASSERT_EQUAL_UINT32(7200, dose.totals().sessionMj);
+    TEST_ASSERT_EQUAL_UINT32(0, dose.skippedGaps());
+}
+
+static void test_irregular_constant(void) {
+    UVDose dose;
+    const uint64_t endUs = 600 * US_PER_S;
+    uint64_t t           = 0;
+    while (t < endUs) {
+        dose.addSample(t, 1500);
+        t += jitteredStepUs();
+    }
+    dose.addSample(endUs, 1500);
+
+    // Trapezoids of a constant are exact whatever the spacing
+    TEST_ASSERT_EQUAL_UINT64(1500ULL * endUs, dose.sessionPj());
+}
+
+static void test_irregular_ramp(void) {
+    // E(t) = t / 10 ms, so a linear ramp to 60000 uW/m^2 over 600 s;
+    // timestamps on 10 ms steps keep every sample exact
+    UVDose dose;
+    const uint64_t endUs = 600 * US_PER_S;
+    uint64_t t           = 0;
+    while (t < endUs) {
+        dose.addSample(t, (uint32_t)(t / 10000));
+        t += jitteredStepUs() / 10000 * 10000;
+    }
+    dose.addSample(endUs, (uint32_t)(endUs / 10000));
+
+    // Integral of t / 10000 from 0 to T is T^2 / 20000
+    TEST_ASSERT_EQUAL_UINT64(endUs * endUs / 20000, dose.sessionPj());
+}
+
+static void test_irregular_sine(void) {
+    // Half a sine of 40000 uW/m^2 over 20 minutes, a cloud-free pass
+    UVDose dose;
+    const double periodS = 1200.0;
+    const double peak    = 40000.0;
+    const uint64_t endUs = (uint64_t)(periodS * US_PER_S);
+    uint64_t t           = 0;
+    for (;;) {
+        double s = (double)t / US_PER_S;
+        dose.addSample(t, (uint32_t)lround(peak * sin(M_PI * s / periodS)));
+        if (t == endUs) break;
+        t += jitteredStepUs();
+        if (t > endUs) t = endUs;
+    }
+
+    // Integral: peak * 2 * period / pi
+    double expectedPj = peak * 2.0 * periodS / M_PI * US_PER_S;
+    double relative   = fabs((double)dose.sessionPj() - expectedPj) / expectedPj;
+    TEST_ASSERT_TRUE_MESSAGE(relative < 1e-4, "trapezoid error above 1e-4");
+}
+
+static void test_gap_is_skipped(void) {
+    UVDose dose;
+    dose.addSample(0, 1000);
+    dose.addSample(1 * US_PER_S, 1000);
+    // Longer than UVDOSE_MAX_GAP_US: unknown exposure, left out
+    dose.addSample(21 * US_PER_S, 1000);
+    dose.addSample(22 * US_PER_S, 1000);
+
+    TEST_ASSERT_EQUAL_UINT32(1, dose.skippedGaps());
+    TEST_ASSERT_EQUAL_UINT64(2000ULL * US_PER_S, dose.sessionPj());
+}
+
+static void test_daily_rollover(void) {
+    // Boot at 23:59:00, constant 3000 uW/m^2 for two minutes
+    UVDose dose;
+    dose.setTimeOfDay(0, 86340);
+    const uint64_t endUs = 120 * US_PER_S;
+    uint64_t t           = 0;
+    while (t < endUs) {
+        dose.addSample(t, 3000);
+        t += jitteredStepUs();
+    }
+    dose.addSample(endUs, 3000);
+
+    // The session keeps everything, the day only what came after midnight
+    TEST_ASSERT_EQUAL_UINT64(3000ULL * endUs, dose.sessionPj());
+    TEST_ASSERT_EQUAL_UINT64(3000ULL * 60 * US_PER_S, dose.dailyPj());
+}
+
+static void test_rollover_splits_ramp(void) {
+    // Midnight falls 1 s into a 2 s interval going from 0 to 2000: the
+    // interpolated value there is 1000
+    UVDose dose;
+    dose.setTimeOfDay(0, 86399);
+    dose.addSample(0, 0);
+    dose.addSample(2 * US_PER_S, 2000);
+
+    TEST_ASSERT_EQUAL_UINT64(2000ULL * US_PER_S, dose.sessionPj());
+    TEST_ASSERT_EQUAL_UINT64(1500ULL * US_PER_S, dose.dailyPj());
+}
+
+static void test_rollover_during_gap(void) {
+    // A gap across midnight: nothing is integrated, the day still restarts
+    UVDose dose;
+    dose.setTimeOfDay(0, 86390);
+    dose.addSample(0, 5000);
+    dose.addSample(5 * US_PER_S, 5000);
+    dose.addSample(30 * US_PER_S, 5000);
+    dose.addSample(31 * US_PER_S, 5000);
+
+    TEST_ASSERT_EQUAL_UINT32(1, dose.skippedGaps());
+    TEST_ASSERT_EQUAL_UINT64(5000ULL * 6 * US_PER_S, dose.sessionPj());
+    TEST_ASSERT_EQUAL_UINT64(5000ULL * US_PER_S, dose.dailyPj());
+}
+
+static void test_time_to_limit_closed_form(void) {
+    // At constant E the limit is reached after (limit - dose) / E
+    const uint32_t irradiances[] = {250, 1000, 25000, 250000};
+    for (size_t i = 0; i < sizeof(irradiances) / sizeof(irradiances[0]);
+         i++) {
+        uint32_t e = irradiances[i];
+        UVDose dose;
+        TEST_ASSERT_EQUAL_UINT32(UVDOSE_NO_LIMIT, dose.secondsToLimit());
+
+        uint64_t t = 0;
+        for (int step = 0; step < 50; step++) {
+            dose.addSample(t, e);
+            uint64_t limitPj = (uint64_t)UVDOSE_LIMIT_MJ * PJ_PER_MJ;
+            uint64_t expected =
+                (limitPj - dose.dailyPj()) / ((uint64_t)e * US_PER_S);
+            TEST_ASSERT_EQUAL_UINT64(expected, dose.secondsToLimit());
+            t += 7 * US_PER_S;
+        }
+    }
+}
+
+static void test_time_to_limit_reached(void) {
+    // Follow the prediction: after the predicted seconds, the daily dose is
+    // within one second of irradiance below the limit, one second later it
+    // is over
+    const uint32_t e = 25000;  // 1 UV index
+    UVDose dose;
+    dose.addSample(0, e);
+    uint32_t predicted = dose.secondsToLimit();
+    TEST_ASSERT_EQUAL_UINT32(UVDOSE_LIMIT_MJ * 1000ULL / e, predicted);
+
+    uint64_t t = 0;
+    while (t < (uint64_t)predicted * US_PER_S) {
+        t += 1 * US_PER_S;
+        dose.addSample(t, e);
+    }
+    uint64_t limitPj = (uint64_t)UVDOSE_LIMIT_MJ * PJ_PER_MJ;
+    TEST_ASSERT_TRUE(dose.dailyPj() <= limitPj);
+    TEST_ASSERT_TRUE(limitPj - dose.dailyPj() < (uint64_t)e * US_PER_S);
+    dose.addSample(t + US_PER_S, e);
+    TEST_ASSERT_EQUAL_UINT32(0, dose.secondsToLimit());
+
+    // Dark: no limit ahead
+    dose.addSample(t + 2 * US_PER_S, 0);
+    dose.resetSession();
+    TEST_ASSERT_EQUAL_UINT32(0, dose.secondsToLimit());
+    UVDose dark;
+    dark.addSample(0, 0);
+    TEST_ASSERT_EQUAL_UINT32(UVDOSE_NO_LIMIT, dark.secondsToLimit());
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_constant_profile);
+    RUN_TEST(test_irregular_constant);
+    RUN_TEST(test_irregular_ramp);
+    RUN_TEST(test_irregular_sine);
+    RUN_TEST(test_gap_is_skipped);
+    RUN_TEST(test_daily_rollover);
+    RUN_TEST(test_rollover_splits_ramp);
+    RUN_TEST(test_rollover_during_gap);
+    RUN_TEST(test_time_to_limit_closed_form);
+    RUN_TEST(test_time_to_limit_reached);
+    return UNITY_END();
+}
@@ -0,0 +1,215 @@
+// UVRollup history against summaries computed by brute force over every
+// sample, across ring wraps, a 90 minute gap and samples arriving late.
+// Ring sizes come from slots(), so the suite holds for any
+// ROLLUP_*_SLOTS override; env:native_rollup_slots runs it with one.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <unity.h>
+
+#include "SampleSummary.h"
+#include "UVRollup.h"
+
+#define US_PER_S 1000000ULL
+// Mid 2026, so slot numbers are far from zero like on the device
+#define START_US (1780000000ULL * US_PER_S)
+
+static UVRollup* rollup;
+static SampleSummary* history;
+
+void setUp(void) {
+    srand(5);
+    rollup  = new UVRollup();
+    history = new SampleSummary[ROLLUP_MAX_SLOTS];
+}
+
+void tearDown(void) {
+    delete[] history;
+    delete rollup;
+}
+
+static LogSample sampleAt(uint64_t timestampUs) {
+    LogSample sample   = LogSample();
+    sample.timestampUs = timestampUs;
+    sample.uva         = 20000 + (uint32_t)(rand() % 5000);
+    sample.uvb         = 1000 + (uint32_t)(rand() % 300);
+    sample.uvc         = (uint32_t)(rand() % 10);
+    return sample;
+}
+
+static const char* levelName(int level) {
+    static const char* names[] = {"seconds", "minutes", "hours"};
+    return names[level];
+}
+
+// Every slot of every level against the samples that fall into it
+static void checkAgainstBruteForce(const std::vector<LogSample>& samples) {
+    uint64_t last = samples.back().timestampUs;
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        RollupLevel rollupLevel = (RollupLevel)level;
+        uint64_t period         = UVRollup::periodUs(rollupLevel);
+        size_t size             = UVRollup::slots(rollupLevel);
+        uint64_t newest         = last / period;
+        uint64_t first          = newest + 1 - size;
+
+        std::vector<SampleSummary> expected(size, SampleSummary());
+        for (size_t i = 0; i < samples.size(); i++) {
+            uint64_t slot = samples[i].timestampUs / period;
+            if (slot >= first) summaryAdd(&expected[slot - first], samples[i]);
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(size,
+                                 rollup->history(rollupLevel, size, history));
+        uint32_t filled = 0;
+        for (size_t i = 0; i < size; i++) {
+            const SampleSummary& want = expected[i];
+            const SampleSummary& got  = history[i];
+            TEST_ASSERT_EQUAL_UINT64((first + i) * period, got.startUs);
+            TEST_ASSERT_EQUAL_UINT64((first + i + 1) * period - 1, got.endUs);
+            TEST_ASSERT_EQUAL_UINT32(want.count, got.count);
+            if (want.count == 0) continue;
+            filled++;
+            for (int c = 0; c < SAMPLESUMMARY_CHANNELS; c++) {
+                TEST_ASSERT_EQUAL_UINT32(want.min[c], got.min[c]);
+                TEST_ASSERT_EQUAL_UINT32(want.max[c], got.max[c]);
+                TEST_ASSERT_EQUAL_UINT64(want.sum[c], got.sum[c]);
+            }
+        }
+        printf("  %-7s %u of %u slots filled\n", levelName(level),
+               (unsigned)filled, (unsigned)size);
+    }
+}
+
+static void test_matches_brute_force(void) {
+    const int count = 200000;
+    const int gapAt = count / 2;
+    std::vector<LogSample> samples;
+    samples.reserve(count);
+
+    // 16 to 250 ms apart like auto-ranging, with the sensor off for 90
+    // minutes halfway: the seconds ring is cleared, the minutes ring only
+    // in part
+    uint64_t t = START_US;
+    for (int i = 0; i < count; i++) {
+        t += (i == gapAt) ? 90 * 60 * US_PER_S
+                          : 16000 + (uint64_t)(rand() % 234000);
+        samples.push_back(sampleAt(t));
+        rollup->add(samples.back());
+
+        if (i == gapAt) {
+            printf("Right after the gap:\n");
+            checkAgainstBruteForce(samples);
+            size_t size = UVRollup::slots(ROLLUP_SECONDS);
+            rollup->history(ROLLUP_SECONDS, size, history);
+            for (size_t s = 0; s + 1 < size; s++) {
+                TEST_ASSERT_EQUAL_UINT32(0, history[s].count);
+            }
+            TEST_ASSERT_EQUAL_UINT32(1, history[size - 1].count);
+        }
+    }
+    printf("After %d samples over %.1f h:\n", count,
+           (t - START_US) / 3600e6);
+    checkAgainstBruteForce(samples);
+}
+
+static void test_ring_wrap(void) {
+    size_t size = UVRollup::slots(ROLLUP_SECONDS);
+    TEST_ASSERT_EQUAL_UINT32(0, rollup->history(ROLLUP_SECONDS, size, history));
+
+    // Three times around the ring at one sample per second, two per slot
+    uint64_t t = START_US;
+    for (size_t i = 0; i < 3 * size; i++, t += US_PER_S) {
+        rollup->add(sampleAt(t));
+        rollup->add(sampleAt(t + US_PER_S / 2));
+    }
+    uint64_t newest = (t - US_PER_S) / US_PER_S;
+
+    // Asking for more than the ring holds returns the ring, oldest first
+    TEST_ASSERT_EQUAL_UINT32(
+        size, rollup->history(ROLLUP_SECONDS, 2 * size, history));
+    for (size_t i = 0; i < size; i++) {
+        TEST_ASSERT_EQUAL_UINT32(2, history[i].count);
+        TEST_ASSERT_EQUAL_UINT64((newest + 1 - size + i) * US_PER_S,
+                                 history[i].startUs);
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, rollup->history(ROLLUP_SECONDS, 3, history));
+    TEST_ASSERT_EQUAL_UINT64(newest * US_PER_S, history[2].startUs);
+
+    rollup->reset();
+    TEST_ASSERT_EQUAL_UINT32(0, rollup->history(ROLLUP_SECONDS, size, history));
+}
+
+static void test_gap_longer_than_ring(void) {
+    size_t size = UVRollup::slots(ROLLUP_MINUTES);
+    uint64_t t  = START_US;
+    for (size_t i = 0; i < size; i++, t += 60 * US_PER_S) {
+        rollup->add(sampleAt(t));
+    }
+
+    // One period more than the ring: nothing from before may survive
+    t += size * 60 * US_PER_S;
+    rollup->add(sampleAt(t));
+    TEST_ASSERT_EQUAL_UINT32(size,
+                             rollup->history(ROLLUP_MINUTES, size, history));
+    for (size_t i = 0; i + 1 < size; i++) {
+        TEST_ASSERT_EQUAL_UINT32(0, history[i].count);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, history[size - 1].count);
+}
+
+static void test_old_samples(void) {
+    size_t seconds = UVRollup::slots(ROLLUP_SECONDS);
+    uint64_t t     = START_US - START_US % (60 * US_PER_S);
+    for (size_t i = 0; i < 2 * seconds; i++) {
+        rollup->add(sampleAt(t + i * US_PER_S));
+    }
+    uint64_t newestUs = t + (2 * seconds - 1) * US_PER_S;
+
+    // Older than the seconds ring: only the coarser rings take it
+    rollup->add(sampleAt(t));
+    TEST_ASSERT_EQUAL_UINT32(seconds,
+                             rollup->history(ROLLUP_SECONDS, seconds, history));
+    for (size_t i = 0; i < seconds; i++) {
+        TEST_ASSERT_EQUAL_UINT32(1, history[i].count);
+    }
+    uint64_t minutes = newestUs / (60 * US_PER_S) - t / (60 * US_PER_S) + 1;
+    TEST_ASSERT_EQUAL_UINT32(
+        minutes, rollup->history(ROLLUP_MINUTES, (size_t)minutes, history));
+    TEST_ASSERT_EQUAL_UINT32(61, history[0].count);
+
+    // Late but inside the ring: counted in its own slot, the newest slot
+    // stays where it is
+    rollup->add(sampleAt(newestUs - 10 * US_PER_S));
+    TEST_ASSERT_EQUAL_UINT32(11, rollup->history(ROLLUP_SECONDS, 11, history));
+    TEST_ASSERT_EQUAL_UINT32(2, history[0].count);
+    TEST_ASSERT_EQUAL_UINT64(newestUs, history[10].startUs);
+}
+
+static void test_slot_overrides(void) {
+    // The configured sizes are the ones in use, and they fit the budget
+    // the library asserts at compile time
+    TEST_ASSERT_EQUAL_UINT32(ROLLUP_SECOND_SLOTS,
+                             UVRollup::slots(ROLLUP_SECONDS));
+    TEST_ASSERT_EQUAL_UINT32(ROLLUP_MINUTE_SLOTS,
+                             UVRollup::slots(ROLLUP_MINUTES));
+    TEST_ASSERT_EQUAL_UINT32(ROLLUP_HOUR_SLOTS, UVRollup::slots(ROLLUP_HOURS));
+    printf("%d/%d/%d slots: %u of %u bytes\n", ROLLUP_SECOND_SLOTS,
+           ROLLUP_MINUTE_SLOTS, ROLLUP_HOUR_SLOTS, (unsigned)sizeof(UVRollup),
+           (unsigned)ROLLUP_BUDGET_BYTES);
+    TEST_ASSERT_TRUE(sizeof(UVRollup) <= ROLLUP_BUDGET_BYTES);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_brute_force);
+    RUN_TEST(test_ring_wrap);
+    RUN_TEST(test_gap_longer_than_ring);
+    RUN_TEST(test_old_samples);
+    RUN_TEST(test_slot_overrides);
+    return UNITY_END();
+}
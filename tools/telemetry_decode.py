@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry stream (lib/Telemetry) into per-record CSV.
+
+Reads a serial port (needs pyserial) or a raw capture file and writes one
+column-per-field CSV per record type, e.g. out_uv.csv and out_battery.csv.
+Packed UV blocks (the default of "telemetry on") go to out_uv_packed.csv.
+Frame sequence gaps are reported as dropped frames; text log lines mixed
+into the stream fail the CRC and are counted as bad frames.
+
+    tools/telemetry_decode.py /dev/ttyACM0 --baud 1500000 -o capture
+    tools/telemetry_decode.py capture.bin -o capture
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+UV = 0x01
+BATTERY = 0x02
+UV_BLOCK = 0x03
+
+RECORDS = {
+    UV: ("uv", "<IIIIIh",
+         ["timestamp_us", "sample_seq", "uva_uw_m2", "uvb_uw_m2", "uvc_uw_m2",
+          "temp_centi_c"]),
+    BATTERY: ("battery", "<IHBh",
+              ["timestamp_ms", "millivolts", "percent", "rate_mv_per_hour"]),
+    UV_BLOCK: ("uv_packed", None,
+               ["timestamp_us", "uva_uw_m2", "uvb_uw_m2", "uvc_uw_m2", "temp_centi_c"]),
+}
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, as crc16Ccitt() in lib/Checksum."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            return None
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def varints(data, pos, count):
+    values = []
+    for _ in range(count):
+        value = shift = 0
+        while True:
+            if pos >= len(data) or shift > 63:
+                return None, pos
+            byte = data[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        values.append(value)
+    return values, pos
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode_block(payload):
+    """UV block as written by SampleEncoder in lib/SampleCodec."""
+    if not payload:
+        return None
+    pos = 1
+    rows = []
+    last = [0, 0, 0, 0, 0]
+    delta = 0
+    for i in range(payload[0]):
+        fields, pos = varints(payload, pos, 5)
+        if fields is None:
+            return None
+        if i == 0:
+            timestamp = fields[0]
+        else:
+            delta += unzigzag(fields[0])
+            timestamp = last[0] + delta
+        channels = [(last[j] + unzigzag(fields[j])) & 0xFFFFFFFF for j in (1, 2, 3)]
+        temp = ((last[4] + unzigzag(fields[4]) + 0x8000) & 0xFFFF) - 0x8000
+        last = [timestamp] + channels + [temp]
+        rows.append(last)
+    return rows if pos == len(payload) else None
+
+
+class Decoder:
+    def __init__(self, prefix):
+        self.prefix = prefix
+        self.writers = {}
+        self.files = []
+        self.last_seq = None
+        self.frames = 0
+        self.dropped = 0
+        self.bad = 0
+
+    def writer(self, rtype):
+        if rtype not in self.writers:
+            name, _, fields = RECORDS[rtype]
+            f = open("%s_%s.csv" % (self.prefix, name), "w", newline="")
+            self.files.append(f)
+            w = csv.writer(f)
+            w.writerow(["frame_seq"] + fields)
+            self.writers[rtype] = w
+        return self.writers[rtype]
+
+    def frame(self, encoded):
+        raw = cobs_decode(encoded)
+        if raw is None or len(raw) < 5 or crc16(raw[:-2]) != struct.unpack_from("<H", raw, len(raw) - 2)[0]:
+            self.bad += 1
+            return
+        rtype, seq = struct.unpack_from("<BH", raw)
+        payload = raw[3:-2]
+
+        if self.last_seq is not None:
+            gap = (seq - self.last_seq - 1) & 0xFFFF
+            if gap:
+                self.dropped += gap
+                print("dropped %d frames before seq %d" % (gap, seq), file=sys.stderr)
+        self.last_seq = seq
+        self.frames += 1
+
+        if rtype == UV_BLOCK:
+            rows = decode_block(payload)
+            if rows is None:
+                self.bad += 1
+                return
+            w = self.writer(rtype)
+            for row in rows:
+                w.writerow([seq] + row)
+            return
+
+        record = RECORDS.get(rtype)
+        if record is None or len(payload) != struct.calcsize(record[1]):
+            self.bad += 1
+            return
+        self.writer(rtype).writerow([seq] + list(struct.unpack(record[1], payload)))
+
+    def feed(self, chunks):
+        buffer = bytearray()
+        for chunk in chunks:
+            buffer += chunk
+            while True:
+                end = buffer.find(b"\x00")
+                if end < 0:
+                    break
+                if end > 0:
+                    self.frame(bytes(buffer[:end]))
+                del buffer[:end + 1]
+
+    def close(self):
+        for f in self.files:
+            f.close()
+        print("%d frames, %d dropped, %d bad" % (self.frames, self.dropped, self.bad),
+              file=sys.stderr)
+
+
+def read_file(path):
+    with open(path, "rb") as f:
+        while True:
+            chunk = f.read(65536)
+            if not chunk:
+                return
+            yield chunk
+
+
+def read_serial(port, baud):
+    import serial  # pyserial, only needed for live capture
+
+    with serial.Serial(port, baud, timeout=0.1) as s:
+        s.write(b"telemetry on\n")
+        try:
+            while True:
+                yield s.read(4096)
+        except KeyboardInterrupt:
+            s.write(b"telemetry off\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="serial port or raw capture file")
+    parser.add_argument("--baud", type=int, default=1500000)
+    parser.add_argument("-o", "--output", default="telemetry", help="CSV file prefix")
+    args = parser.parse_args()
+
+    decoder = Decoder(args.output)
+    if args.source.startswith("/dev/") or args.source.upper().startswith("COM"):
+        chunks = read_serial(args.source, args.baud)
+    else:
+        chunks = read_file(args.source)
+    try:
+        decoder.feed(chunks)
+    finally:
+        decoder.close()
+
+
+if __name__ == "__main__":
+    main()